@@ -0,0 +1,111 @@
+// File: affinity.c
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "affinity.h"
+
+void affinity_init(AffinityConfig *a)
+{
+    memset(a, 0, sizeof(*a));
+    a->generator_cpu = -1;
+    a->ui_cpu = -1;
+    a->numa_node = -1;
+}
+
+bool affinity_parse_list(const char *text, uint64_t mask[AFFINITY_WORDS], int *count)
+{
+    memset(mask, 0, sizeof(uint64_t) * AFFINITY_WORDS);
+    *count = 0;
+    const char *p = text;
+    while (*p != '\0' && *p != '\n')
+    {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= AFFINITY_MAX_CPUS)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= AFFINITY_MAX_CPUS)
+                return false;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            if (!(mask[cpu / 64] & (1ull << (cpu % 64))))
+                (*count)++;
+            mask[cpu / 64] |= 1ull << (cpu % 64);
+        }
+        if (*p == ',')
+            p++;
+        else if (*p != '\0' && *p != '\n')
+            return false;
+    }
+    return *count > 0;
+}
+
+bool affinity_node_cpus(int node, uint64_t mask[AFFINITY_WORDS], int *count)
+{
+    char path[64], line[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    bool ok = fgets(line, sizeof(line), f) != NULL && affinity_parse_list(line, mask, count);
+    fclose(f);
+    return ok;
+}
+
+bool affinity_pin_mask(const uint64_t mask[AFFINITY_WORDS])
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+    {
+        if (mask[cpu / 64] & (1ull << (cpu % 64)))
+            CPU_SET(cpu, &set);
+    }
+    // pid 0: el hilo que llama (los hijos que cree despues la heredan)
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+    {
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
+
+bool affinity_pin_cpu(int cpu)
+{
+    uint64_t mask[AFFINITY_WORDS] = {0};
+    if (cpu < 0 || cpu >= AFFINITY_MAX_CPUS)
+        return false;
+    mask[cpu / 64] = 1ull << (cpu % 64);
+    return affinity_pin_mask(mask);
+}
+
+void affinity_pin_belt(const AffinityConfig *a, int belt_id)
+{
+    if (a->belt_cpu_count == 0)
+        return;
+    int k = belt_id % a->belt_cpu_count;
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++)
+    {
+        if (a->belt_cpus[cpu / 64] & (1ull << (cpu % 64)))
+        {
+            if (k-- == 0)
+            {
+                affinity_pin_cpu(cpu);
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// File: affinity.h
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// afinidad de cpu: a que cpus se fija cada proceso (o hilo) de la corrida.
+// las mascaras son bits propios (no cpu_set_t) para que la configuracion
+// pueda vivir en la memoria compartida sin depender de _GNU_SOURCE
+#define AFFINITY_MAX_CPUS 1024
+#define AFFINITY_WORDS (AFFINITY_MAX_CPUS / 64)
+
+typedef struct {
+    uint64_t belt_cpus[AFFINITY_WORDS];   // banda i: la i-esima cpu de la lista (modulo)
+    int belt_cpu_count;                   // 0: las bandas no se fijan
+    int generator_cpu;                    // -1: sin fijar
+    int ui_cpu;                           // -1: sin fijar
+    int numa_node;                        // -1: sin nodo (el padre y todos los hijos van a sus cpus)
+} AffinityConfig;
+
+void affinity_init(AffinityConfig *a);
+
+// lee una lista de cpus como "0-3,8,10-11". false si es invalida
+bool affinity_parse_list(const char *text, uint64_t mask[AFFINITY_WORDS], int *count);
+
+// cpus de un nodo numa (segun /sys/devices/system/node)
+bool affinity_node_cpus(int node, uint64_t mask[AFFINITY_WORDS], int *count);
+
+// fija el hilo que llama a todas las cpus de la mascara
+bool affinity_pin_mask(const uint64_t mask[AFFINITY_WORDS]);
+
+// fija el hilo que llama a una sola cpu
+bool affinity_pin_cpu(int cpu);
+
+// fija el hilo que llama a la cpu que le toca a la banda belt_id (no hace
+// nada si no se pidieron cpus para las bandas)
+void affinity_pin_belt(const AffinityConfig *a, int belt_id);
+
+#endif
@@ -0,0 +1,83 @@
+// File: arrival.c
+
+#include <math.h>
+#include <string.h>
+
+#include "arrival.h"
+
+static const char *profile_names[] = {
+    [ARRIVAL_CLASSIC] = "classic",
+    [ARRIVAL_CONSTANT] = "constant",
+    [ARRIVAL_POISSON] = "poisson",
+    [ARRIVAL_BURST] = "burst",
+    [ARRIVAL_STEP] = "step",
+};
+
+bool arrival_parse_profile(const char *name, ArrivalProfile *out)
+{
+    for (int i = 0; i < (int)(sizeof(profile_names) / sizeof(profile_names[0])); i++)
+    {
+        if (strcmp(name, profile_names[i]) == 0)
+        {
+            *out = (ArrivalProfile)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *arrival_profile_name(ArrivalProfile profile)
+{
+    return profile_names[profile];
+}
+
+// tasa vigente en el instante t (solo cambia en el perfil step)
+static double rate_at(const ArrivalClock *clock, double t)
+{
+    const ArrivalConfig *cfg = &clock->cfg;
+    if (cfg->profile != ARRIVAL_STEP || cfg->step_seconds == 0)
+        return cfg->rate;
+    uint64_t steps = (uint64_t)((t - clock->start_ns) / (cfg->step_seconds * 1e9));
+    return cfg->rate + cfg->step_rate * steps;
+}
+
+// separacion hasta la siguiente llegada, en ns
+static double next_gap(ArrivalClock *clock)
+{
+    const ArrivalConfig *cfg = &clock->cfg;
+    double rate = rate_at(clock, clock->next_ns);
+    switch (cfg->profile)
+    {
+    case ARRIVAL_POISSON:
+        // intervalo exponencial: -ln(U) / rate (1 - U para no evaluar ln(0))
+        return -log(1.0 - rng_uniform(&clock->rng)) * 1e9 / rate;
+    case ARRIVAL_BURST:
+        // las ordenes de una rafaga llegan juntas; entre rafagas se deja el
+        // tiempo que mantiene la tasa media
+        if (--clock->burst_left > 0)
+            return 0;
+        clock->burst_left = cfg->burst_size;
+        return cfg->burst_size * 1e9 / rate;
+    default:
+        return 1e9 / rate;
+    }
+}
+
+void arrival_clock_init(ArrivalClock *clock, const ArrivalConfig *cfg, uint64_t start_ns, uint64_t seed)
+{
+    clock->cfg = *cfg;
+    if (clock->cfg.burst_size == 0)
+        clock->cfg.burst_size = 1;
+    clock->start_ns = start_ns;
+    clock->next_ns = start_ns;
+    // xorshift no puede partir de cero
+    clock->rng = seed != 0 ? seed : 0x9E3779B97F4A7C15ull;
+    clock->burst_left = clock->cfg.burst_size;
+}
+
+uint64_t arrival_clock_advance(ArrivalClock *clock)
+{
+    uint64_t t = (uint64_t)clock->next_ns;
+    clock->next_ns += next_gap(clock);
+    return t;
+}
@@ -0,0 +1,78 @@
+// File: arrival.h
+
+#ifndef ARRIVAL_H
+#define ARRIVAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// procesos de llegada del generador. el perfil clasico es el de siempre
+// (lazo cerrado: espera entre ordenes y se bloquea si la cola esta llena);
+// los demas son de lazo abierto: las ordenes llegan segun un reloj propio
+// aunque la cocina no de abasto
+typedef enum {
+    ARRIVAL_CLASSIC,    // aleatorio 1-3 s o --arrival-us fijo, bloqueante
+    ARRIVAL_CONSTANT,   // una orden cada 1/rate segundos
+    ARRIVAL_POISSON,    // intervalos exponenciales de media 1/rate
+    ARRIVAL_BURST,      // rafagas de burst_size ordenes juntas, tasa media rate
+    ARRIVAL_STEP        // tasa que sube step_rate cada step_seconds segundos
+} ArrivalProfile;
+
+// que hacer con una orden que llega con la cola llena
+typedef enum {
+    OVERFLOW_BACKLOG,   // guardarla en una espera local y reintentar
+    OVERFLOW_DROP       // descartarla (y contarla)
+} OverflowPolicy;
+
+typedef struct {
+    ArrivalProfile profile;
+    double rate;                  // ordenes por segundo (tasa inicial en step)
+    unsigned int burst_size;      // ordenes por rafaga (burst)
+    double step_rate;             // aumento de la tasa en cada escalon (step)
+    unsigned int step_seconds;    // duracion de cada escalon (step)
+    OverflowPolicy overflow;
+} ArrivalConfig;
+
+// reloj de llegadas: da el instante (absoluto, en ns) de cada llegada.
+// el horario no depende de cuando se logra encolar, asi que una cola llena
+// no frena las llegadas
+typedef struct {
+    ArrivalConfig cfg;
+    uint64_t start_ns;
+    double next_ns;
+    uint64_t rng;
+    unsigned int burst_left;
+} ArrivalClock;
+
+// generador pseudoaleatorio xorshift64* (rapido y sin estado global)
+static inline uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// numero uniforme en [0, 1)
+static inline double rng_uniform(uint64_t *state)
+{
+    return (rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool arrival_parse_profile(const char *name, ArrivalProfile *out);
+const char *arrival_profile_name(ArrivalProfile profile);
+
+void arrival_clock_init(ArrivalClock *clock, const ArrivalConfig *cfg, uint64_t start_ns, uint64_t seed);
+
+// instante de la proxima llegada (sin consumirla)
+static inline uint64_t arrival_clock_peek(const ArrivalClock *clock)
+{
+    return (uint64_t)clock->next_ns;
+}
+
+// consume la proxima llegada y devuelve su instante
+uint64_t arrival_clock_advance(ArrivalClock *clock);
+
+#endif
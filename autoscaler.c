@@ -0,0 +1,81 @@
+// File: autoscaler.c
+
+#include <math.h>
+
+#include "autoscaler.h"
+
+void autoscaler_init(Autoscaler *a, const AutoscaleConfig *config, int active, uint64_t now)
+{
+    a->config = *config;
+    a->over = 0;
+    a->under = 0;
+    a->last_change_ns = now;
+    a->ups = 0;
+    a->downs = 0;
+    a->min_active = active;
+    a->max_active = active;
+    a->active_sum = 0;
+    a->samples = 0;
+}
+
+static int clamp(int value, int lo, int hi)
+{
+    return value < lo ? lo : value > hi ? hi : value;
+}
+
+int autoscaler_decide(Autoscaler *a, const AutoscaleSample *s, uint64_t now)
+{
+    const AutoscaleConfig *c = &a->config;
+    int active = s->active;
+    a->active_sum += active;
+    a->samples++;
+    if (active < a->min_active)
+        a->min_active = active;
+    if (active > a->max_active)
+        a->max_active = active;
+
+    // bandas necesarias segun la ley de Little: llegadas por tiempo de
+    // servicio, con margen para que ninguna quede al 100%
+    int needed = active;
+    if (s->service_mean_ns > 0)
+        needed = (int)ceil(s->arrival_rate * s->service_mean_ns / 1e9 / AUTOSCALE_UTILIZATION);
+    needed = clamp(needed, c->min_belts, c->max_belts);
+
+    // por encima: la espera pasa el objetivo, o la cola crece porque llega
+    // claramente mas de lo que sale. con capacidad de sobra: la espera esta
+    // holgada y alcanzaria con menos bandas
+    bool hot = s->wait_p99_ns > c->target_wait_ns ||
+               (s->queue_depth > active && s->arrival_rate > 1.1 * s->completion_rate);
+    bool cold = s->wait_p99_ns < c->target_wait_ns / 2 && needed < active && s->queue_depth <= active;
+    a->over = hot ? a->over + 1 : 0;
+    a->under = cold ? a->under + 1 : 0;
+
+    int desired = active;
+    if (active < c->min_belts)
+        desired = c->min_belts;
+    else if (a->over >= AUTOSCALE_UP_SAMPLES && active < c->max_belts &&
+             now - a->last_change_ns >= AUTOSCALE_UP_COOLDOWN_MS * 1000000ull)
+    {
+        desired = needed > active ? needed : active + 1;
+        if (desired > 2 * active)
+            desired = 2 * active;
+    }
+    else if (a->under >= AUTOSCALE_DOWN_SAMPLES && active > c->min_belts &&
+             now - a->last_change_ns >= AUTOSCALE_DOWN_COOLDOWN_MS * 1000000ull)
+    {
+        desired = active - 1;
+    }
+    desired = clamp(desired, c->min_belts, c->max_belts);
+
+    if (desired != active)
+    {
+        if (desired > active)
+            a->ups++;
+        else
+            a->downs++;
+        a->last_change_ns = now;
+        a->over = 0;
+        a->under = 0;
+    }
+    return desired;
+}
@@ -0,0 +1,62 @@
+// File: autoscaler.h
+
+#ifndef AUTOSCALER_H
+#define AUTOSCALER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// autoescalado de bandas: el padre mide cada intervalo la tasa de llegada,
+// la de ordenes completadas, la profundidad de la cola y el p99 de la
+// espera en cola, y decide cuantas bandas deberian estar activas. esta
+// parte solo decide; crear o retirar los procesos es cosa de main.c.
+//
+// para no oscilar:
+//   - hay una banda muerta entre target/2 y target en la que no se cambia nada
+//   - una condicion tiene que repetirse varias evaluaciones seguidas
+//   - despues de cada cambio hay un tiempo de espera (mas largo para bajar)
+//   - se sube a lo sumo al doble de bandas y se baja de a una
+#define AUTOSCALE_INTERVAL_MS 250
+#define AUTOSCALE_UP_SAMPLES 2          // evaluaciones seguidas para subir
+#define AUTOSCALE_DOWN_SAMPLES 8        // y para bajar (2 s)
+#define AUTOSCALE_UP_COOLDOWN_MS 1000
+#define AUTOSCALE_DOWN_COOLDOWN_MS 5000
+#define AUTOSCALE_UTILIZATION 0.75      // ocupacion buscada de cada banda
+#define AUTOSCALE_DEFAULT_TARGET_WAIT_US 50000
+
+typedef struct {
+    int min_belts;
+    int max_belts;
+    uint64_t target_wait_ns;      // p99 de espera en cola buscado
+} AutoscaleConfig;
+
+// lo medido en el ultimo intervalo
+typedef struct {
+    double arrival_rate;          // ordenes/s
+    double completion_rate;       // ordenes/s
+    uint64_t wait_p99_ns;         // de las ordenes completadas en el intervalo
+    double service_mean_ns;       // 0 si no se completo ninguna
+    int queue_depth;
+    int active;                   // bandas activas ahora
+} AutoscaleSample;
+
+typedef struct {
+    AutoscaleConfig config;
+    int over;                     // evaluaciones seguidas por encima del objetivo
+    int under;                    // y con capacidad de sobra
+    uint64_t last_change_ns;
+    unsigned long ups;
+    unsigned long downs;
+    // para el reporte
+    int min_active;
+    int max_active;
+    double active_sum;
+    unsigned long samples;
+} Autoscaler;
+
+void autoscaler_init(Autoscaler *a, const AutoscaleConfig *config, int active, uint64_t now);
+
+// bandas que deberian quedar activas tras esta muestra
+int autoscaler_decide(Autoscaler *a, const AutoscaleSample *s, uint64_t now);
+
+#endif
@@ -0,0 +1,41 @@
+// File: belt.h
+
+#ifndef BELT_H
+#define BELT_H
+
+#include "shared_data.h"
+
+// prepara una orden ya despachada (ingredientes reservados) en la banda
+// belt_id: actualiza su estado, simula el tiempo de servicio y registra
+// la orden en sus contadores e histogramas. la usan tanto las bandas
+// proceso como las bandas hilo
+void belt_prepare_order(SharedSystemState *state, int belt_id, BurgerOrder *order);
+
+// igual, para un lote de ordenes despachadas juntas (en su orden)
+void belt_prepare_orders(SharedSystemState *state, int belt_id, const BurgerOrder *orders, int count);
+
+// guarda el lote como el que la banda tiene en curso (ingredientes ya
+// reservados): si la banda muere, la que la reemplaza termina lo que falte
+void belt_record_inflight(PreparationBelt *belt, const BurgerOrder *orders, int count);
+
+// prepara el lote en curso de la banda (el que dejo dispatcher_next)
+void belt_prepare_inflight(SharedSystemState *state, int belt_id);
+
+// registra una orden terminada en los histogramas de la banda (tambien la
+// usa la simulacion, que no pasa por belt_prepare_order)
+void belt_record_latency(SharedSystemState *state, int belt_id, const BurgerOrder *order);
+
+// al arrancar (tambien como reemplazo de una banda muerta): repara el
+// seqlock que la anterior pudo dejar abierto y termina su orden en curso
+void belt_recover(SharedSystemState *state, int belt_id);
+
+// punto seguro entre ordenes: atiende el comando de la interfaz. si la
+// banda esta pausada la estaciona (sin sondeo: duerme en su futex de
+// control) hasta que la reanuden. devuelve false si la banda debe terminar
+// porque la retiraron o porque el sistema se apaga
+bool belt_wait_runnable(SharedSystemState *state, int belt_id);
+
+// envia un comando a una banda y la despierta si esta dormida
+void belt_send_command(SharedSystemState *state, int belt_id, BeltCommand command);
+
+#endif
@@ -7,104 +7,177 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "shared_data.h"
+#include "order_queue.h"
+#include "dispatcher.h"
+#include "clock_utils.h"
+#include "journal.h"
+#include "belt.h"
+#include "pipeline.h"
 
 static SharedSystemState *shared_state = NULL;
 static int belt_id;
 
-// La función check_and_take_ingredients no necesita cambios.
-bool check_and_take_ingredients(const BurgerOrder *order) {
-    for (int i = 0; i < MAX_INGREDIENTS; i++) {
-        if (order->ingredients_needed[i] > 0) {
-            pthread_mutex_lock(&shared_state->ingredients[i].mutex);
-        }
+// Registra en los histogramas de esta banda la espera en cola, el tiempo
+// en la banda y la latencia total de una orden terminada.
+void belt_record_latency(SharedSystemState *state, int id, const BurgerOrder *order) {
+    BeltMetrics *metrics = state_belt_metrics(state, id);
+    hist_record(&metrics->queue_wait, order->dequeued_ns - order->enqueued_ns);
+    hist_record(&metrics->service, order->completed_ns - order->dequeued_ns);
+    hist_record(&metrics->total, order->completed_ns - order->enqueued_ns);
+    // retraso sobre el plazo de su clase (0 si llego a tiempo)
+    uint32_t c = order->priority < ORDER_CLASSES ? order->priority : ORDER_STANDARD;
+    uint64_t late = order->completed_ns > order->deadline_ns ? order->completed_ns - order->deadline_ns : 0;
+    hist_record(&metrics->lateness[c], late);
+    if (late > 0)
+        atomic_store_explicit(&metrics->missed[c], atomic_load_explicit(&metrics->missed[c], memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+    // consumo por ingrediente para la reposicion automatica
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        if (order->ingredients_needed[i] != 0)
+            atomic_store_explicit(&metrics->consumed[i],
+                                  atomic_load_explicit(&metrics->consumed[i], memory_order_relaxed) +
+                                      order->ingredients_needed[i],
+                                  memory_order_relaxed);
+}
+
+// Prepara las órdenes del lote guardado en la banda que todavía no están
+// terminadas (todas, salvo que una banda anterior haya muerto a medias).
+static void finish_inflight(SharedSystemState *state, int id) {
+    PreparationBelt *belt = state_belt(state, id);
+    uint32_t count = atomic_load_explicit(&belt->inflight_count, memory_order_acquire);
+    for (uint32_t k = atomic_load_explicit(&belt->inflight_done, memory_order_relaxed); k < count; k++) {
+        BurgerOrder *order = &belt->inflight[k];
+        belt_set_state(belt, PREPARING, order->order_id);
+        log_event(state, id, LOG_DEBUG, LOG_EV_BELT_PREPARING, order->order_id, 0);
+        sleep_us(state->config.service_time_us);
+
+        order->completed_ns = now_ns();
+        belt_record_latency(state, id, order);
+        journal_append(JR_COMPLETE, order, id);
+        atomic_store_explicit(&belt->inflight_done, k + 1, memory_order_release);
+        belt_count_processed(belt);
+        log_event(state, id, LOG_DEBUG, LOG_EV_BELT_DONE, order->order_id, belt->burgers_processed);
     }
-    bool has_enough = true;
-    for (int i = 0; i < MAX_INGREDIENTS; i++) {
-        if (order->ingredients_needed[i] > 0) {
-            if (shared_state->ingredients[i].count < order->ingredients_needed[i]) {
-                has_enough = false;
-                break; 
-            }
-        }
+}
+
+void belt_record_inflight(PreparationBelt *belt, const BurgerOrder *orders, int count) {
+    // El contador va a cero primero para que nunca se vea un lote a medio
+    // copiar.
+    atomic_store_explicit(&belt->inflight_count, 0, memory_order_release);
+    atomic_store_explicit(&belt->inflight_done, 0, memory_order_relaxed);
+    memcpy(belt->inflight, orders, count * sizeof(BurgerOrder));
+    atomic_store_explicit(&belt->inflight_count, count, memory_order_release);
+}
+
+void belt_prepare_orders(SharedSystemState *state, int id, const BurgerOrder *orders, int count) {
+    // Guardamos el lote antes de empezar: si la banda muere, la que la
+    // reemplace termina lo que falte.
+    belt_record_inflight(state_belt(state, id), orders, count);
+    finish_inflight(state, id);
+}
+
+void belt_prepare_inflight(SharedSystemState *state, int id) {
+    finish_inflight(state, id);
+}
+
+void belt_prepare_order(SharedSystemState *state, int id, BurgerOrder *order) {
+    belt_prepare_orders(state, id, order, 1);
+    *order = state_belt(state, id)->inflight[0];
+}
+
+void belt_recover(SharedSystemState *state, int id) {
+    PreparationBelt *belt = state_belt(state, id);
+    // La anterior murió dentro de una escritura: cerramos su seqlock para
+    // que la interfaz no espere para siempre.
+    if (atomic_load(&belt->seq.seq) & 1) {
+        seqlock_write_end(&belt->seq);
+    }
+    // Las casillas de la ventana que dejó tomadas vuelven a la ventana o
+    // se sueltan si su orden ya quedó en el lote en curso.
+    dispatcher_recover(state, id);
+    uint32_t done = atomic_load_explicit(&belt->inflight_done, memory_order_acquire);
+    if (done < atomic_load_explicit(&belt->inflight_count, memory_order_acquire)) {
+        log_event(state, id, LOG_WARN, LOG_EV_BELT_RECOVERED, belt->inflight[done].order_id, 0);
+        finish_inflight(state, id);
     }
-    if (has_enough) {
-        for (int i = 0; i < MAX_INGREDIENTS; i++) {
-            if (order->ingredients_needed[i] > 0) {
-                shared_state->ingredients[i].count -= order->ingredients_needed[i];
+}
+
+bool belt_wait_runnable(SharedSystemState *state, int id) {
+    PreparationBelt *belt = state_belt(state, id);
+    bool paused = false;
+    for (;;) {
+        uint32_t key = ec_prepare_wait(&belt->control);
+        uint32_t command = atomic_load_explicit(&belt->command, memory_order_acquire);
+        if (!state->system_running || command != BELT_PAUSE) {
+            ec_cancel_wait(&belt->control);
+            if (command == BELT_DRAIN) {
+                belt_set_state(belt, DRAINED, 0);
+                log_event(state, id, LOG_INFO, LOG_EV_BELT_DRAINED, 0, 0);
+                return false;
             }
+            if (paused && state->system_running) {
+                log_event(state, id, LOG_INFO, LOG_EV_BELT_RESUMED, 0, 0);
+            }
+            return state->system_running;
         }
-    }
-    for (int i = MAX_INGREDIENTS - 1; i >= 0; i--) {
-        if (order->ingredients_needed[i] > 0) {
-            pthread_mutex_unlock(&shared_state->ingredients[i].mutex);
+        if (!paused) {
+            belt_set_state(belt, PAUSED, 0);
+            log_event(state, id, LOG_INFO, LOG_EV_BELT_PAUSED, 0, 0);
+            paused = true;
         }
+        ec_wait(&belt->control, key);
     }
-    return has_enough;
+}
+
+void belt_send_command(SharedSystemState *state, int id, BeltCommand command) {
+    PreparationBelt *belt = state_belt(state, id);
+    atomic_store_explicit(&belt->command, command, memory_order_release);
+    // La banda puede estar pausada (duerme en control) o esperando órdenes
+    // (duerme en la cola o, en pipeline, en la cola de su etapa): la
+    // despertamos en todos lados.
+    ec_notify(&belt->control, true);
+    ec_notify(&state->waiting_orders.not_empty, true);
+    pipeline_wake_all(state);
 }
 
 void start_belt_process(int id, const char* shm_name) {
     belt_id = id;
-    int shm_fd = shm_open(shm_name, O_RDWR, 0666);
-    if (shm_fd == -1) { perror("shm_open (belt)"); exit(1); }
-    shared_state = mmap(NULL, sizeof(SharedSystemState), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_state == MAP_FAILED) { perror("mmap (belt)"); exit(1); }
-    close(shm_fd); 
-
-    printf("[Banda %d, PID %d] Conectada y lista.\n", belt_id, getpid());
-
-    while (shared_state->system_running) {
-        if (shared_state->belts[belt_id].status == PAUSED) {
-            sleep(1);
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL) { exit(1); }
+    affinity_pin_belt(&shared_state->config.affinity, belt_id);
+
+    log_event(shared_state, belt_id, LOG_INFO, LOG_EV_BELT_READY, getpid(), 0);
+    belt_recover(shared_state, belt_id);
+
+    // Entre una orden y la siguiente atendemos los comandos de la interfaz.
+    while (belt_wait_runnable(shared_state, belt_id)) {
+        belt_set_state(state_belt(shared_state, belt_id), IDLE, 0);
+
+        log_event(shared_state, belt_id, LOG_DEBUG, LOG_EV_BELT_WAITING, 0, 0);
+
+        // Tomamos la orden más antigua que se pueda servir con el inventario
+        // actual (no solo la cabeza de la cola); sus ingredientes ya quedan
+        // reservados. Solo dormimos si no hay ninguna servible.
+        // Con --batch tomamos varias de una vez, según lo que espera. El lote
+        // se termina completo antes de atender otro comando: sus
+        // ingredientes ya están reservados.
+        BurgerOrder batch[MAX_BATCH_SIZE];
+        int max = dispatcher_batch_size(shared_state, shared_state->num_belts);
+        int n = dispatcher_next(shared_state, belt_id, batch, max);
+        if (n == 0) {
             continue;
         }
-        
-        shared_state->belts[belt_id].status = IDLE;
-        shared_state->belts[belt_id].current_order_id = 0;
-
-        printf("[Banda %d] Esperando una orden...\n", belt_id);
-        sem_wait(&shared_state->sem_orders_available);
-
-        if (!shared_state->system_running) {
-            break;
+        if (shared_state->config.batch_size > 1) {
+            belt_count_batch(state_belt(shared_state, belt_id), n);
         }
 
-        BurgerOrder current_order;
-        // Solo "espiamos" la orden, no la sacamos de la cola todavía.
-        pthread_mutex_lock(&shared_state->waiting_orders.mutex);
-        current_order = shared_state->waiting_orders.orders[shared_state->waiting_orders.head];
-        pthread_mutex_unlock(&shared_state->waiting_orders.mutex);
-
-        // Guardamos el ID de la orden que estamos intentando procesar.
-        shared_state->belts[belt_id].current_order_id = current_order.order_id;
-
-        if (check_and_take_ingredients(&current_order)) {
-            // Si tuvimos éxito, AHORA SÍ sacamos la orden de la cola.
-            pthread_mutex_lock(&shared_state->waiting_orders.mutex);
-            shared_state->waiting_orders.head = (shared_state->waiting_orders.head + 1) % MAX_ORDERS_IN_QUEUE;
-            shared_state->waiting_orders.count--;
-            pthread_mutex_unlock(&shared_state->waiting_orders.mutex);
-
-            sem_post(&shared_state->sem_space_available);
-
-            shared_state->belts[belt_id].status = PREPARING;
-            printf("[Banda %d] Preparando orden #%u...\n", belt_id, current_order.order_id);
-            sleep(2); 
-
-            shared_state->belts[belt_id].burgers_processed++;
-            printf("[Banda %d] Orden #%u completada. Total: %u.\n", belt_id, current_order.order_id, shared_state->belts[belt_id].burgers_processed);
-        } else {
-
-            shared_state->belts[belt_id].status = NO_INGREDIENTS;
-            printf("[Banda %d] Faltan ingredientes para la orden #%u. Pausando...\n", belt_id, current_order.order_id);
-
-            // y volverá a intentar procesar esta misma orden después del sleep.
-
-            sleep(3); // Esperamos un tiempo para no saturar el sistema re-intentando.
-        }
+        // El despachador ya dejó el lote como el de la banda.
+        belt_prepare_inflight(shared_state, belt_id);
     }
 
-    printf("[Banda %d, PID %d] Terminando...\n", belt_id, getpid());
-    munmap(shared_state, sizeof(SharedSystemState));
+    log_event(shared_state, belt_id, LOG_INFO, LOG_EV_BELT_EXIT, getpid(), 0);
+    shm_detach(shared_state);
 }
\ No newline at end of file
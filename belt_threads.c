@@ -0,0 +1,164 @@
+// File: belt_threads.c
+//
+// modo alternativo de ejecucion: todas las bandas corren como hilos de un
+// solo proceso. cada hilo tiene su propio deque de ordenes que llena desde
+// el despachador compartido, y los hilos ociosos roban trabajo de los deques
+// de los demas. asi se evita un proceso y un cambio de contexto por banda.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "shared_data.h"
+#include "dispatcher.h"
+#include "work_deque.h"
+#include "clock_utils.h"
+#include "belt.h"
+
+// capacidad del deque de cada hilo (mayor que cualquier lote)
+#define DEQUE_CAPACITY 64
+
+typedef struct {
+    WorkDeque deque;
+    pthread_t thread;
+    int id;
+    unsigned int rng;
+} BeltThread;
+
+static SharedSystemState *shared_state = NULL;
+static BeltThread *belt_threads = NULL;
+static int num_threads = 0;
+
+// llena el deque propio con un lote de ordenes despachadas (ingredientes
+// ya reservados). devuelve cuantas tomo
+static int refill_from_dispatcher(BeltThread *t)
+{
+    // el lote es proporcional a lo que espera, para no acaparar trabajo
+    BurgerOrder batch[MAX_BATCH_SIZE];
+    int want = dispatcher_batch_size(shared_state, num_threads);
+    int n = dispatcher_try_batch(shared_state, batch, want);
+    if (n > 0 && shared_state->config.batch_size > 1)
+        belt_count_batch(state_belt(shared_state, t->id), n);
+    // empujamos de la mas nueva a la mas antigua: el dueno saca por abajo,
+    // asi atiende primero la mas antigua y los ladrones se llevan las nuevas
+    for (int i = n - 1; i >= 0; i--)
+        work_deque_push(&t->deque, &batch[i]);
+    return n;
+}
+
+static bool steal_work(BeltThread *t, BurgerOrder *out)
+{
+    int start = rand_r(&t->rng) % num_threads;
+    for (int k = 0; k < num_threads; k++)
+    {
+        BeltThread *victim = &belt_threads[(start + k) % num_threads];
+        if (victim == t)
+            continue;
+        if (work_deque_steal(&victim->deque, out))
+        {
+            belt_count_stolen(state_belt(shared_state, t->id));
+            return true;
+        }
+    }
+    return false;
+}
+
+// siguiente orden del hilo: primero su deque, luego el despachador y por
+// ultimo los deques de los demas. duerme solo si no hay nada en ningun lado
+static bool next_order(BeltThread *t, BurgerOrder *out)
+{
+    OrderQueue *q = &shared_state->waiting_orders;
+    PreparationBelt *belt = state_belt(shared_state, t->id);
+    for (;;)
+    {
+        if (work_deque_pop(&t->deque, out))
+            return true;
+
+        uint32_t key = ec_prepare_wait(&q->not_empty);
+        // pausa o retiro: volvemos al punto seguro del lazo principal
+        if (atomic_load_explicit(&belt->command, memory_order_acquire) != BELT_RUN)
+        {
+            ec_cancel_wait(&q->not_empty);
+            return false;
+        }
+        int taken = refill_from_dispatcher(t);
+        if (taken > 0)
+        {
+            ec_cancel_wait(&q->not_empty);
+            // dejamos trabajo para robar: despertamos a un hilo ocioso
+            if (taken > 1)
+                ec_notify(&q->not_empty, false);
+            continue;
+        }
+        if (steal_work(t, out))
+        {
+            ec_cancel_wait(&q->not_empty);
+            return true;
+        }
+        if (!shared_state->system_running)
+        {
+            ec_cancel_wait(&q->not_empty);
+            return false;
+        }
+        unsigned int blocked_id = dispatcher_blocked_order(shared_state);
+        belt_set_state(belt, blocked_id != 0 ? NO_INGREDIENTS : IDLE, blocked_id);
+        ec_wait(&q->not_empty, key);
+    }
+}
+
+static void *belt_thread_main(void *arg)
+{
+    BeltThread *t = arg;
+    PreparationBelt *belt = state_belt(shared_state, t->id);
+
+    affinity_pin_belt(&shared_state->config.affinity, t->id);
+    belt_recover(shared_state, t->id);
+    while (belt_wait_runnable(shared_state, t->id))
+    {
+        belt_set_state(belt, IDLE, 0);
+
+        BurgerOrder order;
+        // false: apagado o comando de la interfaz (el deque propio ya esta vacio)
+        if (!next_order(t, &order))
+            continue;
+        order.dequeued_ns = now_ns();
+        belt_prepare_order(shared_state, t->id, &order);
+    }
+    return NULL;
+}
+
+void start_belt_threads_process(int num_belts, const char *shm_name)
+{
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL) { exit(1); }
+
+    num_threads = num_belts;
+    belt_threads = aligned_alloc(CACHE_LINE_SIZE, sizeof(BeltThread) * num_threads);
+    if (belt_threads == NULL) { perror("aligned_alloc (belt threads)"); exit(1); }
+    for (int i = 0; i < num_threads; i++)
+    {
+        belt_threads[i].id = i;
+        belt_threads[i].rng = (unsigned int)getpid() ^ (unsigned int)(i * 2654435761u);
+        if (!work_deque_init(&belt_threads[i].deque, DEQUE_CAPACITY)) { perror("calloc (deque)"); exit(1); }
+    }
+
+    printf("[Bandas, PID %d] %d bandas como hilos con robo de trabajo.\n", getpid(), num_threads);
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&belt_threads[i].thread, NULL, belt_thread_main, &belt_threads[i]) != 0)
+        {
+            perror("pthread_create (banda)");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        pthread_join(belt_threads[i].thread, NULL);
+        work_deque_destroy(&belt_threads[i].deque);
+    }
+    free(belt_threads);
+
+    printf("[Bandas, PID %d] Terminando...\n", getpid());
+    shm_detach(shared_state);
+}
@@ -0,0 +1,362 @@
+// File: burger_stat.c
+//
+// muestra las estadisticas de una corrida de burger_machine en curso. solo
+// mapea el segmento de estadisticas en modo lectura: no toca la memoria
+// compartida de las bandas ni necesita terminal
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include "stats_segment.h"
+#include "clock_utils.h"
+
+// cada cuantas filas se repite la cabecera en modo intervalo (como vmstat)
+#define HEADER_EVERY 20
+
+static const char *status_name(uint32_t status, bool json)
+{
+    switch (status)
+    {
+    case IDLE:
+        return json ? "idle" : "Esperando";
+    case PREPARING:
+        return json ? "preparing" : "Preparando";
+    case PAUSED:
+        return json ? "paused" : "Pausada";
+    case NO_INGREDIENTS:
+        return json ? "no_ingredients" : "Faltan ing.";
+    case DRAINED:
+        return json ? "drained" : "Retirada";
+    default:
+        return json ? "unknown" : "Desconocido";
+    }
+}
+
+// fraccion del tiempo de la corrida que los trabajadores de la etapa
+// estuvieron preparando
+static double stage_utilization(const StatsSegment *s, const StageStat *stage)
+{
+    uint64_t uptime = s->sample_ns - s->start_ns;
+    return uptime > 0 && stage->workers > 0 ? (double)stage->busy_ns / ((double)uptime * stage->workers) : 0.0;
+}
+
+// fraccion de las ordenes terminadas de la clase que no cumplieron su plazo
+static double class_miss_rate(const ClassStat *cs)
+{
+    return cs->lateness.total ? (double)cs->missed / cs->lateness.total : 0.0;
+}
+
+static void print_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Uso: %s [opciones] [intervalo [cantidad]]\n"
+            "  sin intervalo imprime una foto completa de la corrida y termina;\n"
+            "  con intervalo (segundos) imprime una fila por intervalo, como vmstat\n"
+            "  -j, --json            una linea JSON por muestra (contadores acumulados)\n"
+            "  -h, --help            muestra esta ayuda\n",
+            prog);
+}
+
+static void print_text(const StatsSegment *s)
+{
+    double uptime = (s->sample_ns - s->start_ns) / 1e9;
+    printf("burger_machine (pid %d): %s, %.1f s, %lu fotos\n", (int)s->publisher_pid,
+           s->running ? "en curso" : "terminada", uptime, (unsigned long)s->samples);
+    printf("Ordenes: generadas %lu | completadas %lu | descartadas %lu | esperaron en el generador %lu\n",
+           (unsigned long)s->orders_generated, (unsigned long)s->orders_completed,
+           (unsigned long)s->orders_dropped, (unsigned long)s->orders_backlogged);
+    printf("Throughput medio: %.1f ordenes/s\n", uptime > 0 ? s->orders_completed / uptime : 0.0);
+    printf("Cola: %u/%u (maxima %u) | mayor espera en el generador %u\n", s->queue_depth, s->queue_capacity,
+           s->depth_max, s->backlog_max);
+    printf("Inventario:");
+    for (uint32_t i = 0; i < s->num_ingredients; i++)
+    {
+        printf("%s %s %ld", i ? " |" : "", s->ingredient_names[i], (long)s->stock[i]);
+    }
+    printf("\n");
+    if (s->auto_restock)
+    {
+        printf("Reposicion automatica: %lu pedidos, %lu unidades | bandas paradas %.2f s (evitado %.2f s)\n",
+               (unsigned long)s->restock_orders, (unsigned long)s->restock_units, s->stall_ns / 1e9,
+               s->stall_ns_avoided / 1e9);
+        printf("Se agota en:");
+        for (uint32_t i = 0; i < s->num_ingredients; i++)
+        {
+            if (s->depletion_ms[i] < 0)
+                printf("%s %s -", i ? " |" : "", s->ingredient_names[i]);
+            else
+                printf("%s %s %.1f s (%.1f/s)", i ? " |" : "", s->ingredient_names[i], s->depletion_ms[i] / 1000.0,
+                       s->demand_milli[i] / 1000.0);
+        }
+        printf("\n");
+    }
+
+    const char *labels[3] = {"espera en cola", "en la banda   ", "total         "};
+    const LatencyHistogram *hists[3] = {&s->queue_wait, &s->service, &s->total};
+    printf("Latencias (%lu ordenes):\n", (unsigned long)s->total.total);
+    for (int k = 0; k < 3; k++)
+    {
+        char p50[16], p99[16], p999[16], max[16];
+        hist_format_ns(p50, sizeof(p50), hist_percentile(hists[k], 50.0));
+        hist_format_ns(p99, sizeof(p99), hist_percentile(hists[k], 99.0));
+        hist_format_ns(p999, sizeof(p999), hist_percentile(hists[k], 99.9));
+        hist_format_ns(max, sizeof(max), hists[k]->max_ns);
+        printf("  %s: p50 %-8s p99 %-8s p999 %-8s max %s\n", labels[k], p50, p99, p999, max);
+    }
+
+    if (s->num_stages > 0)
+    {
+        printf("Etapa       Trabajadores  Cola       Maxima  Ordenes    Utilizacion\n");
+        for (uint32_t k = 0; k < s->num_stages; k++)
+        {
+            const StageStat *st = &s->stages[k];
+            char queue[24];
+            snprintf(queue, sizeof(queue), "%u/%u", st->queue_depth, st->queue_capacity);
+            printf("%-10s  %-12u  %-9s  %-6u  %-9lu  %.0f%%\n", st->name, st->workers, queue, st->depth_max,
+                   (unsigned long)st->processed, stage_utilization(s, st) * 100.0);
+        }
+    }
+
+    if (s->num_classes > 1)
+    {
+        printf("Clase       Plazo     Cola    Ordenes    Fuera de plazo  Retraso p99  max   (%s)\n",
+               s->edf ? "edf" : "por llegada");
+        for (uint32_t c = 0; c < s->num_classes; c++)
+        {
+            const ClassStat *cs = &s->classes[c];
+            char deadline[16], p99[16], max[16];
+            hist_format_ns(deadline, sizeof(deadline), cs->deadline_us * 1000);
+            hist_format_ns(p99, sizeof(p99), hist_percentile(&cs->lateness, 99.0));
+            hist_format_ns(max, sizeof(max), cs->lateness.max_ns);
+            printf("%-10s  %-8s  %-6u  %-9lu  %-6lu (%5.1f%%)  %-11s  %s\n", s->class_names[c], deadline,
+                   cs->queue_depth, (unsigned long)cs->lateness.total, (unsigned long)cs->missed,
+                   class_miss_rate(cs) * 100.0, p99, max);
+        }
+    }
+
+    printf("Banda  PID      Estado       Ordenes    Robadas\n");
+    for (uint32_t i = 0; i < s->num_belts; i++)
+    {
+        const BeltStat *b = &s->belts[i];
+        printf("%-5u  %-7d  %-11s  %-9lu  %lu\n", i, (int)b->pid, status_name(b->status, false),
+               (unsigned long)b->processed, (unsigned long)b->stolen);
+    }
+}
+
+static void print_json_hist(const char *name, const LatencyHistogram *h, bool last)
+{
+    printf("\"%s\":{\"count\":%lu,\"mean\":%lu,\"p50\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu}%s", name,
+           (unsigned long)h->total, (unsigned long)(h->total ? h->sum_ns / h->total : 0),
+           (unsigned long)hist_percentile(h, 50.0), (unsigned long)hist_percentile(h, 99.0),
+           (unsigned long)hist_percentile(h, 99.9), (unsigned long)h->max_ns, last ? "" : ",");
+}
+
+static void print_json(const StatsSegment *s)
+{
+    printf("{\"pid\":%d,\"running\":%s,\"uptime_s\":%.3f,\"samples\":%lu,", (int)s->publisher_pid,
+           s->running ? "true" : "false", (s->sample_ns - s->start_ns) / 1e9, (unsigned long)s->samples);
+    printf("\"orders\":{\"generated\":%lu,\"completed\":%lu,\"dropped\":%lu,\"backlogged\":%lu},",
+           (unsigned long)s->orders_generated, (unsigned long)s->orders_completed,
+           (unsigned long)s->orders_dropped, (unsigned long)s->orders_backlogged);
+    printf("\"queue\":{\"depth\":%u,\"capacity\":%u,\"max\":%u},\"backlog_max\":%u,", s->queue_depth,
+           s->queue_capacity, s->depth_max, s->backlog_max);
+    printf("\"stock\":{");
+    for (uint32_t i = 0; i < s->num_ingredients; i++)
+    {
+        printf("%s\"%s\":%ld", i ? "," : "", s->ingredient_names[i], (long)s->stock[i]);
+    }
+    printf("},\"restock\":{\"enabled\":%s,\"orders\":%lu,\"units\":%lu,\"stall_s\":%.3f,\"stall_avoided_s\":%.3f,"
+           "\"ingredients\":{",
+           s->auto_restock ? "true" : "false", (unsigned long)s->restock_orders, (unsigned long)s->restock_units,
+           s->stall_ns / 1e9, s->stall_ns_avoided / 1e9);
+    for (uint32_t i = 0; i < s->num_ingredients; i++)
+    {
+        printf("%s\"%s\":{\"rate\":%.3f,\"depletion_ms\":%ld}", i ? "," : "", s->ingredient_names[i],
+               s->demand_milli[i] / 1000.0, (long)s->depletion_ms[i]);
+    }
+    printf("}},\"latency_ns\":{");
+    print_json_hist("queue_wait", &s->queue_wait, false);
+    print_json_hist("service", &s->service, false);
+    print_json_hist("total", &s->total, true);
+    printf("},\"stages\":[");
+    for (uint32_t k = 0; k < s->num_stages; k++)
+    {
+        const StageStat *st = &s->stages[k];
+        printf("%s{\"name\":\"%s\",\"workers\":%u,\"queue\":{\"depth\":%u,\"capacity\":%u,\"max\":%u},"
+               "\"processed\":%lu,\"busy_ns\":%lu,\"utilization\":%.3f}",
+               k ? "," : "", st->name, st->workers, st->queue_depth, st->queue_capacity, st->depth_max,
+               (unsigned long)st->processed, (unsigned long)st->busy_ns, stage_utilization(s, st));
+    }
+    printf("],\"edf\":%s,\"classes\":[", s->edf ? "true" : "false");
+    for (uint32_t c = 0; c < s->num_classes; c++)
+    {
+        const ClassStat *cs = &s->classes[c];
+        printf("%s{\"name\":\"%s\",\"deadline_us\":%lu,\"queue\":%u,\"missed\":%lu,\"miss_rate\":%.4f,",
+               c ? "," : "", s->class_names[c], (unsigned long)cs->deadline_us, cs->queue_depth,
+               (unsigned long)cs->missed, class_miss_rate(cs));
+        print_json_hist("lateness_ns", &cs->lateness, true);
+        printf("}");
+    }
+    printf("],\"belts\":[");
+    for (uint32_t i = 0; i < s->num_belts; i++)
+    {
+        const BeltStat *b = &s->belts[i];
+        printf("%s{\"id\":%u,\"pid\":%d,\"status\":\"%s\",\"processed\":%lu,\"stolen\":%lu}", i ? "," : "", i,
+               (int)b->pid, status_name(b->status, true), (unsigned long)b->processed, (unsigned long)b->stolen);
+    }
+    printf("]}\n");
+}
+
+static void print_row_header(void)
+{
+    printf("%8s %10s %10s %10s %7s %9s %9s %9s %9s\n", "segundos", "gen/s", "hechas/s", "desc/s", "cola",
+           "stock_min", "p50", "p99", "p999");
+}
+
+// una fila con lo ocurrido entre prev y cur
+static void print_row(const StatsSegment *prev, const StatsSegment *cur)
+{
+    double dt = (cur->sample_ns - prev->sample_ns) / 1e9;
+    if (dt <= 0)
+        dt = 1e-9;
+    long stock_min = 0;
+    for (uint32_t i = 0; i < cur->num_ingredients; i++)
+    {
+        if (i == 0 || cur->stock[i] < stock_min)
+            stock_min = cur->stock[i];
+    }
+    static LatencyHistogram delta;
+    hist_delta(&delta, &prev->total, &cur->total);
+    char p50[16] = "-", p99[16] = "-", p999[16] = "-";
+    if (delta.total > 0)
+    {
+        hist_format_ns(p50, sizeof(p50), hist_percentile(&delta, 50.0));
+        hist_format_ns(p99, sizeof(p99), hist_percentile(&delta, 99.0));
+        hist_format_ns(p999, sizeof(p999), hist_percentile(&delta, 99.9));
+    }
+    printf("%8.1f %10.1f %10.1f %10.1f %7u %9ld %9s %9s %9s\n", (cur->sample_ns - cur->start_ns) / 1e9,
+           (cur->orders_generated - prev->orders_generated) / dt, (cur->orders_completed - prev->orders_completed) / dt,
+           (cur->orders_dropped - prev->orders_dropped) / dt, cur->queue_depth, stock_min, p50, p99, p999);
+}
+
+static bool publisher_alive(const StatsSegment *s)
+{
+    return kill(s->publisher_pid, 0) == 0 || errno != ESRCH;
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    static const struct option long_options[] = {
+        {"json", no_argument, NULL, 'j'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "jh", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            json = true;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    double interval = 0;
+    long count = 0;
+    if (optind < argc)
+    {
+        char *end;
+        interval = strtod(argv[optind++], &end);
+        if (*end != '\0' || interval <= 0)
+        {
+            fprintf(stderr, "Error: intervalo invalido.\n");
+            return 1;
+        }
+    }
+    if (optind < argc)
+    {
+        char *end;
+        count = strtol(argv[optind++], &end, 10);
+        if (*end != '\0' || count <= 0)
+        {
+            fprintf(stderr, "Error: cantidad invalida.\n");
+            return 1;
+        }
+    }
+
+    const StatsSegment *seg = stats_segment_attach();
+    if (seg == NULL)
+    {
+        fprintf(stderr, "Error: no hay ninguna corrida de burger_machine publicando estadisticas.\n");
+        return 1;
+    }
+    // dos fotos privadas (anterior y actual) que se van alternando
+    size_t size = (seg->total_size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    StatsSegment *prev = aligned_alloc(CACHE_LINE_SIZE, size);
+    StatsSegment *cur = aligned_alloc(CACHE_LINE_SIZE, size);
+    if (prev == NULL || cur == NULL)
+    {
+        perror("aligned_alloc");
+        return 1;
+    }
+    stats_segment_snapshot(seg, cur);
+
+    if (interval == 0)
+    {
+        if (json)
+            print_json(cur);
+        else
+            print_text(cur);
+        stats_segment_detach(seg);
+        return 0;
+    }
+
+    // la primera fila cubre desde el arranque de la corrida (como vmstat)
+    memset(prev, 0, size);
+    prev->sample_ns = cur->start_ns;
+    uint64_t interval_ns = (uint64_t)(interval * 1e9);
+    uint64_t next = now_ns();
+    for (long row = 0; count == 0 || row < count; row++)
+    {
+        if (row > 0)
+        {
+            next += interval_ns;
+            sleep_until_ns(next);
+            StatsSegment *tmp = prev;
+            prev = cur;
+            cur = tmp;
+            stats_segment_snapshot(seg, cur);
+        }
+        if (json)
+            print_json(cur);
+        else
+        {
+            if (row % HEADER_EVERY == 0)
+                print_row_header();
+            print_row(prev, cur);
+        }
+        fflush(stdout);
+        if (!cur->running)
+            break;
+        if (!publisher_alive(cur))
+        {
+            fprintf(stderr, "burger_machine (pid %d) termino sin publicar la ultima foto.\n", (int)cur->publisher_pid);
+            break;
+        }
+    }
+    stats_segment_detach(seg);
+    free(prev);
+    free(cur);
+    return 0;
+}
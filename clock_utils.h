@@ -0,0 +1,37 @@
+// File: clock_utils.h
+
+#ifndef CLOCK_UTILS_H
+#define CLOCK_UTILS_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+// tiempo monotono en nanosegundos
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// duerme la cantidad de microsegundos indicada (0 no duerme)
+static inline void sleep_us(unsigned int us)
+{
+    if (us == 0)
+        return;
+    struct timespec ts = {us / 1000000, (long)(us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+// duerme hasta el instante absoluto deadline_ns (reloj monotono). sirve para
+// marcar un ritmo sin acumular el error de cada espera
+static inline void sleep_until_ns(uint64_t deadline_ns)
+{
+    struct timespec ts = {(time_t)(deadline_ns / 1000000000ull), (long)(deadline_ns % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+#endif
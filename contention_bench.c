@@ -0,0 +1,225 @@
+// File: contention_bench.c
+//
+// microbenchmark de contencion de los caminos calientes: varios hilos
+// reservan y devuelven los ingredientes de una hamburguesa completa al mismo
+// tiempo, con el inventario empaquetado (un CAS por orden) y con el esquema
+// clasico de un mutex por ingrediente, y encolan y desencolan ordenes en la
+// cola sin bloqueos. ademas de la tasa mide la latencia de una operacion de
+// cada 64 (p50 y p99).
+//
+// la memoria compartida de las pruebas se mapea como el segmento del
+// programa, y las opciones permiten comparar su ubicacion:
+//   -p  fija el hilo t a la cpu t (modulo las cpus en linea)
+//   -H  paginas enormes (MAP_HUGETLB; si no hay reservadas, paginas
+//       transparentes con madvise)
+//   -P  mapeo prepoblado (MAP_POPULATE) y fijado en memoria (mlock)
+//
+// uso: ./contention_bench [-p] [-H] [-P] [segundos_por_prueba] [max_hilos]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "shared_data.h"
+#include "inventory.h"
+#include "order_queue.h"
+#include "latency_hist.h"
+#include "affinity.h"
+#include "clock_utils.h"
+
+#define BENCH_QUEUE_CAPACITY 1024
+#define BENCH_SAMPLE_MASK 63            // se mide una operacion de cada 64
+
+typedef enum { CASE_CAS, CASE_MUTEX, CASE_QUEUE } BenchCase;
+
+static const char *case_names[] = {"cas", "mutex", "cola"};
+
+// lo que comparten los hilos; vive en un solo mapeo, como el segmento
+typedef struct {
+    Inventory inventory;
+    OrderQueue queue;
+    OrderSlot slots[BENCH_QUEUE_CAPACITY];
+} BenchArena;
+
+typedef struct {
+    BenchArena *arena;
+    BenchCase kind;
+    int cpu;                      // -1: sin fijar
+    atomic_bool *running;
+    uint64_t operations;
+    uint64_t failures;
+    LatencyHistogram latency;
+} Worker;
+
+static bool pin_threads = false;
+static bool use_hugepages = false;
+static bool prefault = false;
+
+// ingredientes de una hamburguesa con todo
+static const uint8_t burger_needs[MAX_INGREDIENTS] = {2, 1, 1, 1, 1, 1};
+
+static bool run_operation(Worker *w, BurgerOrder *order)
+{
+    if (w->kind == CASE_QUEUE)
+    {
+        if (!order_queue_try_push(&w->arena->queue, order))
+            return false;
+        return order_queue_try_pop(&w->arena->queue, order);
+    }
+    if (!inventory_try_take(&w->arena->inventory, burger_needs))
+        return false;
+    inventory_give_back(&w->arena->inventory, burger_needs);
+    return true;
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    if (w->cpu >= 0)
+        affinity_pin_cpu(w->cpu);
+    BurgerOrder order = {0};
+    while (atomic_load_explicit(w->running, memory_order_relaxed))
+    {
+        bool ok;
+        if (((w->operations + w->failures) & BENCH_SAMPLE_MASK) == 0)
+        {
+            uint64_t t0 = now_ns();
+            ok = run_operation(w, &order);
+            hist_record(&w->latency, now_ns() - t0);
+        }
+        else
+        {
+            ok = run_operation(w, &order);
+        }
+        if (ok)
+            w->operations++;
+        else
+            w->failures++;
+    }
+    return NULL;
+}
+
+// mapea la arena como se pidio; si no hay paginas enormes reservadas sigue
+// con paginas normales y se lo pide al kernel como paginas transparentes
+static BenchArena *arena_map(size_t *size)
+{
+    size_t huge = 2u << 20;
+    *size = use_hugepages ? (sizeof(BenchArena) + huge - 1) & ~(huge - 1) : sizeof(BenchArena);
+    int flags = MAP_SHARED | MAP_ANONYMOUS | (prefault ? MAP_POPULATE : 0);
+    BenchArena *arena = MAP_FAILED;
+    if (use_hugepages)
+    {
+        arena = mmap(NULL, *size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (arena == MAP_FAILED)
+        {
+            static bool warned = false;
+            if (!warned)
+                perror("mmap MAP_HUGETLB (se usan paginas transparentes)");
+            warned = true;
+        }
+    }
+    if (arena == MAP_FAILED)
+    {
+        arena = mmap(NULL, *size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (arena == MAP_FAILED)
+        {
+            perror("mmap");
+            exit(1);
+        }
+        if (use_hugepages)
+            madvise(arena, *size, MADV_HUGEPAGE);
+    }
+    if (prefault && mlock(arena, *size) == -1)
+    {
+        static bool warned = false;
+        if (!warned)
+            perror("mlock");
+        warned = true;
+    }
+    return arena;
+}
+
+static void run_case(BenchCase kind, int threads, double seconds)
+{
+    size_t arena_size;
+    BenchArena *arena = arena_map(&arena_size);
+    int counts[MAX_INGREDIENTS] = {0};
+    for (int i = 0; i <= CHEESE; i++)
+        counts[i] = 1000000;
+    inventory_init(&arena->inventory, CHEESE + 1, counts, kind == CASE_MUTEX);
+    order_queue_init(&arena->queue, arena->slots, BENCH_QUEUE_CAPACITY, 1);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    atomic_bool running = true;
+    pthread_t tids[threads];
+    Worker *workers = calloc(threads, sizeof(Worker));
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].arena = arena;
+        workers[t].kind = kind;
+        workers[t].cpu = pin_threads ? (int)(t % cpus) : -1;
+        workers[t].running = &running;
+        pthread_create(&tids[t], NULL, worker_main, &workers[t]);
+    }
+    uint64_t start = now_ns();
+    sleep_us((unsigned)(seconds * 1e6));
+    atomic_store(&running, false);
+    uint64_t total = 0, failures = 0;
+    LatencyHistogram latency;
+    memset(&latency, 0, sizeof(latency));
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(tids[t], NULL);
+        total += workers[t].operations;
+        failures += workers[t].failures;
+        hist_merge(&latency, &workers[t].latency);
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // cada operacion es una reserva completa mas su devolucion, o un
+    // encolado mas un desencolado
+    printf("%-10s hilos=%-3d ops/s=%12.0f ns_por_op=%8.1f p50_ns=%6lu p99_ns=%6lu fallos=%lu\n",
+           case_names[kind], threads, total / elapsed, total ? elapsed * 1e9 * threads / total : 0.0,
+           (unsigned long)hist_percentile(&latency, 50.0), (unsigned long)hist_percentile(&latency, 99.0),
+           (unsigned long)failures);
+
+    inventory_destroy(&arena->inventory);
+    free(workers);
+    munmap(arena, arena_size);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "pHP")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': pin_threads = true; break;
+        case 'H': use_hugepages = true; break;
+        case 'P': prefault = true; break;
+        default:
+            fprintf(stderr, "Uso: %s [-p] [-H] [-P] [segundos_por_prueba] [max_hilos]\n", argv[0]);
+            return 1;
+        }
+    }
+    double seconds = optind < argc ? atof(argv[optind]) : 1.0;
+    int max_threads = optind + 1 < argc ? atoi(argv[optind + 1]) : 8;
+    if (seconds <= 0 || max_threads <= 0)
+    {
+        fprintf(stderr, "Uso: %s [-p] [-H] [-P] [segundos_por_prueba] [max_hilos]\n", argv[0]);
+        return 1;
+    }
+    printf("# fijar=%s paginas_enormes=%s prepoblar=%s\n", pin_threads ? "si" : "no", use_hugepages ? "si" : "no",
+           prefault ? "si" : "no");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        run_case(CASE_CAS, threads, seconds);
+        run_case(CASE_MUTEX, threads, seconds);
+        run_case(CASE_QUEUE, threads, seconds);
+    }
+    return 0;
+}
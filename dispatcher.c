@@ -0,0 +1,516 @@
+// File: dispatcher.c
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dispatcher.h"
+#include "order_queue.h"
+#include "inventory.h"
+#include "clock_utils.h"
+#include "journal.h"
+#include "packed_order.h"
+#include "pipeline.h"
+#include "belt.h"
+
+static uint32_t window_full_mask(int size)
+{
+    return size >= 32 ? 0xFFFFFFFFu : (1u << size) - 1;
+}
+
+// asigna una casilla libre de la ventana (-1 si esta llena)
+static int window_alloc(DispatchWindow *w, int size)
+{
+    uint32_t used = atomic_load(&w->used);
+    for (;;)
+    {
+        uint32_t free_slots = ~used & window_full_mask(size);
+        if (free_slots == 0)
+            return -1;
+        int i = __builtin_ctz(free_slots);
+        if (atomic_compare_exchange_weak(&w->used, &used, used | (1u << i)))
+            return i;
+    }
+}
+
+// asigna hasta want casillas libres con un solo CAS; devuelve su mascara
+static uint32_t window_alloc_many(DispatchWindow *w, int size, int want)
+{
+    uint32_t used = atomic_load(&w->used);
+    for (;;)
+    {
+        uint32_t free_slots = ~used & window_full_mask(size);
+        uint32_t take = 0;
+        for (int k = 0; k < want && free_slots; k++)
+        {
+            take |= free_slots & -free_slots;
+            free_slots &= free_slots - 1;
+        }
+        if (take == 0)
+            return 0;
+        if (atomic_compare_exchange_weak(&w->used, &used, used | take))
+            return take;
+    }
+}
+
+static void window_free(DispatchWindow *w, int i)
+{
+    atomic_fetch_and(&w->used, ~(1u << i));
+}
+
+// deja la casilla lista para que cualquier banda la reclame
+static void window_publish(DispatchWindow *w, int i)
+{
+    atomic_fetch_or(&w->ready, 1u << i);
+}
+
+// reclama la casilla: solo una banda puede ganarla
+static bool window_claim(DispatchWindow *w, int i)
+{
+    return (atomic_fetch_and(&w->ready, ~(1u << i)) & (1u << i)) != 0;
+}
+
+// deja esperando en la casilla i la orden que ya se copio en ella. con
+// edf la ventana la ordena por plazo, si no por llegada
+static void window_park(DispatchWindow *w, int i, bool edf)
+{
+    WindowSlot *slot = &w->slots[i];
+    uint64_t words[2];
+    memcpy(words, &slot->order.packed, sizeof(words));
+    atomic_store_explicit(&slot->needs[0], words[0], memory_order_relaxed);
+    atomic_store_explicit(&slot->needs[1], words[1], memory_order_relaxed);
+    atomic_store_explicit(&slot->skips, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->rank_ns, edf ? slot->order.deadline_ns : slot->order.enqueued_ns,
+                          memory_order_relaxed);
+    window_publish(w, i);
+}
+
+// se despacho una orden de la cola: todas las que esperan en la ventana
+// son mas antiguas y fueron adelantadas
+static void skip_waiting(DispatchWindow *w)
+{
+    uint32_t ready = atomic_load(&w->ready);
+    while (ready)
+    {
+        int j = __builtin_ctz(ready);
+        ready &= ready - 1;
+        atomic_fetch_add_explicit(&w->slots[j].skips, 1, memory_order_relaxed);
+    }
+}
+
+// ordena los indices de las casillas por rango: antiguedad o, con edf,
+// plazo (insercion, n <= 32)
+static int window_candidates(DispatchWindow *w, int idx[MAX_DISPATCH_WINDOW])
+{
+    uint32_t ready = atomic_load(&w->ready);
+    uint64_t rank[MAX_DISPATCH_WINDOW];
+    int n = 0;
+    while (ready)
+    {
+        int i = __builtin_ctz(ready);
+        ready &= ready - 1;
+        uint64_t t = atomic_load_explicit(&w->slots[i].rank_ns, memory_order_relaxed);
+        int k = n++;
+        while (k > 0 && rank[k - 1] > t)
+        {
+            rank[k] = rank[k - 1];
+            idx[k] = idx[k - 1];
+            k--;
+        }
+        rank[k] = t;
+        idx[k] = i;
+    }
+    return n;
+}
+
+// copia empaquetada de la orden que espera en la casilla i (sin reclamarla)
+static void window_peek(DispatchWindow *w, int i, PackedOrder *out)
+{
+    uint64_t words[2] = {
+        atomic_load_explicit(&w->slots[i].needs[0], memory_order_relaxed),
+        atomic_load_explicit(&w->slots[i].needs[1], memory_order_relaxed),
+    };
+    memcpy(out, words, sizeof(words));
+}
+
+void dispatcher_init(DispatchWindow *window)
+{
+    atomic_init(&window->used, 0);
+    atomic_init(&window->ready, 0);
+}
+
+// quien despacha: la banda en cuyo registro se anotan las casillas que
+// toma (NULL: nadie, como en la simulacion o las bandas hilo, que no mueren
+// solas) y si las ordenes reservadas pasan a ser su lote en curso antes de
+// soltar las casillas (bandas proceso). asi, muera donde muera, la banda
+// que la reemplaza encuentra cada orden en la ventana o en ese lote
+typedef struct {
+    PreparationBelt *belt;
+    bool inflight;
+} DispatchOwner;
+
+static void owner_hold(const DispatchOwner *o, uint32_t mask, bool filled)
+{
+    if (o->belt == NULL)
+        return;
+    if (filled)
+        atomic_fetch_or(&o->belt->window_filled, mask);
+    atomic_fetch_or(&o->belt->window_held, mask);
+}
+
+static void owner_fill(const DispatchOwner *o, uint32_t mask)
+{
+    if (o->belt != NULL)
+        atomic_fetch_or(&o->belt->window_filled, mask);
+}
+
+static void owner_release(const DispatchOwner *o, uint32_t mask)
+{
+    if (o->belt == NULL)
+        return;
+    atomic_fetch_and(&o->belt->window_held, ~mask);
+    atomic_fetch_and(&o->belt->window_filled, ~mask);
+}
+
+// las ordenes out[0..n) ya tienen sus ingredientes: pasan a ser el lote en
+// curso de la banda mientras sus casillas siguen anotadas
+static void owner_reserved(const DispatchOwner *o, BurgerOrder out[], int n)
+{
+    if (o->belt == NULL || !o->inflight)
+        return;
+    uint64_t now = now_ns();
+    for (int k = 0; k < n; k++)
+        out[k].dequeued_ns = now;
+    belt_record_inflight(o->belt, out, n);
+}
+
+static bool try_next(SharedSystemState *state, const DispatchOwner *o, BurgerOrder *out)
+{
+    DispatchWindow *w = &state->dispatch_window;
+    Inventory *inv = &state->inventory;
+    int size = state->config.dispatch_window;
+
+    // 1. la orden mas antigua de la ventana que se pueda servir
+    int idx[MAX_DISPATCH_WINDOW];
+    int n = window_candidates(w, idx);
+    bool aged = n > 0 &&
+                (int)atomic_load_explicit(&w->slots[idx[0]].skips, memory_order_relaxed) >= state->config.aging_limit;
+    // si la mas antigua ya fue adelantada demasiadas veces, solo ella es candidata
+    int limit = aged ? 1 : n;
+    // descarte rapido: las candidatas se comparan de una vez contra una foto
+    // del inventario y solo se intenta reclamar las que podrian caber
+    uint32_t fits = 0;
+    if (limit > 0)
+    {
+        PackedOrder peek[MAX_DISPATCH_WINDOW];
+        uint8_t avail[PACKED_LANES];
+        for (int k = 0; k < limit; k++)
+            window_peek(w, idx[k], &peek[k]);
+        inventory_snapshot(inv, avail);
+        fits = packed_fits_many(peek, limit, avail);
+    }
+    for (int k = 0; k < limit; k++)
+    {
+        WindowSlot *slot = &w->slots[idx[k]];
+        uint32_t bit = 1u << idx[k];
+        if (!(fits & (1u << k)))
+            continue;
+        // se anota antes de reclamar: si la banda muere justo despues,
+        // dispatcher_recover ve si la casilla quedo publicada o es suya
+        owner_hold(o, bit, true);
+        if (!window_claim(w, idx[k]))
+        {
+            owner_release(o, bit);
+            continue;
+        }
+        if (inventory_try_take(inv, slot->order.ingredients_needed))
+        {
+            *out = slot->order;
+            owner_reserved(o, out, 1);
+            journal_append(JR_DISPATCH, out, 0);
+            window_free(w, idx[k]);
+            owner_release(o, bit);
+            // la casilla libre permite traer otra orden de la cola: si hay
+            // bandas dormidas, despertamos a una para que lo haga
+            ec_notify(&state->waiting_orders.not_empty, false);
+            // las ordenes mas antiguas que esta fueron adelantadas
+            for (int j = 0; j < k; j++)
+                atomic_fetch_add_explicit(&w->slots[idx[j]].skips, 1, memory_order_relaxed);
+            return true;
+        }
+        window_publish(w, idx[k]);
+        owner_release(o, bit);
+    }
+    if (aged)
+        return false;
+
+    // 2. ordenes nuevas de la cola: la casilla se reserva antes de sacar la
+    // orden para no quedarnos con una orden que no cabe en la ventana
+    for (;;)
+    {
+        int i = window_alloc(w, size);
+        if (i < 0)
+            return false;
+        uint32_t bit = 1u << i;
+        owner_hold(o, bit, false);
+        WindowSlot *slot = &w->slots[i];
+        if (!order_queue_try_pop(&state->waiting_orders, &slot->order))
+        {
+            window_free(w, i);
+            owner_release(o, bit);
+            return false;
+        }
+        owner_fill(o, bit);
+        if (inventory_try_take(inv, slot->order.ingredients_needed))
+        {
+            *out = slot->order;
+            owner_reserved(o, out, 1);
+            journal_append(JR_DISPATCH, out, 0);
+            window_free(w, i);
+            owner_release(o, bit);
+            skip_waiting(w);
+            return true;
+        }
+        // no se puede servir ahora: queda esperando en la ventana
+        window_park(w, i, state->config.edf);
+        owner_release(o, bit);
+    }
+}
+
+static int try_batch(SharedSystemState *state, const DispatchOwner *o, BurgerOrder out[], int max)
+{
+    DispatchWindow *w = &state->dispatch_window;
+    Inventory *inv = &state->inventory;
+    if (max > MAX_BATCH_SIZE)
+        max = MAX_BATCH_SIZE;
+    if (max <= 1 || atomic_load(&w->ready) != 0)
+        return try_next(state, o, out) ? 1 : 0;
+
+    // casillas para las ordenes del lote que no se puedan servir; el lote
+    // no pide mas ordenes que casillas consiguio
+    uint32_t slots = window_alloc_many(w, state->config.dispatch_window, max);
+    if (slots == 0)
+        return 0;
+    owner_hold(o, slots, false);
+    BurgerOrder batch[MAX_BATCH_SIZE];
+    int n = order_queue_try_pop_batch(&state->waiting_orders, batch, __builtin_popcount(slots));
+
+    // cada orden se copia enseguida en su casilla: si la banda muere antes
+    // de reservar, vuelven a la ventana
+    int slot_of[MAX_BATCH_SIZE];
+    uint32_t rest = slots, filled = 0;
+    for (int k = 0; k < n; k++)
+    {
+        slot_of[k] = __builtin_ctz(rest);
+        rest &= rest - 1;
+        w->slots[slot_of[k]].order = batch[k];
+        filled |= 1u << slot_of[k];
+    }
+    owner_fill(o, filled);
+
+    // la suma se hace carril a carril; si algun ingrediente satura, el lote
+    // no se puede reservar de una vez
+    PackedOrder total = {0};
+    bool exact = true;
+    for (int k = 0; k < n; k++)
+        exact &= packed_add(&total, &batch[k].packed);
+    int served = 0;
+    uint32_t parked = 0;
+    if (n > 0 && exact && inventory_try_take(inv, total.count))
+    {
+        // una sola reserva para todo el lote
+        for (int k = 0; k < n; k++)
+            out[served++] = batch[k];
+        owner_reserved(o, out, served);
+        for (int k = 0; k < n; k++)
+            journal_append(JR_DISPATCH, &batch[k], 0);
+        skip_waiting(w);
+    }
+    else
+    {
+        // la suma no alcanza: de a una, en orden de llegada
+        for (int k = 0; k < n; k++)
+        {
+            if (inventory_try_take(inv, batch[k].ingredients_needed))
+            {
+                out[served++] = batch[k];
+                owner_reserved(o, out, served);
+                journal_append(JR_DISPATCH, &batch[k], 0);
+                skip_waiting(w);
+                continue;
+            }
+            // la que no se puede servir queda esperando en su casilla
+            window_park(w, slot_of[k], state->config.edf);
+            owner_release(o, 1u << slot_of[k]);
+            parked |= 1u << slot_of[k];
+        }
+    }
+    // las casillas de las despachadas y las que no hicieron falta
+    uint32_t unused = slots & ~parked;
+    if (unused != 0)
+        atomic_fetch_and(&w->used, ~unused);
+    owner_release(o, unused);
+    return served;
+}
+
+bool dispatcher_try_next(SharedSystemState *state, BurgerOrder *out)
+{
+    DispatchOwner nobody = {NULL, false};
+    return try_next(state, &nobody, out);
+}
+
+int dispatcher_try_batch(SharedSystemState *state, BurgerOrder out[], int max)
+{
+    DispatchOwner nobody = {NULL, false};
+    return try_batch(state, &nobody, out, max);
+}
+
+// la orden order_id es del lote en curso de la banda y no se termino
+static bool in_inflight(PreparationBelt *belt, unsigned int order_id)
+{
+    uint32_t count = atomic_load_explicit(&belt->inflight_count, memory_order_acquire);
+    for (uint32_t k = atomic_load_explicit(&belt->inflight_done, memory_order_acquire); k < count; k++)
+    {
+        if (belt->inflight[k].order_id == order_id)
+            return true;
+    }
+    return false;
+}
+
+void dispatcher_recover(SharedSystemState *state, int belt_id)
+{
+    DispatchWindow *w = &state->dispatch_window;
+    PreparationBelt *belt = state_belt(state, belt_id);
+    uint32_t held = atomic_load(&belt->window_held);
+    uint32_t filled = atomic_load(&belt->window_filled);
+    if (held == 0)
+        return;
+    // una casilla publicada (o que otra banda anoto al reclamarla) ya no es
+    // de la muerta
+    uint32_t others = 0;
+    for (int b = 0; b < state->num_belts; b++)
+    {
+        if (b != belt_id)
+            others |= atomic_load(&state_belt(state, b)->window_held);
+    }
+    uint32_t mine = held & atomic_load(&w->used) & ~atomic_load(&w->ready) & ~others;
+    while (mine)
+    {
+        int i = __builtin_ctz(mine);
+        mine &= mine - 1;
+        // con la orden copiada y sin reservar, vuelve a esperar en la
+        // ventana; si ya esta en el lote en curso (o no llego a traerla de
+        // la cola), la casilla solo se suelta
+        if ((filled & (1u << i)) && !in_inflight(belt, w->slots[i].order.order_id))
+            window_park(w, i, state->config.edf);
+        else
+            window_free(w, i);
+    }
+    atomic_store(&belt->window_held, 0);
+    atomic_store(&belt->window_filled, 0);
+    ec_notify(&state->waiting_orders.not_empty, true);
+}
+
+int dispatcher_batch_size(SharedSystemState *state, int belts)
+{
+    int max = state->config.batch_size;
+    if (max <= 1)
+        return 1;
+    int want = dispatcher_pending(state) / (belts > 0 ? belts : 1) + 1;
+    return want < max ? want : max;
+}
+
+unsigned int dispatcher_blocked_order(SharedSystemState *state)
+{
+    DispatchWindow *w = &state->dispatch_window;
+    int idx[MAX_DISPATCH_WINDOW];
+    if (window_candidates(w, idx) == 0)
+        return 0;
+    PackedOrder oldest;
+    window_peek(w, idx[0], &oldest);
+    return oldest.order_id;
+}
+
+int dispatcher_next(SharedSystemState *state, int belt_id, BurgerOrder out[], int max)
+{
+    OrderQueue *q = &state->waiting_orders;
+    PreparationBelt *belt = state_belt(state, belt_id);
+    // las bandas proceso pueden morir solas: las ordenes que reservan pasan
+    // a ser su lote en curso. en el pipeline las etapas las siguen
+    DispatchOwner owner = {belt, !state->config.threaded_belts && state->config.num_stages == 0};
+    bool reported = false;
+    for (;;)
+    {
+        // la ventana es la cabeza de la cola: las bandas duermen en el mismo
+        // futex de "cola no vacia", que tambien suena al reponer ingredientes
+        uint32_t key = ec_prepare_wait(&q->not_empty);
+        // una pausa o un retiro se atienden aqui, antes de tomar otra orden
+        if (atomic_load_explicit(&belt->command, memory_order_acquire) != BELT_RUN)
+        {
+            ec_cancel_wait(&q->not_empty);
+            return 0;
+        }
+        int n = try_batch(state, &owner, out, max);
+        if (n > 0)
+        {
+            ec_cancel_wait(&q->not_empty);
+            uint64_t now = now_ns();
+            for (int k = 0; k < n; k++)
+                out[k].dequeued_ns = now;
+            return n;
+        }
+        if (!state->system_running)
+        {
+            ec_cancel_wait(&q->not_empty);
+            return 0;
+        }
+        // si hay ordenes esperando en la ventana es que les faltan ingredientes
+        unsigned int blocked_id = dispatcher_blocked_order(state);
+        belt_set_state(belt, blocked_id != 0 ? NO_INGREDIENTS : IDLE, blocked_id);
+        if (blocked_id != 0 && !reported)
+        {
+            log_event(state, belt_id, LOG_WARN, LOG_EV_BELT_NO_INGREDIENTS, blocked_id, 0);
+            reported = true;
+        }
+        ec_wait(&q->not_empty, key);
+    }
+}
+
+void dispatcher_wake_all(SharedSystemState *state)
+{
+    order_queue_wake_all(&state->waiting_orders);
+    pipeline_wake_all(state);
+    // y a las pausadas
+    for (int i = 0; i < state->num_belts; i++)
+        ec_notify(&state_belt(state, i)->control, true);
+}
+
+void dispatcher_restock(SharedSystemState *state, int ingredient, int quantity)
+{
+    journal_append_restock(ingredient, quantity);
+    inventory_restock(&state->inventory, ingredient, quantity);
+    // las ordenes de la ventana pueden haberse vuelto servibles
+    ec_notify(&state->waiting_orders.not_empty, true);
+}
+
+void dispatcher_pending_needs(SharedSystemState *state, uint64_t needs[MAX_INGREDIENTS])
+{
+    memset(needs, 0, MAX_INGREDIENTS * sizeof(uint64_t));
+    order_queue_pending_needs(&state->waiting_orders, needs);
+    DispatchWindow *w = &state->dispatch_window;
+    uint32_t ready = atomic_load(&w->ready);
+    while (ready)
+    {
+        int i = __builtin_ctz(ready);
+        ready &= ready - 1;
+        PackedOrder order;
+        window_peek(w, i, &order);
+        for (int k = 0; k < MAX_INGREDIENTS; k++)
+            needs[k] += order.count[k];
+    }
+}
+
+int dispatcher_pending(SharedSystemState *state)
+{
+    return order_queue_size(&state->waiting_orders) +
+           __builtin_popcount(atomic_load_explicit(&state->dispatch_window.used, memory_order_relaxed));
+}
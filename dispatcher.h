@@ -0,0 +1,59 @@
+// File: dispatcher.h
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "shared_data.h"
+
+// despacho consciente de ingredientes: en vez de atender solo la cabeza de
+// la cola, una banda examina la ventana con las ordenes mas antiguas que
+// esperan ingredientes y toma la mas antigua que el inventario pueda servir.
+// una orden adelantada aging_limit veces bloquea a las demas hasta servirse
+
+void dispatcher_init(DispatchWindow *window);
+
+// intenta despachar una orden sin dormir: si la encuentra, ya tiene sus
+// ingredientes reservados. devuelve false si ninguna se puede servir ahora
+bool dispatcher_try_next(SharedSystemState *state, BurgerOrder *out);
+
+// despacha un lote de hasta max ordenes sin dormir: las saca de la cola
+// con un solo movimiento y reserva la suma de sus ingredientes de una vez.
+// si la suma no alcanza, reserva orden por orden y las que no se pueden
+// servir quedan esperando en la ventana. mientras haya ordenes esperando en
+// la ventana (son mas antiguas) despacha de a una, como dispatcher_try_next.
+// devuelve cuantas ordenes despacho
+int dispatcher_try_batch(SharedSystemState *state, BurgerOrder out[], int max);
+
+// tamano de lote adaptativo: la parte de lo que espera que le toca a cada
+// una de las belts bandas, hasta config.batch_size. con poca cola las
+// bandas toman de a una y no acaparan ordenes que otra banda ociosa tomaria
+int dispatcher_batch_size(SharedSystemState *state, int belts);
+
+// despacha hasta max ordenes para la banda belt_id, durmiendo mientras no
+// haya ninguna servible. devuelve 0 si el sistema se esta apagando o si la
+// interfaz le mando a la banda un comando (ver belt_wait_runnable)
+int dispatcher_next(SharedSystemState *state, int belt_id, BurgerOrder out[], int max);
+
+// al arrancar una banda (tambien como reemplazo de una muerta): devuelve
+// las casillas de la ventana que la anterior dejo tomadas. las que tenian
+// una orden sin reservar vuelven a esperar; las de ordenes que ya estan en
+// su lote en curso se sueltan
+void dispatcher_recover(SharedSystemState *state, int belt_id);
+
+// id de la orden mas antigua que espera ingredientes en la ventana (0: ninguna)
+unsigned int dispatcher_blocked_order(SharedSystemState *state);
+
+// avisa a las bandas dormidas de que algo cambio (nuevo inventario o apagado)
+void dispatcher_wake_all(SharedSystemState *state);
+
+// repone un ingrediente y despierta a las bandas para que revisen la ventana
+void dispatcher_restock(SharedSystemState *state, int ingredient, int quantity);
+
+// ordenes esperando: las de la cola mas las que estan en la ventana
+int dispatcher_pending(SharedSystemState *state);
+
+// unidades de cada ingrediente que piden las ordenes que esperan (cola y
+// ventana); foto aproximada, para la reposicion automatica
+void dispatcher_pending_needs(SharedSystemState *state, uint64_t needs[MAX_INGREDIENTS]);
+
+#endif
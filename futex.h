@@ -0,0 +1,90 @@
+// File: futex.h
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// envoltorios minimos sobre la llamada futex de linux
+// no usamos FUTEX_PRIVATE_FLAG porque las palabras viven en memoria
+// compartida entre procesos distintos
+static inline int futex_wait(_Atomic uint32_t *addr, uint32_t expected)
+{
+    return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+// igual que futex_wait pero se rinde tras timeout_ns nanosegundos
+static inline int futex_wait_timeout(_Atomic uint32_t *addr, uint32_t expected, uint64_t timeout_ns)
+{
+    struct timespec ts = {(time_t)(timeout_ns / 1000000000ull), (long)(timeout_ns % 1000000000ull)};
+    return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, &ts, NULL, 0);
+}
+
+static inline int futex_wake(_Atomic uint32_t *addr, int n)
+{
+    return syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+// contador de eventos (eventcount): permite esperar a que una condicion
+// cambie sin perder notificaciones y sin hacer syscalls cuando nadie espera
+//
+// uso del lado que espera:
+//     uint32_t key = ec_prepare_wait(ec);
+//     if (condicion) { ec_cancel_wait(ec); ... }
+//     else ec_wait(ec, key);
+//
+// uso del lado que notifica: hacer verdadera la condicion y luego ec_notify
+typedef struct {
+    _Atomic uint32_t seq;
+    _Atomic uint32_t waiters;
+} EventCount;
+
+static inline void ec_init(EventCount *ec)
+{
+    atomic_init(&ec->seq, 0);
+    atomic_init(&ec->waiters, 0);
+}
+
+static inline uint32_t ec_prepare_wait(EventCount *ec)
+{
+    atomic_fetch_add(&ec->waiters, 1);
+    return atomic_load(&ec->seq);
+}
+
+static inline void ec_cancel_wait(EventCount *ec)
+{
+    atomic_fetch_sub(&ec->waiters, 1);
+}
+
+static inline void ec_wait(EventCount *ec, uint32_t key)
+{
+    futex_wait(&ec->seq, key);
+    atomic_fetch_sub(&ec->waiters, 1);
+}
+
+// espera con limite: vuelve tras una notificacion o al vencer el plazo
+static inline void ec_wait_timeout(EventCount *ec, uint32_t key, uint64_t timeout_ns)
+{
+    futex_wait_timeout(&ec->seq, key, timeout_ns);
+    atomic_fetch_sub(&ec->waiters, 1);
+}
+
+// si nadie esta esperando el costo es una sola lectura atomica
+static inline void ec_notify(EventCount *ec, bool all)
+{
+    // la condicion debe ser visible antes de leer el numero de esperas
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&ec->waiters) == 0)
+        return;
+    atomic_fetch_add(&ec->seq, 1);
+    futex_wake(&ec->seq, all ? INT_MAX : 1);
+}
+
+#endif
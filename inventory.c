@@ -0,0 +1,280 @@
+// File: inventory.c
+
+#include <string.h>
+#include <errno.h>
+
+#include "inventory.h"
+
+static inline uint64_t lane_max(const Inventory *inv)
+{
+    return (1ull << inv->lane_bits) - 1;
+}
+
+static inline uint64_t lane_of(const Inventory *inv, uint64_t shelf, int i)
+{
+    return (shelf >> (i * inv->lane_bits)) & lane_max(inv);
+}
+
+// pasa unidades de la bodega al carril del ingrediente i hasta llenarlo.
+// devuelve true si el estante gano al menos una unidad
+static bool refill_lane(Inventory *inv, int i)
+{
+    uint64_t shelf = atomic_load(&inv->shelf);
+    uint64_t space = lane_max(inv) - lane_of(inv, shelf, i);
+    if (space == 0)
+        return false;
+
+    // primero sacamos de la bodega lo que deberia caber
+    int64_t reserve = atomic_load(&inv->reserve[i]);
+    int64_t amount;
+    do
+    {
+        if (reserve <= 0)
+            return false;
+        amount = reserve < (int64_t)space ? reserve : (int64_t)space;
+    } while (!atomic_compare_exchange_weak(&inv->reserve[i], &reserve, reserve - amount));
+
+    // luego lo sumamos al carril sin desbordarlo (otra banda pudo rellenarlo
+    // al mismo tiempo); lo que sobre vuelve a la bodega
+    uint64_t added;
+    for (;;)
+    {
+        uint64_t room = lane_max(inv) - lane_of(inv, shelf, i);
+        added = (uint64_t)amount < room ? (uint64_t)amount : room;
+        if (atomic_compare_exchange_weak(&inv->shelf, &shelf, shelf + (added << (i * inv->lane_bits))))
+            break;
+    }
+    if ((int64_t)added < amount)
+        atomic_fetch_add(&inv->reserve[i], amount - (int64_t)added);
+    return added > 0;
+}
+
+// --- ruta de respaldo con un mutex por ingrediente ---
+
+// toma el mutex de un ingrediente. si el dueno anterior murio con el mutex
+// tomado (EOWNERDEAD) a mitad de una reserva, la deshace y deja el mutex
+// usable otra vez
+static void lock_ingredient(Inventory *inv, int i)
+{
+    Ingredient *ing = &inv->locked[i];
+    if (pthread_mutex_lock(&ing->mutex) == EOWNERDEAD)
+    {
+        if (ing->undo_pending)
+            ing->count = ing->undo_count;
+        ing->undo_pending = false;
+        pthread_mutex_consistent(&ing->mutex);
+        atomic_fetch_add(&inv->owner_deaths, 1);
+    }
+}
+
+static bool take_locked(Inventory *inv, const uint8_t needs[MAX_INGREDIENTS])
+{
+    int n = inv->num_ingredients;
+    // bloqueamos siempre en orden de indice para evitar interbloqueos
+    for (int i = 0; i < n; i++)
+    {
+        if (needs[i] > 0)
+            lock_ingredient(inv, i);
+    }
+    bool has_enough = true;
+    for (int i = 0; i < n; i++)
+    {
+        if (needs[i] > 0 && inv->locked[i].count < needs[i])
+        {
+            has_enough = false;
+            break;
+        }
+    }
+    if (has_enough)
+    {
+        // el valor anterior de cada contador queda anotado hasta confirmar la
+        // reserva completa. las barreras mantienen el orden de las escrituras
+        // por si el proceso muere entre dos de ellas
+        for (int i = 0; i < n; i++)
+        {
+            if (needs[i] > 0)
+            {
+                Ingredient *ing = &inv->locked[i];
+                ing->undo_count = ing->count;
+                atomic_signal_fence(memory_order_seq_cst);
+                ing->undo_pending = true;
+                atomic_signal_fence(memory_order_seq_cst);
+                ing->count -= needs[i];
+            }
+        }
+        atomic_signal_fence(memory_order_seq_cst);
+        for (int i = 0; i < n; i++)
+            inv->locked[i].undo_pending = false;
+    }
+    for (int i = n - 1; i >= 0; i--)
+    {
+        if (needs[i] > 0)
+            pthread_mutex_unlock(&inv->locked[i].mutex);
+    }
+    return has_enough;
+}
+
+static void add_locked(Inventory *inv, int i, int quantity)
+{
+    lock_ingredient(inv, i);
+    inv->locked[i].count += quantity;
+    pthread_mutex_unlock(&inv->locked[i].mutex);
+}
+
+// --- interfaz publica ---
+
+void inventory_init(Inventory *inv, int num_ingredients, const int initial_counts[], bool force_locked)
+{
+    memset(inv, 0, sizeof(*inv));
+    inv->num_ingredients = num_ingredients;
+    inv->packed = !force_locked && num_ingredients <= INVENTORY_PACKED_MAX;
+
+    if (inv->packed)
+    {
+        // repartimos los 64 bits entre los ingredientes activos
+        int bits = 64 / (num_ingredients > 0 ? num_ingredients : 1);
+        inv->lane_bits = bits > 32 ? 32 : bits;
+        atomic_init(&inv->shelf, 0);
+        for (int i = 0; i < num_ingredients; i++)
+        {
+            atomic_init(&inv->reserve[i], initial_counts[i]);
+            refill_lane(inv, i);
+        }
+        return;
+    }
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    // una banda que muere con el mutex tomado no debe trabar a las demas
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    for (int i = 0; i < num_ingredients; i++)
+    {
+        inv->locked[i].count = initial_counts[i];
+        pthread_mutex_init(&inv->locked[i].mutex, &mutex_attr);
+    }
+    pthread_mutexattr_destroy(&mutex_attr);
+}
+
+void inventory_destroy(Inventory *inv)
+{
+    if (inv->packed)
+        return;
+    for (uint32_t i = 0; i < inv->num_ingredients; i++)
+    {
+        pthread_mutex_destroy(&inv->locked[i].mutex);
+    }
+}
+
+bool inventory_try_take(Inventory *inv, const uint8_t needs[MAX_INGREDIENTS])
+{
+    if (!inv->packed)
+        return take_locked(inv, needs);
+
+    int n = inv->num_ingredients;
+    uint64_t delta = 0;
+    for (int i = 0; i < n; i++)
+    {
+        // una orden que no cabe ni en un estante lleno nunca se podra servir
+        if (needs[i] > lane_max(inv))
+            return false;
+        delta |= (uint64_t)needs[i] << (i * inv->lane_bits);
+    }
+
+    uint64_t shelf = atomic_load(&inv->shelf);
+    for (;;)
+    {
+        unsigned short_lanes = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (lane_of(inv, shelf, i) < (uint64_t)needs[i])
+                short_lanes |= 1u << i;
+        }
+        if (short_lanes == 0)
+        {
+            // todos los carriles alcanzan: la resta no pide prestado entre carriles
+            if (atomic_compare_exchange_weak(&inv->shelf, &shelf, shelf - delta))
+                return true;
+            continue;
+        }
+        // algun carril se quedo corto: intentamos traer de la bodega
+        bool refilled = false;
+        for (int i = 0; i < n; i++)
+        {
+            if (short_lanes & (1u << i))
+                refilled |= refill_lane(inv, i);
+        }
+        if (!refilled)
+            return false;
+        shelf = atomic_load(&inv->shelf);
+    }
+}
+
+void inventory_give_back(Inventory *inv, const uint8_t needs[MAX_INGREDIENTS])
+{
+    int n = inv->num_ingredients;
+    if (!inv->packed)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (needs[i] > 0)
+                add_locked(inv, i, needs[i]);
+        }
+        return;
+    }
+
+    // devolvemos al estante lo que quepa y el resto a la bodega
+    uint64_t shelf = atomic_load(&inv->shelf);
+    uint64_t delta;
+    int overflow[MAX_INGREDIENTS];
+    do
+    {
+        delta = 0;
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t room = lane_max(inv) - lane_of(inv, shelf, i);
+            uint64_t add = (uint64_t)needs[i] < room ? (uint64_t)needs[i] : room;
+            overflow[i] = needs[i] - (int)add;
+            delta |= add << (i * inv->lane_bits);
+        }
+    } while (!atomic_compare_exchange_weak(&inv->shelf, &shelf, shelf + delta));
+    for (int i = 0; i < n; i++)
+    {
+        if (overflow[i] > 0)
+            atomic_fetch_add(&inv->reserve[i], overflow[i]);
+    }
+}
+
+void inventory_restock(Inventory *inv, int ingredient, int quantity)
+{
+    if (inv->packed)
+    {
+        atomic_fetch_add(&inv->reserve[ingredient], quantity);
+        refill_lane(inv, ingredient);
+    }
+    else
+    {
+        add_locked(inv, ingredient, quantity);
+    }
+}
+
+long inventory_count(Inventory *inv, int ingredient)
+{
+    if (!inv->packed)
+        return inv->locked[ingredient].count;
+    return (long)lane_of(inv, atomic_load_explicit(&inv->shelf, memory_order_relaxed), ingredient) +
+           (long)atomic_load_explicit(&inv->reserve[ingredient], memory_order_relaxed);
+}
+
+void inventory_snapshot(Inventory *inv, uint8_t avail[16])
+{
+    memset(avail, 0, 16);
+    uint64_t shelf = inv->packed ? atomic_load_explicit(&inv->shelf, memory_order_relaxed) : 0;
+    for (uint32_t i = 0; i < inv->num_ingredients; i++)
+    {
+        long count = inv->packed ? (long)lane_of(inv, shelf, i) +
+                                       (long)atomic_load_explicit(&inv->reserve[i], memory_order_relaxed)
+                                 : inv->locked[i].count;
+        avail[i] = count <= 0 ? 0 : count >= 255 ? 255 : (uint8_t)count;
+    }
+}
@@ -0,0 +1,32 @@
+// File: inventory.h
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include "shared_data.h"
+
+// inicializa el inventario con num_ingredients ingredientes activos.
+// si force_locked es true se usa siempre el esquema con mutex (para comparar)
+void inventory_init(Inventory *inv, int num_ingredients, const int initial_counts[], bool force_locked);
+void inventory_destroy(Inventory *inv);
+
+// toma todos los ingredientes de la orden o ninguno (una cantidad por
+// ingrediente, como en PackedOrder)
+bool inventory_try_take(Inventory *inv, const uint8_t needs[MAX_INGREDIENTS]);
+
+// devuelve ingredientes tomados (por ejemplo al deshacer una reserva)
+void inventory_give_back(Inventory *inv, const uint8_t needs[MAX_INGREDIENTS]);
+
+// repone un ingrediente. no despierta a nadie: las bandas atascadas duermen
+// en la cola de ordenes y las despierta dispatcher_restock
+void inventory_restock(Inventory *inv, int ingredient, int quantity);
+
+// foto de las existencias con la forma de PackedOrder: un carril de 8 bits
+// por ingrediente, saturado en 255 (lectura sin bloqueos, aproximada). con
+// packed_fits se descartan de una vez las ordenes que seguro no alcanzan
+void inventory_snapshot(Inventory *inv, uint8_t avail[16]);
+
+// unidades disponibles de un ingrediente (lectura sin bloqueos, aproximada)
+long inventory_count(Inventory *inv, int ingredient);
+
+#endif
@@ -0,0 +1,722 @@
+// File: journal.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "journal.h"
+#include "inventory.h"
+#include "trace.h"
+#include "packed_order.h"
+
+typedef struct {
+    char magic[8];
+    uint64_t epoch;
+    uint64_t lsn;
+    uint64_t next_seq;
+    uint32_t max_order_id;
+    uint32_t num_ingredients;
+    uint32_t num_belts;
+    uint32_t reserved;
+    uint64_t order_count;
+    int64_t stock[MAX_INGREDIENTS];
+    // siguen completed[num_belts], las ordenes vivas y una suma de control
+} CheckpointHeader;
+
+// diario abierto en este proceso (los hijos lo heredan con fork)
+static JournalHeader *header = NULL;
+static JournalRecord *records = NULL;
+static size_t map_size = 0;
+
+// solo en el padre: ruta, estado resumido y tiempos del commit en grupo
+static char checkpoint_path[300];
+static JournalState folded;
+static uint64_t last_sync_ns = 0;
+static uint64_t last_checkpoint_ns = 0;
+static unsigned long checkpoints_written = 0;
+static unsigned long syncs_done = 0;
+
+// lsn que anunciaron escritores ya recogidos: no se van a escribir nunca
+#define JOURNAL_ABANDONED_MAX 1024
+static uint64_t abandoned[JOURNAL_ABANDONED_MAX];
+static int num_abandoned = 0;
+// primer lsn sin publicar ni anunciar que vimos y desde cuando
+static uint64_t orphan_lsn = UINT64_MAX;
+static uint64_t orphan_since_ns = 0;
+
+// casilla de escritor de cada hilo. el hijo de un fork hereda la del padre
+// pero no es ese escritor: cada fork sube la generacion y el hilo toma una
+// casilla propia en su primer registro (sin llamadas al sistema despues)
+static unsigned int fork_generation = 1;
+static __thread unsigned int writer_generation = 0;
+static __thread JournalWriter *writer = NULL;
+
+static void after_fork_child(void)
+{
+    fork_generation++;
+}
+
+// --- estado resumido ---
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static size_t order_hash(uint32_t order_id, size_t capacity)
+{
+    return (size_t)(order_id * 2654435761u) & (capacity - 1);
+}
+
+static JournalOrder *order_find(JournalState *js, uint32_t order_id)
+{
+    if (js->order_capacity == 0)
+        return NULL;
+    for (size_t i = order_hash(order_id, js->order_capacity);; i = (i + 1) & (js->order_capacity - 1))
+    {
+        JournalOrder *o = &js->orders[i];
+        if (!o->used)
+            return NULL;
+        if (o->order_id == order_id)
+            return o;
+    }
+}
+
+static void order_insert(JournalState *js, const JournalOrder *order);
+
+static void orders_grow(JournalState *js)
+{
+    JournalOrder *old = js->orders;
+    size_t old_capacity = js->order_capacity;
+    js->order_capacity = old_capacity ? old_capacity * 2 : 1024;
+    js->orders = calloc(js->order_capacity, sizeof(JournalOrder));
+    if (js->orders == NULL)
+    {
+        perror("calloc (diario)");
+        exit(1);
+    }
+    js->order_count = 0;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old[i].used)
+            order_insert(js, &old[i]);
+    }
+    free(old);
+}
+
+static void order_insert(JournalState *js, const JournalOrder *order)
+{
+    // sondeo lineal con la tabla a lo sumo a la mitad
+    if (2 * (js->order_count + 1) > js->order_capacity)
+        orders_grow(js);
+    size_t i = order_hash(order->order_id, js->order_capacity);
+    while (js->orders[i].used && js->orders[i].order_id != order->order_id)
+        i = (i + 1) & (js->order_capacity - 1);
+    if (!js->orders[i].used)
+        js->order_count++;
+    js->orders[i] = *order;
+    js->orders[i].used = 1;
+}
+
+// borrado con corrimiento hacia atras: no deja lapidas en la tabla
+static void order_remove(JournalState *js, JournalOrder *o)
+{
+    size_t mask = js->order_capacity - 1;
+    size_t hole = o - js->orders;
+    size_t i = hole;
+    js->orders[hole].used = 0;
+    js->order_count--;
+    for (;;)
+    {
+        i = (i + 1) & mask;
+        if (!js->orders[i].used)
+            return;
+        size_t home = order_hash(js->orders[i].order_id, js->order_capacity);
+        // se mueve si su lugar ideal no esta entre el hueco y su posicion
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            js->orders[hole] = js->orders[i];
+            js->orders[i].used = 0;
+            hole = i;
+        }
+    }
+}
+
+static void apply_needs(JournalState *js, uint32_t needs, int sign)
+{
+    uint8_t unpacked[MAX_INGREDIENTS];
+    trace_unpack_needs(needs, unpacked);
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        js->stock[i] += sign * unpacked[i];
+}
+
+static void apply_record(JournalState *js, const JournalRecord *rec)
+{
+    JournalOrder *o;
+    switch (rec->type)
+    {
+    case JR_ENQUEUE:
+    {
+        JournalOrder order = {.order_id = rec->order_id, .needs = rec->needs, .seq = js->next_seq++};
+        order_insert(js, &order);
+        if (rec->order_id > js->max_order_id)
+            js->max_order_id = rec->order_id;
+        break;
+    }
+    case JR_DISPATCH:
+        apply_needs(js, rec->needs, -1);
+        if ((o = order_find(js, rec->order_id)) != NULL)
+            o->flags |= JO_DISPATCHED;
+        break;
+    case JR_COMPLETE:
+        if (rec->arg >= 0 && (uint32_t)rec->arg < js->num_belts)
+            js->completed[rec->arg]++;
+        // fall through
+    case JR_DROP:
+        if ((o = order_find(js, rec->order_id)) != NULL)
+            order_remove(js, o);
+        break;
+    case JR_RESTOCK:
+        if (rec->arg >= 0 && rec->arg < MAX_INGREDIENTS)
+            js->stock[rec->arg] += rec->needs;
+        break;
+    }
+    js->lsn++;
+}
+
+void journal_state_free(JournalState *js)
+{
+    free(js->completed);
+    free(js->orders);
+    memset(js, 0, sizeof(*js));
+}
+
+static int compare_seq(const void *a, const void *b)
+{
+    const JournalOrder *x = a, *y = b;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+size_t journal_state_requeue(JournalState *js, BurgerOrder **out)
+{
+    JournalOrder *live = malloc((js->order_count + 1) * sizeof(JournalOrder));
+    *out = malloc((js->order_count + 1) * sizeof(BurgerOrder));
+    if (live == NULL || *out == NULL)
+    {
+        perror("malloc (diario)");
+        exit(1);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < js->order_capacity; i++)
+    {
+        JournalOrder *o = &js->orders[i];
+        if (!o->used)
+            continue;
+        // estaba en una banda: vuelve a la cola y devuelve lo reservado
+        if (o->flags & JO_DISPATCHED)
+        {
+            apply_needs(js, o->needs, +1);
+            o->flags &= ~JO_DISPATCHED;
+        }
+        live[n++] = *o;
+    }
+    qsort(live, n, sizeof(JournalOrder), compare_seq);
+    for (size_t i = 0; i < n; i++)
+    {
+        memset(&(*out)[i], 0, sizeof(BurgerOrder));
+        (*out)[i].order_id = live[i].order_id;
+        trace_unpack_needs(live[i].needs, (*out)[i].ingredients_needed);
+        packed_update_mask(&(*out)[i].packed);
+        (*out)[i].priority = trace_unpack_class(live[i].needs);
+    }
+    free(live);
+    return n;
+}
+
+// --- punto de control ---
+
+static bool write_all(int fd, const void *data, size_t len, uint64_t *sum)
+{
+    *sum = fnv1a(*sum, data, len);
+    const char *p = data;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// se escribe en un temporal y se renombra: un punto de control a medias
+// nunca reemplaza al anterior
+static bool checkpoint_write(const JournalState *js)
+{
+    char tmp_path[sizeof(checkpoint_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", checkpoint_path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        perror("open (punto de control)");
+        return false;
+    }
+    CheckpointHeader h = {
+        .epoch = js->epoch,
+        .lsn = js->lsn,
+        .next_seq = js->next_seq,
+        .max_order_id = js->max_order_id,
+        .num_ingredients = js->num_ingredients,
+        .num_belts = js->num_belts,
+        .order_count = js->order_count,
+    };
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    memcpy(h.stock, js->stock, sizeof(h.stock));
+    uint64_t sum = 0xcbf29ce484222325ull;
+    bool ok = write_all(fd, &h, sizeof(h), &sum) &&
+              write_all(fd, js->completed, js->num_belts * sizeof(uint64_t), &sum);
+    for (size_t i = 0; ok && i < js->order_capacity; i++)
+    {
+        if (js->orders[i].used)
+            ok = write_all(fd, &js->orders[i], sizeof(JournalOrder), &sum);
+    }
+    uint64_t final_sum = sum;
+    ok = ok && write_all(fd, &final_sum, sizeof(final_sum), &sum) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp_path, checkpoint_path) == -1)
+    {
+        perror("escritura del punto de control");
+        return false;
+    }
+    // el rename tambien tiene que llegar al disco
+    char dir_path[sizeof(checkpoint_path)];
+    strcpy(dir_path, checkpoint_path);
+    int dir = open(dirname(dir_path), O_RDONLY | O_DIRECTORY);
+    if (dir != -1)
+    {
+        fsync(dir);
+        close(dir);
+    }
+    checkpoints_written++;
+    return true;
+}
+
+static bool checkpoint_read(const char *path, JournalState *js)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open (punto de control)");
+        return false;
+    }
+    struct stat st;
+    char *data = NULL;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CheckpointHeader) + sizeof(uint64_t) &&
+              (data = malloc(st.st_size)) != NULL && pread(fd, data, st.st_size, 0) == st.st_size;
+    close(fd);
+    CheckpointHeader h;
+    if (ok)
+    {
+        memcpy(&h, data, sizeof(h));
+        size_t expected = sizeof(h) + h.num_belts * sizeof(uint64_t) + h.order_count * sizeof(JournalOrder) + sizeof(uint64_t);
+        ok = memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) == 0 && expected == (size_t)st.st_size;
+    }
+    if (ok)
+    {
+        uint64_t stored;
+        memcpy(&stored, data + st.st_size - sizeof(stored), sizeof(stored));
+        ok = fnv1a(0xcbf29ce484222325ull, data, st.st_size - sizeof(stored)) == stored;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "Error: %s no es un punto de control valido.\n", path);
+        free(data);
+        return false;
+    }
+
+    memset(js, 0, sizeof(*js));
+    js->epoch = h.epoch;
+    js->lsn = h.lsn;
+    js->next_seq = h.next_seq;
+    js->max_order_id = h.max_order_id;
+    js->num_ingredients = h.num_ingredients;
+    js->num_belts = h.num_belts;
+    memcpy(js->stock, h.stock, sizeof(js->stock));
+    js->completed = calloc(h.num_belts + 1, sizeof(uint64_t));
+    memcpy(js->completed, data + sizeof(h), h.num_belts * sizeof(uint64_t));
+    const JournalOrder *orders = (const JournalOrder *)(data + sizeof(h) + h.num_belts * sizeof(uint64_t));
+    for (uint64_t i = 0; i < h.order_count; i++)
+    {
+        JournalOrder o;
+        memcpy(&o, &orders[i], sizeof(o));
+        order_insert(js, &o);
+    }
+    free(data);
+    return true;
+}
+
+// --- recuperacion ---
+
+int journal_recover(const char *path, JournalState *out)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        if (errno == ENOENT)
+            return 0;
+        perror("open (diario)");
+        return -1;
+    }
+    JournalHeader h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) != 0 ||
+        h.record_size != sizeof(JournalRecord))
+    {
+        fprintf(stderr, "Error: %s no es un diario valido.\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = JOURNAL_HEADER_SIZE + h.capacity * sizeof(JournalRecord);
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap (diario)");
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    char ckpt[sizeof(checkpoint_path)];
+    snprintf(ckpt, sizeof(ckpt), "%s.ckpt", path);
+    if (!checkpoint_read(ckpt, out))
+    {
+        munmap(map, size);
+        return -1;
+    }
+
+    // la cola del anillo: todo lo reservado despues del punto de control.
+    // una casilla con otro lsn es un registro que su escritor no llego a
+    // terminar; se saltea. un anillo de otra generacion (la caida fue justo
+    // despues de escribir el punto de control de un diario nuevo) no se aplica
+    const JournalRecord *recs = (const JournalRecord *)((char *)map + JOURNAL_HEADER_SIZE);
+    uint64_t end = h.epoch == out->epoch ? h.append_lsn : out->lsn;
+    if (end > out->lsn + h.capacity)
+        end = out->lsn + h.capacity;
+    uint64_t applied = 0, holes = 0;
+    while (out->lsn < end)
+    {
+        const JournalRecord *rec = &recs[out->lsn % h.capacity];
+        if (atomic_load_explicit(&rec->lsn, memory_order_relaxed) == out->lsn + 1)
+        {
+            apply_record(out, rec);
+            applied++;
+        }
+        else
+        {
+            out->lsn++;
+            holes++;
+        }
+    }
+    munmap(map, size);
+    printf("[Main] Diario %s: punto de control + %lu registros aplicados (%lu incompletos).\n", path,
+           (unsigned long)applied, (unsigned long)holes);
+    return 1;
+}
+
+// --- escritura ---
+
+bool journal_create(const char *path, uint64_t capacity, SharedSystemState *state, JournalState *recovered)
+{
+    snprintf(checkpoint_path, sizeof(checkpoint_path), "%s.ckpt", path);
+    static bool atfork_registered = false;
+    if (!atfork_registered)
+    {
+        pthread_atfork(NULL, NULL, after_fork_child);
+        atfork_registered = true;
+    }
+
+    // estado de partida: las ordenes vivas (si las hay) y lo demas de state
+    if (recovered != NULL)
+    {
+        folded = *recovered;
+        memset(recovered, 0, sizeof(*recovered));
+        free(folded.completed);
+    }
+    else
+    {
+        memset(&folded, 0, sizeof(folded));
+    }
+    folded.epoch = now_ns() ^ ((uint64_t)getpid() << 32);
+    folded.lsn = 0;
+    folded.num_ingredients = state->inventory.num_ingredients;
+    for (uint32_t i = 0; i < folded.num_ingredients; i++)
+        folded.stock[i] = inventory_count(&state->inventory, i);
+    folded.num_belts = state->num_belts;
+    folded.completed = calloc(folded.num_belts + 1, sizeof(uint64_t));
+    for (int i = 0; i < state->num_belts; i++)
+        folded.completed[i] = state_belt(state, i)->burgers_processed;
+
+    // primero el punto de control de la nueva generacion: desde que esta en
+    // disco, el anillo viejo ya no hace falta y se puede vaciar
+    if (!checkpoint_write(&folded))
+    {
+        journal_state_free(&folded);
+        return false;
+    }
+
+    map_size = JOURNAL_HEADER_SIZE + capacity * sizeof(JournalRecord);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        perror("open (diario)");
+        return false;
+    }
+    // el archivo nuevo queda en cero: ninguna casilla tiene un lsn valido
+    if (ftruncate(fd, map_size) == -1)
+    {
+        perror("ftruncate (diario)");
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap (diario)");
+        return false;
+    }
+    header = map;
+    records = (JournalRecord *)((char *)map + JOURNAL_HEADER_SIZE);
+    header->capacity = capacity;
+    header->record_size = sizeof(JournalRecord);
+    header->epoch = folded.epoch;
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+    if (msync(map, JOURNAL_HEADER_SIZE, MS_SYNC) == -1)
+    {
+        perror("msync (diario)");
+        journal_close();
+        return false;
+    }
+    last_sync_ns = last_checkpoint_ns = now_ns();
+    return true;
+}
+
+// casilla de escritor del hilo (NULL si estan todas tomadas: sus lsn solo
+// se rescatan por tiempo)
+static JournalWriter *journal_writer(void)
+{
+    if (writer_generation == fork_generation)
+        return writer;
+    writer_generation = fork_generation;
+    writer = NULL;
+    pid_t pid = getpid();
+    for (int i = 0; i < JOURNAL_WRITERS; i++)
+    {
+        int32_t expected = 0;
+        if (atomic_compare_exchange_strong(&header->writers[i].pid, &expected, pid))
+        {
+            writer = &header->writers[i];
+            break;
+        }
+    }
+    return writer;
+}
+
+static JournalRecord *journal_reserve(uint64_t *lsn_out)
+{
+    JournalWriter *w = journal_writer();
+    uint64_t lsn = atomic_fetch_add_explicit(&header->append_lsn, 1, memory_order_relaxed);
+    // se anuncia antes de esperar lugar: mientras tanto el padre no lo saltea
+    if (w != NULL)
+        atomic_store_explicit(&w->lsn, lsn + 1, memory_order_release);
+    // la casilla todavia guarda un registro que el punto de control no cubre:
+    // esperamos al padre (solo pasa si escribimos mas rapido que sus puntos
+    // de control)
+    while (lsn - atomic_load_explicit(&header->checkpoint_lsn, memory_order_acquire) >= header->capacity)
+        sleep_us(100);
+    *lsn_out = lsn;
+    return &records[lsn % header->capacity];
+}
+
+static void journal_publish(JournalRecord *rec, uint64_t lsn)
+{
+    // el lsn va al final: marca el registro como completo
+    atomic_store_explicit(&rec->lsn, lsn + 1, memory_order_release);
+    if (writer != NULL)
+        atomic_store_explicit(&writer->lsn, 0, memory_order_release);
+}
+
+void journal_writer_exited(pid_t pid)
+{
+    if (header == NULL)
+        return;
+    for (int i = 0; i < JOURNAL_WRITERS; i++)
+    {
+        JournalWriter *w = &header->writers[i];
+        if (atomic_load(&w->pid) != pid)
+            continue;
+        uint64_t pending = atomic_load_explicit(&w->lsn, memory_order_acquire);
+        if (pending != 0 && num_abandoned < JOURNAL_ABANDONED_MAX)
+            abandoned[num_abandoned++] = pending - 1;
+        atomic_store(&w->lsn, 0);
+        atomic_store(&w->pid, 0);
+    }
+}
+
+// true si el registro lsn, todavia sin publicar, no se va a escribir: lo
+// reservo un escritor ya recogido o nadie lo anuncia desde hace
+// JOURNAL_ORPHAN_MS (el escritor murio entre reservarlo y anunciarlo)
+static bool never_written(uint64_t lsn)
+{
+    bool found = false;
+    for (int k = 0; k < num_abandoned;)
+    {
+        // los que ya pasaron (el escritor murio despues de publicar) sobran
+        if (abandoned[k] <= lsn)
+        {
+            found |= abandoned[k] == lsn;
+            abandoned[k] = abandoned[--num_abandoned];
+            continue;
+        }
+        k++;
+    }
+    if (found)
+        return true;
+    for (int i = 0; i < JOURNAL_WRITERS; i++)
+    {
+        if (atomic_load_explicit(&header->writers[i].lsn, memory_order_acquire) == lsn + 1)
+            return false;
+    }
+    uint64_t now = now_ns();
+    if (orphan_lsn != lsn)
+    {
+        orphan_lsn = lsn;
+        orphan_since_ns = now;
+        return false;
+    }
+    return now - orphan_since_ns >= (uint64_t)JOURNAL_ORPHAN_MS * 1000000;
+}
+
+void journal_append(JournalRecordType type, const BurgerOrder *order, int32_t arg)
+{
+    if (header == NULL)
+        return;
+    uint64_t lsn;
+    JournalRecord *rec = journal_reserve(&lsn);
+    rec->time_ns = now_ns();
+    rec->type = type;
+    rec->order_id = order->order_id;
+    rec->needs = trace_pack_order(order);
+    rec->arg = arg;
+    journal_publish(rec, lsn);
+}
+
+void journal_append_restock(int ingredient, int quantity)
+{
+    if (header == NULL)
+        return;
+    uint64_t lsn;
+    JournalRecord *rec = journal_reserve(&lsn);
+    rec->time_ns = now_ns();
+    rec->type = JR_RESTOCK;
+    rec->order_id = 0;
+    rec->needs = quantity;
+    rec->arg = ingredient;
+    journal_publish(rec, lsn);
+}
+
+// baja a disco las casillas de [from, to) del anillo y la cabecera
+static void sync_range(uint64_t from, uint64_t to)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t capacity = header->capacity;
+    if (to - from >= capacity)
+        from = to - capacity;
+    while (from < to)
+    {
+        uint64_t slot = from % capacity;
+        uint64_t n = capacity - slot < to - from ? capacity - slot : to - from;
+        uintptr_t start = (uintptr_t)&records[slot];
+        uintptr_t aligned = start & ~(uintptr_t)(page - 1);
+        msync((void *)aligned, start - aligned + n * sizeof(JournalRecord), MS_SYNC);
+        from += n;
+    }
+    msync(header, JOURNAL_HEADER_SIZE, MS_SYNC);
+    syncs_done++;
+}
+
+void journal_tick(unsigned int sync_ms, bool final)
+{
+    if (header == NULL)
+        return;
+    // aplica lo escrito en orden de lsn; se detiene en el primer registro
+    // que su escritor todavia no termino
+    uint64_t end = atomic_load_explicit(&header->append_lsn, memory_order_acquire);
+    while (folded.lsn < end)
+    {
+        const JournalRecord *rec = &records[folded.lsn % header->capacity];
+        if (atomic_load_explicit(&rec->lsn, memory_order_acquire) != folded.lsn + 1)
+        {
+            if (!final && !never_written(folded.lsn))
+                break;
+            folded.lsn++;
+            continue;
+        }
+        apply_record(&folded, rec);
+    }
+
+    uint64_t now = now_ns();
+    uint64_t durable = atomic_load_explicit(&header->durable_lsn, memory_order_relaxed);
+    if (folded.lsn > durable && (final || now - last_sync_ns >= (uint64_t)sync_ms * 1000000))
+    {
+        sync_range(durable, folded.lsn);
+        atomic_store_explicit(&header->durable_lsn, folded.lsn, memory_order_relaxed);
+        last_sync_ns = now;
+    }
+
+    // punto de control: al llenarse un cuarto del anillo o cada segundo
+    uint64_t covered = atomic_load_explicit(&header->checkpoint_lsn, memory_order_relaxed);
+    bool due = folded.lsn - covered >= header->capacity / 4 || now - last_checkpoint_ns >= 1000000000ull;
+    if (folded.lsn > covered && (final || due))
+    {
+        if (checkpoint_write(&folded))
+        {
+            // las casillas cubiertas ya se pueden reusar
+            atomic_store_explicit(&header->checkpoint_lsn, folded.lsn, memory_order_release);
+            msync(header, JOURNAL_HEADER_SIZE, MS_SYNC);
+        }
+        last_checkpoint_ns = now;
+    }
+}
+
+void journal_close(void)
+{
+    if (header == NULL)
+        return;
+    if (checkpoint_path[0] != '\0' && folded.completed != NULL)
+    {
+        printf("[Main] Diario: %lu registros, %lu puntos de control, %lu msync; %lu ordenes pendientes al cerrar.\n",
+               (unsigned long)folded.lsn, checkpoints_written, syncs_done, (unsigned long)folded.order_count);
+    }
+    munmap(header, map_size);
+    header = NULL;
+    records = NULL;
+    journal_state_free(&folded);
+}
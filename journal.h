@@ -0,0 +1,138 @@
+// File: journal.h
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "shared_data.h"
+
+// diario de escritura anticipada: cada cambio del estado que importa para
+// retomar una corrida (orden que entra, reserva de ingredientes al
+// despacharla, orden completada o descartada, reposicion) se anota en un
+// archivo mapeado antes de hacerse visible. el archivo es un anillo de
+// registros de 32 bytes con numero de secuencia (lsn): cualquier proceso
+// reserva su lsn con un fetch_add y escribe el registro en su lugar, sin
+// llamadas al sistema. como el mapeo es compartido, lo escrito sobrevive a
+// la caida de cualquier proceso; el padre lo baja a disco con msync por
+// lotes (commit en grupo) y cada tanto escribe un punto de control con el
+// estado resumido, lo que libera el anillo para seguir escribiendo.
+//
+// al arrancar con un diario existente se carga el ultimo punto de control
+// y se aplica la cola del anillo: se reconstruyen el inventario, la cola de
+// ordenes (las que estaban en una banda vuelven a la cola y devuelven sus
+// ingredientes) y las cuentas de cada banda
+#define JOURNAL_MAGIC "BURGJRN1"
+#define CHECKPOINT_MAGIC "BURGCKP1"
+#define JOURNAL_DEFAULT_RECORDS (1u << 20)
+#define JOURNAL_DEFAULT_SYNC_MS 10
+
+typedef enum {
+    JR_ENQUEUE = 1,    // orden aceptada por el generador (order_id, needs)
+    JR_DISPATCH,       // una banda la tomo y reservo sus ingredientes
+    JR_COMPLETE,       // orden terminada (arg: banda)
+    JR_DROP,           // orden descartada con la cola llena
+    JR_RESTOCK         // reposicion (arg: ingrediente, needs: cantidad)
+} JournalRecordType;
+
+typedef struct {
+    _Atomic uint64_t lsn;         // lsn + 1 una vez escrito (0: casilla vacia)
+    uint64_t time_ns;
+    uint32_t type;
+    uint32_t order_id;
+    uint32_t needs;               // necesidades empaquetadas como en las trazas
+    int32_t arg;
+} JournalRecord;
+
+_Static_assert(sizeof(JournalRecord) == 32, "JournalRecord debe medir 32 bytes");
+
+// un escritor (hilo de un proceso hijo) anuncia el lsn que reservo hasta
+// publicarlo. si el proceso muere en el medio, el padre sabe que ese lsn no
+// se va a escribir nunca y lo saltea en vez de esperarlo para siempre
+#define JOURNAL_WRITERS 224
+#define JOURNAL_ORPHAN_MS 1000    // un lsn sin publicar ni anunciar se da por perdido pasado este tiempo
+
+typedef struct {
+    _Atomic int32_t pid;          // proceso del escritor (0: casilla libre)
+    uint32_t reserved;
+    _Atomic uint64_t lsn;         // lsn + 1 reservado y sin publicar (0: ninguno)
+} JournalWriter;
+
+// cabecera del archivo (su propia pagina); los registros van detras
+typedef struct {
+    char magic[8];
+    uint64_t capacity;            // registros en el anillo
+    uint32_t record_size;
+    uint64_t epoch;               // generacion: solo vale con el punto de control de la misma
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t append_lsn;      // proximo lsn a reservar
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t checkpoint_lsn;  // registros ya cubiertos por el punto de control
+    _Atomic uint64_t durable_lsn;                               // hasta aqui ya paso por msync
+    _Alignas(CACHE_LINE_SIZE) JournalWriter writers[JOURNAL_WRITERS];
+} JournalHeader;
+
+#define JOURNAL_HEADER_SIZE 4096
+_Static_assert(sizeof(JournalHeader) <= JOURNAL_HEADER_SIZE, "JournalHeader no cabe en su pagina");
+
+// orden viva en el estado resumido
+#define JO_DISPATCHED 1u
+
+typedef struct {
+    uint32_t order_id;
+    uint32_t needs;
+    uint64_t seq;                 // orden de llegada (para devolverlas a la cola en orden)
+    uint32_t flags;
+    uint32_t used;
+} JournalOrder;
+
+// estado resumido que guarda un punto de control: lo que resulta de aplicar
+// todos los registros hasta lsn
+typedef struct {
+    uint64_t epoch;
+    uint64_t lsn;
+    uint64_t next_seq;
+    uint32_t max_order_id;
+    uint32_t num_ingredients;
+    int64_t stock[MAX_INGREDIENTS];
+    uint32_t num_belts;
+    uint64_t *completed;          // por banda
+    JournalOrder *orders;         // tabla hash por order_id
+    size_t order_count;
+    size_t order_capacity;
+} JournalState;
+
+void journal_state_free(JournalState *js);
+
+// ordenes vivas en orden de llegada (las despachadas ya sin la marca y con
+// sus ingredientes devueltos a js->stock). *out es de malloc
+size_t journal_state_requeue(JournalState *js, BurgerOrder **out);
+
+// carga el punto de control de path y aplica la cola del diario. devuelve
+// 1 si recupero el estado, 0 si no hay diario (se empieza de cero) y -1 si
+// el diario existe pero no se pudo leer
+int journal_recover(const char *path, JournalState *out);
+
+// crea el diario (vacio) y su punto de control inicial con el estado ya
+// inicializado de state: inventario y cuentas de las bandas salen de state,
+// las ordenes vivas de recovered (NULL si se empieza de cero), que queda a
+// cargo del diario. el mapeo lo heredan los hijos con fork
+bool journal_create(const char *path, uint64_t capacity, SharedSystemState *state, JournalState *recovered);
+
+// anota un registro. no hace nada si no hay diario abierto. solo espera si
+// el anillo esta lleno de registros que el punto de control todavia no cubre
+void journal_append(JournalRecordType type, const BurgerOrder *order, int32_t arg);
+void journal_append_restock(int ingredient, int quantity);
+
+// trabajo periodico del padre: aplica lo escrito a su estado resumido,
+// hace msync si paso sync_ms y escribe un punto de control si el anillo se
+// esta llenando o paso un segundo. saltea los registros que nunca se van a
+// escribir: los que anuncio un escritor ya recogido (journal_writer_exited)
+// y los que nadie anuncia pasados JOURNAL_ORPHAN_MS. final: saltea todos los
+// que falten y fuerza el punto de control
+void journal_tick(unsigned int sync_ms, bool final);
+
+// el padre recogio al proceso pid (murio o termino): sus lsn reservados y
+// sin publicar se saltean y sus casillas de escritor quedan libres
+void journal_writer_exited(pid_t pid);
+
+// cierra el diario (sin borrarlo: es lo que permite retomar la corrida)
+void journal_close(void);
+
+#endif
@@ -0,0 +1,133 @@
+// File: latency_hist.c
+
+#include <stdio.h>
+
+#include "latency_hist.h"
+
+#define HIST_HALF (1u << (HIST_SUB_BITS - 1))
+
+static inline uint64_t relaxed_load(const _Atomic uint64_t *v)
+{
+    return atomic_load_explicit((_Atomic uint64_t *)v, memory_order_relaxed);
+}
+
+static inline void relaxed_store(_Atomic uint64_t *v, uint64_t value)
+{
+    atomic_store_explicit(v, value, memory_order_relaxed);
+}
+
+// indice de cubeta: los valores pequenos van en cubetas lineales y el resto
+// se agrupa por potencia de dos conservando HIST_SUB_BITS bits de mantisa
+static unsigned bucket_of(uint64_t ns)
+{
+    if (ns >= (1ull << HIST_MAX_BITS))
+        ns = (1ull << HIST_MAX_BITS) - 1;
+    if (ns < 2 * HIST_HALF)
+        return (unsigned)ns;
+    unsigned msb = 63 - __builtin_clzll(ns);
+    unsigned shift = msb - (HIST_SUB_BITS - 1);
+    return shift * HIST_HALF + (unsigned)(ns >> shift);
+}
+
+// mayor valor que cae en la cubeta (como hace HDR, para no subestimar colas)
+static uint64_t bucket_upper(unsigned idx)
+{
+    if (idx < 2 * HIST_HALF)
+        return idx;
+    unsigned shift = idx / HIST_HALF - 1;
+    uint64_t mantissa = idx - shift * HIST_HALF;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void hist_reset(LatencyHistogram *h)
+{
+    relaxed_store(&h->total, 0);
+    relaxed_store(&h->sum_ns, 0);
+    relaxed_store(&h->max_ns, 0);
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+        relaxed_store(&h->counts[i], 0);
+}
+
+void hist_record(LatencyHistogram *h, uint64_t ns)
+{
+    unsigned idx = bucket_of(ns);
+    relaxed_store(&h->counts[idx], relaxed_load(&h->counts[idx]) + 1);
+    relaxed_store(&h->sum_ns, relaxed_load(&h->sum_ns) + ns);
+    if (ns > relaxed_load(&h->max_ns))
+        relaxed_store(&h->max_ns, ns);
+    // el total se publica al final para que un lector no vea mas muestras
+    // que las ya contadas en las cubetas
+    atomic_store_explicit(&h->total, relaxed_load(&h->total) + 1, memory_order_release);
+}
+
+void hist_merge(LatencyHistogram *dst, const LatencyHistogram *src)
+{
+    uint64_t total = atomic_load_explicit((_Atomic uint64_t *)&src->total, memory_order_acquire);
+    if (total == 0)
+        return;
+    uint64_t merged = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    {
+        uint64_t c = relaxed_load(&src->counts[i]);
+        if (c)
+        {
+            relaxed_store(&dst->counts[i], relaxed_load(&dst->counts[i]) + c);
+            merged += c;
+        }
+    }
+    relaxed_store(&dst->total, relaxed_load(&dst->total) + merged);
+    relaxed_store(&dst->sum_ns, relaxed_load(&dst->sum_ns) + relaxed_load(&src->sum_ns));
+    if (relaxed_load(&src->max_ns) > relaxed_load(&dst->max_ns))
+        relaxed_store(&dst->max_ns, relaxed_load(&src->max_ns));
+}
+
+void hist_delta(LatencyHistogram *out, const LatencyHistogram *a, const LatencyHistogram *b)
+{
+    uint64_t total = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    {
+        uint64_t c = relaxed_load(&b->counts[i]) - relaxed_load(&a->counts[i]);
+        relaxed_store(&out->counts[i], c);
+        total += c;
+    }
+    relaxed_store(&out->total, total);
+    relaxed_store(&out->sum_ns, relaxed_load(&b->sum_ns) - relaxed_load(&a->sum_ns));
+    // el maximo del intervalo no se puede separar; usamos el acumulado
+    relaxed_store(&out->max_ns, relaxed_load(&b->max_ns));
+}
+
+uint64_t hist_percentile(const LatencyHistogram *h, double pct)
+{
+    uint64_t total = relaxed_load(&h->total);
+    if (total == 0)
+        return 0;
+    uint64_t target = (uint64_t)(total * pct / 100.0 + 0.5);
+    if (target < 1)
+        target = 1;
+    if (target > total)
+        target = total;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += relaxed_load(&h->counts[i]);
+        if (seen >= target)
+        {
+            uint64_t value = bucket_upper(i);
+            uint64_t max = relaxed_load(&h->max_ns);
+            return value < max ? value : max;
+        }
+    }
+    return relaxed_load(&h->max_ns);
+}
+
+void hist_format_ns(char *buf, size_t len, uint64_t ns)
+{
+    if (ns < 10000)
+        snprintf(buf, len, "%luns", (unsigned long)ns);
+    else if (ns < 10000000)
+        snprintf(buf, len, "%.1fus", ns / 1e3);
+    else if (ns < 10000000000ull)
+        snprintf(buf, len, "%.1fms", ns / 1e6);
+    else
+        snprintf(buf, len, "%.2fs", ns / 1e9);
+}
@@ -0,0 +1,44 @@
+// File: latency_hist.h
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// histograma log-lineal al estilo HDR: cada potencia de dos se divide en
+// 2^(HIST_SUB_BITS-1) sub-cubetas, lo que da un error relativo de ~3%.
+// cubre latencias de 0 a 2^HIST_MAX_BITS ns (unos 18 minutos)
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 2) << (HIST_SUB_BITS - 1))
+
+// cada histograma tiene un unico escritor (la banda duena), por eso se
+// actualiza con cargas y almacenamientos atomicos relajados, sin bloqueos
+// ni instrucciones read-modify-write. los lectores pueden leerlo en cualquier
+// momento y fusionar varios histogramas
+typedef struct {
+    _Atomic uint64_t total;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t counts[HIST_BUCKETS];
+} LatencyHistogram;
+
+void hist_reset(LatencyHistogram *h);
+void hist_record(LatencyHistogram *h, uint64_t ns);
+
+// suma src en dst (dst debe ser privado del lector)
+void hist_merge(LatencyHistogram *dst, const LatencyHistogram *src);
+
+// muestras que estan en b y no en a (dos fotos privadas del mismo
+// histograma, b posterior): sirve para percentiles de un intervalo
+void hist_delta(LatencyHistogram *out, const LatencyHistogram *a, const LatencyHistogram *b);
+
+// valor (ns) por debajo del cual queda el porcentaje pct de las muestras
+uint64_t hist_percentile(const LatencyHistogram *h, double pct);
+
+// escribe una latencia en unidades legibles (us, ms o s)
+void hist_format_ns(char *buf, size_t len, uint64_t ns);
+
+#endif
@@ -0,0 +1,99 @@
+// File: log_ring.h
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// registro de eventos sin bloqueos: cada productor (una banda o el
+// generador) escribe registros binarios de tamano fijo en su propio anillo
+// de un productor y un consumidor. el proceso registrador es el unico que
+// los lee, les da formato y los escribe por lotes. publicar un evento es
+// copiar 32 bytes y un almacenamiento con release; nunca hay printf, mutex
+// ni llamadas al sistema en el camino de las ordenes. si el anillo esta
+// lleno el registro se descarta y se cuenta
+#define LOG_RING_RECORDS 1024   // potencia de dos
+#define LOG_RING_MASK (LOG_RING_RECORDS - 1)
+#define LOG_ARGS 2
+
+typedef enum {
+    LOG_OFF,        // silencio total (--quiet): ni anillos ni registrador
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG       // un evento por cada paso de cada orden
+} LogLevel;
+
+// eventos; el texto de cada uno vive en el registrador (logger.c)
+typedef enum {
+    LOG_EV_BELT_READY,          // args: pid
+    LOG_EV_BELT_EXIT,           // args: pid
+    LOG_EV_BELT_WAITING,
+    LOG_EV_BELT_PREPARING,      // args: orden
+    LOG_EV_BELT_DONE,           // args: orden, total de la banda
+    LOG_EV_BELT_NO_INGREDIENTS, // args: orden bloqueada
+    LOG_EV_BELT_PAUSED,
+    LOG_EV_BELT_RESUMED,
+    LOG_EV_BELT_DRAINED,
+    LOG_EV_BELT_RECOVERED,      // args: orden que dejo la banda muerta
+    LOG_EV_ORDER_CREATED,       // args: orden, profundidad de la cola
+    LOG_EV_ORDER_DROPPED,       // args: orden
+    LOG_EV_COUNT
+} LogEvent;
+
+typedef struct {
+    uint64_t time_ns;             // CLOCK_MONOTONIC
+    uint16_t event;               // LogEvent
+    uint8_t level;                // LogLevel
+    uint8_t reserved;
+    uint32_t args[LOG_ARGS];
+    uint32_t pad[3];
+} LogRecord;
+
+_Static_assert(sizeof(LogRecord) == 32, "LogRecord debe medir 32 bytes");
+
+// la posicion de escritura y la de lectura van en lineas distintas. el
+// productor guarda una copia de la de lectura y solo vuelve a leerla cuando
+// el anillo parece lleno; el registrador vacia todo lo publicado de una vez
+// y avanza tail una sola vez por lote
+typedef struct {
+    _Alignas(64) _Atomic uint64_t head;   // solo la escribe el productor
+    uint64_t cached_tail;
+    _Atomic uint64_t dropped;             // registros perdidos con el anillo lleno
+    _Alignas(64) _Atomic uint64_t tail;   // solo la escribe el registrador
+    _Alignas(64) LogRecord records[LOG_RING_RECORDS];
+} LogRing;
+
+// control del registro, en la parte fria del estado compartido
+typedef struct {
+    _Atomic int level;            // LogLevel; se puede cambiar durante la corrida
+    atomic_bool stop;             // el padre pide al registrador vaciar y salir
+    uint32_t num_rings;           // bandas + generador (0 en modo silencioso)
+    uint64_t start_ns;            // origen de los tiempos del archivo
+} LogControl;
+
+static inline void log_ring_push(LogRing *r, LogLevel level, LogEvent event, uint32_t a, uint32_t b, uint64_t now)
+{
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - r->cached_tail >= LOG_RING_RECORDS)
+    {
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head - r->cached_tail >= LOG_RING_RECORDS)
+        {
+            atomic_store_explicit(&r->dropped, atomic_load_explicit(&r->dropped, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return;
+        }
+    }
+    LogRecord *rec = &r->records[head & LOG_RING_MASK];
+    rec->time_ns = now;
+    rec->event = event;
+    rec->level = level;
+    rec->args[0] = a;
+    rec->args[1] = b;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+#endif
@@ -0,0 +1,172 @@
+// File: logger.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "logger.h"
+
+// el registrador vacia los anillos por lotes: si no encontro nada duerme un
+// rato corto (los productores nunca lo despiertan, asi no hacen llamadas al
+// sistema) y escribe cuando junta LOG_BATCH_BYTES o vacio todos los anillos
+#define LOGGER_IDLE_US 2000
+#define LOG_BATCH_BYTES 65536
+#define LOG_LINE_MAX 160
+
+static const char *level_names[] = {"off", "error", "warn", "info", "debug"};
+
+// texto de cada evento; recibe los argumentos del registro en orden
+static const char *event_formats[LOG_EV_COUNT] = {
+    [LOG_EV_BELT_READY] = "Conectada y lista (PID %u).",
+    [LOG_EV_BELT_EXIT] = "Terminando (PID %u)...",
+    [LOG_EV_BELT_WAITING] = "Esperando una orden...",
+    [LOG_EV_BELT_PREPARING] = "Preparando orden #%u...",
+    [LOG_EV_BELT_DONE] = "Orden #%u completada. Total: %u.",
+    [LOG_EV_BELT_NO_INGREDIENTS] = "Faltan ingredientes para la orden #%u. Pausando...",
+    [LOG_EV_BELT_PAUSED] = "Pausada desde la interfaz.",
+    [LOG_EV_BELT_RESUMED] = "Reanudada.",
+    [LOG_EV_BELT_DRAINED] = "Retirada: no toma mas ordenes.",
+    [LOG_EV_BELT_RECOVERED] = "Reemplaza a una banda caida: retoma la orden #%u.",
+    [LOG_EV_ORDER_CREATED] = "Nueva orden #%u creada. Total en cola: %u",
+    [LOG_EV_ORDER_DROPPED] = "Cola llena: orden #%u descartada.",
+};
+
+bool log_parse_level(const char *name, LogLevel *out)
+{
+    for (int i = LOG_OFF; i <= LOG_DEBUG; i++)
+    {
+        if (strcmp(name, level_names[i]) == 0)
+        {
+            *out = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *log_level_name(LogLevel level)
+{
+    return level >= LOG_OFF && level <= LOG_DEBUG ? level_names[level] : "?";
+}
+
+static SharedSystemState *shared_state = NULL;
+static int out_fd = -1;
+static char batch[LOG_BATCH_BYTES];
+static size_t batch_used = 0;
+
+static void flush_batch()
+{
+    size_t done = 0;
+    while (done < batch_used)
+    {
+        ssize_t n = write(out_fd, batch + done, batch_used - done);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("write (registro)");
+            break;
+        }
+        done += n;
+    }
+    batch_used = 0;
+}
+
+static void format_record(int source, const LogRecord *rec)
+{
+    if (batch_used > sizeof(batch) - LOG_LINE_MAX)
+        flush_batch();
+    char *line = batch + batch_used;
+    size_t room = sizeof(batch) - batch_used;
+    double t = (rec->time_ns - shared_state->log.start_ns) / 1e9;
+    int n;
+    if (source < shared_state->num_belts)
+        n = snprintf(line, room, "%12.6f %-5s [Banda %d] ", t, level_names[rec->level], source);
+    else
+        n = snprintf(line, room, "%12.6f %-5s [Generator] ", t, level_names[rec->level]);
+    const char *format = rec->event < LOG_EV_COUNT ? event_formats[rec->event] : "Evento desconocido.";
+    // todos los formatos usan a lo sumo LOG_ARGS enteros sin signo
+    n += snprintf(line + n, room - n, format, rec->args[0], rec->args[1]);
+    if ((size_t)n >= room - 1)
+        n = room - 2;
+    line[n++] = '\n';
+    batch_used += n;
+}
+
+// pasa a formato todo lo publicado en un anillo. devuelve cuantos registros leyo
+static uint64_t drain_ring(int source)
+{
+    LogRing *r = state_log_ring(shared_state, source);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    for (uint64_t pos = tail; pos != head; pos++)
+    {
+        format_record(source, &r->records[pos & LOG_RING_MASK]);
+    }
+    // las casillas se devuelven al productor de una sola vez
+    atomic_store_explicit(&r->tail, head, memory_order_release);
+    return head - tail;
+}
+
+void start_logger_process(const char *shm_name)
+{
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL)
+    {
+        exit(1);
+    }
+    const char *path = shared_state->config.log_path;
+    if (strcmp(path, "-") == 0)
+    {
+        out_fd = STDOUT_FILENO;
+    }
+    else
+    {
+        out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd == -1)
+        {
+            perror("open (registro)");
+            exit(1);
+        }
+    }
+
+    LogControl *log = &shared_state->log;
+    int num_rings = log->num_rings;
+    for (;;)
+    {
+        // stop se lee antes de vaciar: si ya estaba puesto y no quedo nada,
+        // los productores terminaron y todo lo que escribieron ya salio
+        bool stopping = atomic_load(&log->stop);
+        uint64_t drained = 0;
+        for (int i = 0; i < num_rings; i++)
+        {
+            drained += drain_ring(i);
+        }
+        if (batch_used > 0)
+            flush_batch();
+        if (drained == 0)
+        {
+            if (stopping)
+                break;
+            sleep_us(LOGGER_IDLE_US);
+        }
+    }
+
+    uint64_t dropped = 0;
+    for (int i = 0; i < num_rings; i++)
+    {
+        dropped += atomic_load(&state_log_ring(shared_state, i)->dropped);
+    }
+    if (dropped > 0)
+    {
+        batch_used = snprintf(batch, sizeof(batch), "[Logger] %lu registros perdidos con el anillo lleno.\n",
+                              (unsigned long)dropped);
+        flush_batch();
+    }
+    if (out_fd != STDOUT_FILENO)
+        close(out_fd);
+    shm_detach(shared_state);
+}
@@ -0,0 +1,13 @@
+// File: logger.h
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "shared_data.h"
+
+// nombres de los niveles para la linea de comandos y la interfaz
+// (off, error, warn, info, debug). devuelve false si no lo reconoce
+bool log_parse_level(const char *name, LogLevel *out);
+const char *log_level_name(LogLevel level);
+
+#endif
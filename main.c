@@ -7,67 +7,73 @@
 #include <fcntl.h>   
 #include <signal.h>  
 #include <sys/wait.h> 
+#include <getopt.h>
+#include <errno.h>
 
 #include "shared_data.h"
+#include "order_queue.h"
+#include "inventory.h"
+#include "dispatcher.h"
+#include "belt.h"
+#include "clock_utils.h"
+#include "trace.h"
+#include "simulation.h"
+#include "stats_segment.h"
+#include "logger.h"
+#include "journal.h"
+#include "autoscaler.h"
+#include "restocker.h"
+#include "pipeline.h"
 
 // prototipos de las funciones que inician los otros procesos
 void start_belt_process(int belt_id, const char *shm_name);
+void start_belt_threads_process(int num_belts, const char *shm_name);
+void start_pipeline_process(const char *shm_name);
 void start_order_generator_process(const char *shm_name);
+void start_restock_process(const char *shm_name);
 void start_ui_control_process(const char *shm_name);
+void start_logger_process(const char *shm_name);
 
 // puntero global a la memoria compartida
 SharedSystemState *shared_state = NULL;
+// segmento de estadisticas para burger_stat (NULL si no se pudo crear)
+StatsSegment *stats_segment = NULL;
 
-// descriptor de archivo para la memoria compartida
-int shm_fd = -1;
-
-// funcion para despertar a los hijos que puedan estar bloqueados en un semaforo
+// funcion para despertar a los hijos que puedan estar bloqueados en la cola
 void wake_up_children()
 {
     if (shared_state == NULL)
         return;
-    // despertar a todas las bandas posibles
-    for (int i = 0; i < shared_state->num_belts; i++)
-    {
-        sem_post(&shared_state->sem_orders_available);
-    }
-    // despertar al generador de ordenes
-    sem_post(&shared_state->sem_space_available);
+    // despierta a las bandas (cola vacia o sin ingredientes) y al generador (cola llena)
+    dispatcher_wake_all(shared_state);
 }
 
 // funcion para liberar todos los recursos al terminar
 void cleanup()
 {
-    // restauramos la terminal por si algo salio mal
-    printf("\033[?1049l");
-    printf("\033c");
+    // restauramos la terminal por si algo salio mal (solo si hubo interfaz)
+    if (shared_state == NULL || !shared_state->config.headless)
+    {
+        printf("\033[?1049l");
+        printf("\033c");
+    }
 
     if (shared_state != NULL)
     {
         printf("\n[Main] Iniciando limpieza de recursos...\n");
-        // destruimos semaforos y mutex
-        sem_destroy(&shared_state->sem_orders_available);
-        sem_destroy(&shared_state->sem_space_available);
-        pthread_mutex_destroy(&shared_state->waiting_orders.mutex);
-        for (int i = 0; i < MAX_INGREDIENTS; ++i)
-        {
-            if (strlen(shared_state->ingredients[i].name) > 0)
-            {
-                pthread_mutex_destroy(&shared_state->ingredients[i].mutex);
-            }
-        }
+        // destruimos los mutex del inventario si los hay (la cola no usa ninguno)
+        inventory_destroy(&shared_state->inventory);
         // liberamos el mapeo de memoria
-        munmap(shared_state, sizeof(SharedSystemState));
+        shm_detach(shared_state);
         shared_state = NULL;
     }
-    if (shm_fd != -1)
+    if (stats_segment != NULL)
     {
-        // cerramos el descriptor de archivo
-        close(shm_fd);
-        shm_fd = -1;
+        stats_segment_destroy(stats_segment);
+        stats_segment = NULL;
     }
-    // eliminamos el archivo de memoria compartida
-    shm_unlink(SHM_NAME);
+    // eliminamos el archivo de memoria compartida (en /dev/shm o en hugetlbfs)
+    shm_remove(SHM_NAME);
     printf("[Main] Limpieza completada.\n");
 }
 
@@ -82,7 +88,7 @@ void signal_handler(int sig)
             // avisamos a todos los hijos que deben terminar
             shared_state->system_running = false; 
 
-            // despertamos a los hijos por si estan dormidos en un sem_wait
+            // despertamos a los hijos por si estan dormidos esperando en la cola
             wake_up_children();
 
             // pausa critica para dar tiempo a la ui de restaurar la terminal
@@ -91,136 +97,1332 @@ void signal_handler(int sig)
     }
 }
 
-int main(int argc, char *argv[])
+void print_usage(const char *prog)
 {
-    int num_belts = 5;
-    if (argc > 1)
+    fprintf(stderr,
+            "Uso: %s [bandas] [opciones]\n"
+            "  -H, --headless        sin interfaz (modo benchmark)\n"
+            "  -s, --service-us N    tiempo de preparacion por orden en us (def. 2000000)\n"
+            "  -a, --arrival-us N    tiempo entre ordenes en us (def. aleatorio 1-3 s)\n"
+            "  -d, --duration S      termina la corrida tras S segundos\n"
+            "  -n, --orders N        termina la corrida tras completar N ordenes\n"
+            "  -S, --stock N         unidades iniciales de cada ingrediente\n"
+            "  -v, --verbose         registra cada evento de orden (igual que --log-level debug)\n"
+            "      --log-level L     off, error, warn, info o debug (def. debug con interfaz, info sin ella)\n"
+            "      --log FILE        archivo del registro, '-' es la salida estandar\n"
+            "                        (def. burger_machine.log con interfaz, '-' sin ella)\n"
+            "  -Q, --quiet           sin registro de eventos (ni anillos ni proceso registrador)\n"
+            "  -L, --locked-inventory  usa el inventario con un mutex por ingrediente\n"
+            "  -w, --window N        ordenes de la cabeza de la cola que se examinan (1-%d, 1 = FIFO; def. 16)\n"
+            "  -g, --aging N         veces que una orden puede ser adelantada (def. 8)\n"
+            "      --batch N         ordenes que una banda toma de una vez como maximo, segun lo\n"
+            "                        que espera (hasta la ventana; def. 1, 4 con --threads)\n"
+            "  -T, --threads         bandas como hilos de un solo proceso con robo de trabajo\n"
+            "      --pipeline SPEC   prepara en etapas con su propio grupo de trabajadores, por\n"
+            "                        ejemplo grill:2:1000000,assemble:1,wrap:1 (nombre[:trabajadores[:us]];\n"
+            "                        sin us, la parte que le toca de --service-us; hasta %d etapas).\n"
+            "                        las bandas son los trabajadores\n"
+            "      --stage-queue N   casillas de cada cola entre etapas (1-%d; def. %d)\n"
+            "  -q, --queue N         capacidad de la cola de ordenes, de cada clase con --classes (def. %d)\n"
+            "      --classes SPEC    mezcla de clases de prioridad, por ejemplo premium:20:3000000,walkin:30\n"
+            "                        (clase:porcentaje[:plazo_us]; clases standard, premium y walkin;\n"
+            "                        standard se queda con el resto; plazos def. %d, %d y %d us)\n"
+            "      --edf             despacha primero el plazo mas cercano (def. por llegada)\n"
+            "      --auto-restock    repone ingredientes antes de que se agoten, segun las llegadas\n"
+            "                        y lo que piden las ordenes en espera\n"
+            "      --restock-lead-ms N  lo que tarda en llegar un pedido de reposicion (def. %d)\n"
+            "      --restock-batch N    unidades por pedido de reposicion (def. %d)\n"
+            "  -p, --profile P       llegadas: classic (def.), constant, poisson, burst, step\n"
+            "  -r, --rate R          ordenes por segundo de los perfiles de lazo abierto\n"
+            "  -b, --burst N         ordenes por rafaga en el perfil burst (def. 10)\n"
+            "      --step-rate R     aumento de la tasa en cada escalon del perfil step\n"
+            "      --step-seconds S  duracion de cada escalon del perfil step (def. 1)\n"
+            "  -o, --overflow M      con la cola llena: backlog (def., esperan en el generador) o drop\n"
+            "      --seed N          semilla fija del generador (corridas repetibles)\n"
+            "      --record FILE     graba las ordenes generadas en una traza binaria\n"
+            "      --replay FILE     reproduce las ordenes de una traza con sus tiempos de llegada\n"
+            "      --replay-fast     reproduce la traza lo mas rapido posible\n"
+            "      --simulate        simulacion de eventos discretos con reloj virtual (sin procesos)\n"
+            "      --journal FILE    diario de ordenes, inventario y reposiciones; si ya existe,\n"
+            "                        la corrida retoma el estado en que quedo la anterior\n"
+            "      --journal-records N  registros del anillo del diario (def. %u)\n"
+            "      --journal-sync-ms N  intervalo del msync en grupo (def. %d ms)\n"
+            "      --autoscale       crea y retira bandas segun la carga; el numero de bandas\n"
+            "                        es el inicial (solo con bandas proceso)\n"
+            "      --min-belts N     minimo de bandas activas con --autoscale (def. 1)\n"
+            "      --max-belts N     maximo de bandas activas con --autoscale (def. 4 veces las iniciales)\n"
+            "      --target-wait-us N  p99 de espera en cola buscado por --autoscale (def. %d)\n"
+            "      --hugepages[=DIR] segmento en paginas enormes de un montaje hugetlbfs (def. %s)\n"
+            "      --prefault        mapea el segmento ya poblado y lo fija en memoria (mlock)\n"
+            "      --belt-cpus LIST  fija la banda i a la i-esima cpu de LIST (ej. 2-5,8)\n"
+            "      --generator-cpu N fija el generador a la cpu N\n"
+            "      --ui-cpu N        fija la interfaz a la cpu N\n"
+            "      --numa-node N     corre todo en las cpus del nodo N; el segmento se crea\n"
+            "                        desde ahi, asi su memoria queda en ese nodo\n",
+            prog, MAX_DISPATCH_WINDOW, MAX_STAGES, STAGE_QUEUE_LIMIT, DEFAULT_STAGE_QUEUE, DEFAULT_QUEUE_CAPACITY,
+            DEFAULT_STANDARD_DEADLINE_US, DEFAULT_PREMIUM_DEADLINE_US, DEFAULT_WALKIN_DEADLINE_US,
+            DEFAULT_RESTOCK_LEAD_MS, DEFAULT_RESTOCK_BATCH, JOURNAL_DEFAULT_RECORDS, JOURNAL_DEFAULT_SYNC_MS,
+            AUTOSCALE_DEFAULT_TARGET_WAIT_US, DEFAULT_HUGETLB_DIR);
+}
+
+// lee una tasa positiva (ordenes por segundo), o termina con error
+double parse_rate(const char *arg, const char *option)
+{
+    char *end;
+    double value = strtod(arg, &end);
+    if (*arg == '\0' || *end != '\0' || !(value >= 0) || value > 1e9)
     {
-        num_belts = atoi(argv[1]);
-        if (num_belts <= 0 || num_belts > MAX_BELTS)
+        fprintf(stderr, "Error: valor invalido para %s: '%s'.\n", option, arg);
+        exit(1);
+    }
+    return value;
+}
+
+// lee la mezcla de clases "clase:porcentaje[:plazo_us],..." en config; la
+// clase estandar se queda con el porcentaje que falte. devuelve false si la
+// especificacion no es valida
+bool parse_classes(const char *spec, SystemConfig *config)
+{
+    bool given[ORDER_CLASSES] = {false};
+    int total = 0;
+    const char *p = spec;
+    while (*p != '\0')
+    {
+        size_t len = strcspn(p, ":,");
+        int c = 0;
+        while (c < ORDER_CLASSES && (strlen(order_class_name(c)) != len || strncmp(p, order_class_name(c), len) != 0))
+            c++;
+        if (c == ORDER_CLASSES || given[c] || p[len] != ':')
+            return false;
+        given[c] = true;
+        char *end;
+        long percent = strtol(p + len + 1, &end, 10);
+        if (end == p + len + 1 || percent < 0 || percent > 100)
+            return false;
+        config->class_mix[c] = (int)percent;
+        total += (int)percent;
+        p = end;
+        if (*p == ':')
         {
-            fprintf(stderr, "Error: El numero de bandas debe estar entre 1 y %d.\n", MAX_BELTS);
-            return 1;
+            long long us = strtoll(p + 1, &end, 10);
+            if (end == p + 1 || us < 0)
+                return false;
+            config->class_deadline_us[c] = (uint64_t)us;
+            p = end;
         }
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return false;
     }
-    printf("[Main] Iniciando sistema con %d bandas de preparacion.\n", num_belts);
+    if (given[ORDER_STANDARD])
+        return total == 100;
+    if (total > 100)
+        return false;
+    config->class_mix[ORDER_STANDARD] = 100 - total;
+    return true;
+}
 
-    // preparamos la memoria compartida
-    shm_unlink(SHM_NAME);
-    shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1)
+// copia una ruta a un campo de la configuracion, o termina con error
+void copy_path(char *dst, size_t len, const char *arg, const char *option)
+{
+    if (strlen(arg) >= len)
     {
-        perror("shm_open");
+        fprintf(stderr, "Error: ruta demasiado larga para %s.\n", option);
         exit(1);
     }
-    if (ftruncate(shm_fd, sizeof(SharedSystemState)) == -1)
+    strcpy(dst, arg);
+}
+
+// lee un entero no negativo de un argumento, o termina con error
+int parse_count(const char *arg, const char *option)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value < 0 || value > 2000000000L)
     {
-        perror("ftruncate");
-        close(shm_fd);
-        shm_unlink(SHM_NAME);
+        fprintf(stderr, "Error: valor invalido para %s: '%s'.\n", option, arg);
         exit(1);
     }
-    shared_state = mmap(NULL, sizeof(SharedSystemState), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_state == MAP_FAILED)
+    return (int)value;
+}
+
+// lee una semilla de 64 bits (decimal, 0x hexadecimal u 0 octal), o termina con error
+uint64_t parse_seed(const char *arg, const char *option)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 0);
+    // strtoull salta espacios y acepta signo (" -1" seria 2^64-1): tiene que empezar con un digito
+    if (*arg < '0' || *arg > '9' || *end != '\0' || errno == ERANGE)
     {
-        perror("mmap");
-        close(shm_fd);
-        shm_unlink(SHM_NAME);
+        fprintf(stderr, "Error: valor invalido para %s: '%s'.\n", option, arg);
         exit(1);
     }
-    printf("[Main] Memoria compartida creada y mapeada correctamente.\n");
+    return (uint64_t)value;
+}
 
-    // inicializamos el estado del sistema
-    printf("[Main] Inicializando estado del sistema y primitivas de sincronizacion...\n");
-    memset(shared_state, 0, sizeof(SharedSystemState));
-    shared_state->system_running = true;
-    shared_state->num_belts = num_belts;
+// ordenes que cada banda ya tenia completadas al arrancar (recuperadas del diario)
+unsigned int completed_at_start[BELT_LIMIT];
+// ordenes pendientes que volvieron a la cola al recuperar el diario
+size_t recovered_pending = 0;
+
+// ordenes completadas por una banda en esta corrida
+unsigned int belt_completed(int belt)
+{
+    return state_belt(shared_state, belt)->burgers_processed - completed_at_start[belt];
+}
+
+// ordenes completadas por todas las bandas en esta corrida
+unsigned long total_completed()
+{
+    unsigned long total = 0;
+    for (int i = 0; i < shared_state->num_belts; i++)
+    {
+        total += belt_completed(i);
+    }
+    return total;
+}
+
+// copia una foto del estado en el segmento de estadisticas. solo lee
+// SharedSystemState (con los seqlock de cada escritor); los histogramas se
+// fusionan cada STATS_HIST_EVERY fotos y siempre en la ultima (final)
+void publish_stats(bool final)
+{
+    StatsSegment *seg = stats_segment;
+    if (seg == NULL)
+        return;
+    static BeltMetrics merged;
+    bool merge = final || seg->samples % STATS_HIST_EVERY == 0;
+    if (merge)
+        belt_metrics_merge_all(shared_state, &merged);
+
+    RunStats *stats = &shared_state->stats;
+    uint64_t generated, dropped, backlogged;
+    uint32_t depth_max, backlog_max, v;
+    do
+    {
+        v = seqlock_read_begin(&stats->seq);
+        generated = atomic_load_explicit(&stats->orders_generated, memory_order_relaxed);
+        dropped = atomic_load_explicit(&stats->orders_dropped, memory_order_relaxed);
+        backlogged = atomic_load_explicit(&stats->orders_backlogged, memory_order_relaxed);
+        depth_max = atomic_load_explicit(&stats->depth_max, memory_order_relaxed);
+        backlog_max = atomic_load_explicit(&stats->backlog_max, memory_order_relaxed);
+    } while (seqlock_read_retry(&stats->seq, v));
+    int depth = dispatcher_pending(shared_state);
+
+    seqlock_write_begin(&seg->seq);
+    seg->sample_ns = now_ns();
+    seg->samples++;
+    seg->running = !final;
+    seg->orders_generated = generated;
+    seg->orders_dropped = dropped;
+    seg->orders_backlogged = backlogged;
+    seg->queue_depth = depth;
+    seg->queue_capacity = order_queue_capacity(&shared_state->waiting_orders) + shared_state->config.dispatch_window;
+    seg->depth_max = depth_max;
+    seg->backlog_max = backlog_max;
+    for (uint32_t i = 0; i < seg->num_ingredients; i++)
+    {
+        seg->stock[i] = inventory_count(&shared_state->inventory, i);
+        seg->demand_milli[i] = atomic_load_explicit(&shared_state->restock.rate_milli[i], memory_order_relaxed);
+        seg->depletion_ms[i] = atomic_load_explicit(&shared_state->restock.depletion_ms[i], memory_order_relaxed);
+    }
+    seg->restock_orders = atomic_load_explicit(&shared_state->restock.orders, memory_order_relaxed);
+    seg->restock_units = atomic_load_explicit(&shared_state->restock.units, memory_order_relaxed);
+    seg->stall_ns = atomic_load_explicit(&shared_state->restock.stall_ns, memory_order_relaxed);
+    seg->stall_ns_avoided = atomic_load_explicit(&shared_state->restock.stall_ns_avoided, memory_order_relaxed);
+    uint64_t completed = 0;
+    for (uint32_t i = 0; i < seg->num_belts; i++)
+    {
+        BeltSnapshot belt;
+        belt_snapshot(state_belt(shared_state, i), &belt);
+        seg->belts[i].pid = state_belt_info(shared_state, i)->pid;
+        seg->belts[i].status = belt.status;
+        seg->belts[i].processed = belt.burgers_processed;
+        seg->belts[i].stolen = belt.orders_stolen;
+        completed += belt.burgers_processed - completed_at_start[i];
+    }
+    seg->orders_completed = completed;
+    for (uint32_t s = 0; s < seg->num_stages; s++)
+    {
+        PipelineStage *stage = &shared_state->pipeline[s];
+        seg->stages[s].queue_depth = pipeline_queue_depth(shared_state, s);
+        seg->stages[s].queue_capacity = pipeline_queue_capacity(shared_state, s);
+        // la primera etapa espera en la cola de ordenes
+        seg->stages[s].depth_max = s == 0 ? depth_max : atomic_load_explicit(&stage->depth_max, memory_order_relaxed);
+        seg->stages[s].processed = atomic_load_explicit(&stage->processed, memory_order_relaxed);
+        seg->stages[s].busy_ns = atomic_load_explicit(&stage->busy_ns, memory_order_relaxed);
+    }
+    if (merge)
+    {
+        memcpy(&seg->queue_wait, &merged.queue_wait, sizeof(LatencyHistogram));
+        memcpy(&seg->service, &merged.service, sizeof(LatencyHistogram));
+        memcpy(&seg->total, &merged.total, sizeof(LatencyHistogram));
+        for (uint32_t c = 0; c < seg->num_classes; c++)
+        {
+            memcpy(&seg->classes[c].lateness, &merged.lateness[c], sizeof(LatencyHistogram));
+            seg->classes[c].missed = merged.missed[c];
+        }
+    }
+    for (uint32_t c = 0; c < seg->num_classes; c++)
+        seg->classes[c].queue_depth = order_queue_class_size(&shared_state->waiting_orders, c);
+    seqlock_write_end(&seg->seq);
+}
+
+// crea el proceso de la banda id; en modo con hilos o pipeline, el unico
+// proceso con todas las bandas. devuelve su pid (-1 si fork fallo)
+pid_t spawn_belts(int id)
+{
+    const SystemConfig *config = &shared_state->config;
+    bool single = config->threaded_belts || config->num_stages > 0;
+    // que el hijo no herede (y repita) lo pendiente en stdout
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror(single ? "fork para bandas" : "fork para banda");
+        return -1;
+    }
+    if (pid == 0)
+    {
+        if (config->num_stages > 0)
+            start_pipeline_process(SHM_NAME);
+        else if (config->threaded_belts)
+            start_belt_threads_process(shared_state->num_belts, SHM_NAME);
+        else
+            start_belt_process(id, SHM_NAME);
+        exit(0);
+    }
+    int first = single ? 0 : id;
+    int last = single ? shared_state->num_belts - 1 : id;
+    for (int i = first; i <= last; ++i)
+    {
+        state_belt_info(shared_state, i)->pid = pid;
+    }
+    return pid;
+}
+
+// bandas reemplazadas por el supervisor en esta corrida
+unsigned long belts_respawned = 0;
+
+// supervisor: recoge los procesos de bandas que terminaron y reemplaza en
+// su lugar a los que murieron (una senal o un error). una banda retirada
+// sale con 0 y no se reemplaza. la nueva banda repara el estado que la
+// anterior dejo a medias y termina su orden en curso (belt_recover)
+void supervise_belts(pid_t pids[], int belt_processes)
+{
+    for (int i = 0; i < belt_processes; i++)
+    {
+        int status;
+        if (pids[i] <= 0 || waitpid(pids[i], &status, WNOHANG) != pids[i])
+            continue;
+        pid_t dead = pids[i];
+        pids[i] = 0;
+        // lo que dejo reservado en el diario sin escribir no se espera mas
+        journal_writer_exited(dead);
+        if (!shared_state->system_running || (WIFEXITED(status) && WEXITSTATUS(status) == 0))
+            continue;
+        pids[i] = spawn_belts(i);
+        belts_respawned++;
+        if (shared_state->config.headless)
+        {
+            if (WIFSIGNALED(status))
+                printf("[Main] Banda %d (PID %d) murio por la senal %d; la reemplaza el PID %d.\n", i, dead,
+                       WTERMSIG(status), pids[i]);
+            else
+                printf("[Main] Banda %d (PID %d) termino con error %d; la reemplaza el PID %d.\n", i, dead,
+                       WEXITSTATUS(status), pids[i]);
+        }
+    }
+}
+
+// autoescalado (solo con --autoscale): las casillas de bandas del segmento
+// son max_belts y solo algunas tienen proceso; las demas quedan retiradas
+bool autoscale_enabled = false;
+Autoscaler autoscaler;
+uint64_t autoscale_prev_ns = 0;
+uint64_t autoscale_prev_generated = 0;
+unsigned long autoscale_prev_completed = 0;
+BeltMetrics autoscale_prev_metrics;
+
+// bandas activas: con proceso y sin una pausa o un retiro pedidos
+int active_belts(const pid_t pids[])
+{
+    int active = 0;
+    for (int i = 0; i < shared_state->num_belts; i++)
+    {
+        if (pids[i] > 0 && atomic_load(&state_belt(shared_state, i)->command) == BELT_RUN)
+            active++;
+    }
+    return active;
+}
+
+// una evaluacion del autoescalado: mide el ultimo intervalo, decide y crea
+// bandas en casillas libres o retira la activa de mayor numero (termina su
+// orden en curso y sale; el supervisor la recoge y libera la casilla)
+void autoscale_step(pid_t pids[])
+{
+    static BeltMetrics current;
+    static LatencyHistogram wait, service;
+    uint64_t now = now_ns();
+    double dt = (now - autoscale_prev_ns) / 1e9;
+    belt_metrics_merge_all(shared_state, &current);
+    hist_delta(&wait, &autoscale_prev_metrics.queue_wait, &current.queue_wait);
+    hist_delta(&service, &autoscale_prev_metrics.service, &current.service);
+    uint64_t generated = shared_state->stats.orders_generated;
+    unsigned long completed = total_completed();
+
+    AutoscaleSample sample = {
+        .arrival_rate = (generated - autoscale_prev_generated) / dt,
+        .completion_rate = (completed - autoscale_prev_completed) / dt,
+        .wait_p99_ns = hist_percentile(&wait, 99.0),
+        .service_mean_ns = service.total ? (double)service.sum_ns / service.total : 0.0,
+        .queue_depth = dispatcher_pending(shared_state),
+        .active = active_belts(pids),
+    };
+    int desired = autoscaler_decide(&autoscaler, &sample, now);
+    if (desired != sample.active && shared_state->config.headless)
+    {
+        char p99[16];
+        hist_format_ns(p99, sizeof(p99), sample.wait_p99_ns);
+        printf("[Main] Autoescalado: %d -> %d bandas (espera p99 %s, llegan %.0f/s, salen %.0f/s, cola %d).\n",
+               sample.active, desired, p99, sample.arrival_rate, sample.completion_rate, sample.queue_depth);
+    }
+    for (int i = 0; i < shared_state->num_belts && sample.active < desired; i++)
+    {
+        if (pids[i] != 0)
+            continue;
+        atomic_store(&state_belt(shared_state, i)->command, BELT_RUN);
+        pids[i] = spawn_belts(i);
+        if (pids[i] > 0)
+            sample.active++;
+        else
+            pids[i] = 0;
+    }
+    for (int i = shared_state->num_belts - 1; i >= 0 && sample.active > desired; i--)
+    {
+        if (pids[i] > 0 && atomic_load(&state_belt(shared_state, i)->command) == BELT_RUN)
+        {
+            belt_send_command(shared_state, i, BELT_DRAIN);
+            sample.active--;
+        }
+    }
+
+    autoscale_prev_ns = now;
+    autoscale_prev_generated = generated;
+    autoscale_prev_completed = completed;
+    memcpy(&autoscale_prev_metrics, &current, sizeof(BeltMetrics));
+}
+
+// el padre vigila la corrida, supervisa las bandas y publica las
+// estadisticas. en modo sin interfaz ademas la termina al cumplirse la
+// duracion o el numero de ordenes pedidos; con interfaz la termina Ctrl+C
+double monitor_run(pid_t belt_pids[], int belt_processes)
+{
+    const SystemConfig *config = &shared_state->config;
+    uint64_t start = now_ns();
+    unsigned long ticks = 0;
+    while (shared_state->system_running)
+    {
+        sleep_us(10000);
+        supervise_belts(belt_pids, belt_processes);
+        if (autoscale_enabled && ticks % (AUTOSCALE_INTERVAL_MS / 10) == 0)
+            autoscale_step(belt_pids);
+        journal_tick(config->journal_sync_ms, false);
+        if (++ticks % (STATS_PUBLISH_US / 10000) == 0)
+            publish_stats(false);
+        if (!config->headless)
+            continue;
+        double elapsed = (now_ns() - start) / 1e9;
+        if (config->run_seconds > 0 && elapsed >= config->run_seconds)
+            break;
+        // las ordenes descartadas por cola llena nunca se completan
+        if (config->max_orders > 0 && total_completed() + shared_state->stats.orders_dropped >= config->max_orders)
+            break;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    if (config->headless)
+    {
+        shared_state->system_running = false;
+        wake_up_children();
+    }
+    return elapsed;
+}
+
+// una linea por etapa del pipeline con su utilizacion en la corrida; la
+// mas ocupada es el cuello de botella, la que conviene agrandar
+void print_pipeline_report(double elapsed)
+{
+    const SystemConfig *config = &shared_state->config;
+    int bottleneck = -1;
+    double worst = -1.0;
+    for (int s = 0; s < config->num_stages; s++)
+    {
+        PipelineStage *stage = &shared_state->pipeline[s];
+        double utilization = elapsed > 0 ? stage->busy_ns / (elapsed * 1e9 * config->stages[s].workers) : 0.0;
+        printf("[Main] Etapa %-10s: %d trabajadores, %lu ordenes (%.1f/s), utilizacion %.0f%%, cola maxima %u/%d\n",
+               config->stages[s].name, config->stages[s].workers, (unsigned long)stage->processed,
+               stage->processed / elapsed, utilization * 100.0,
+               s == 0 ? (unsigned)shared_state->stats.depth_max : (unsigned)stage->depth_max,
+               pipeline_queue_capacity(shared_state, s));
+        if (utilization > worst)
+        {
+            worst = utilization;
+            bottleneck = s;
+        }
+    }
+    if (bottleneck >= 0)
+        printf("[Main] Cuello de botella: %s (%.0f%% ocupada)\n", config->stages[bottleneck].name, worst * 100.0);
+}
+
+// una linea por clase de prioridad: cuantas se pasaron de su plazo y por
+// cuanto (solo con --classes)
+void print_class_report(const BeltMetrics *merged)
+{
+    const SystemConfig *config = &shared_state->config;
+    if (shared_state->waiting_orders.num_lanes == 1)
+        return;
+    printf("[Main] Plazos (%s):\n", config->edf ? "edf, primero el plazo mas cercano" : "por orden de llegada");
+    for (int c = 0; c < ORDER_CLASSES; c++)
+    {
+        const LatencyHistogram *late = &merged->lateness[c];
+        if (config->class_mix[c] == 0 && late->total == 0)
+            continue;
+        char deadline[16], p99[16], max[16];
+        hist_format_ns(deadline, sizeof(deadline), config->class_deadline_us[c] * 1000);
+        hist_format_ns(p99, sizeof(p99), hist_percentile(late, 99.0));
+        hist_format_ns(max, sizeof(max), late->max_ns);
+        uint64_t missed = merged->missed[c];
+        printf("[Main]   %-8s (%3d%%, plazo %-7s): %lu ordenes | fuera de plazo %lu (%.1f%%) | retraso p99 %s max %s\n",
+               order_class_name(c), config->class_mix[c], deadline, (unsigned long)late->total, (unsigned long)missed,
+               late->total ? 100.0 * missed / late->total : 0.0, p99, max);
+    }
+}
+
+// pedidos de la reposicion automatica, la demanda estimada de cada
+// ingrediente y el tiempo de banda parada por ingredientes (y el evitado)
+void print_restock_report(void)
+{
+    const SystemConfig *config = &shared_state->config;
+    RestockStats *restock = &shared_state->restock;
+    if (!config->restock.enabled)
+        return;
+    printf("[Main] Reposicion automatica: %lu pedidos, %lu unidades (lotes de %d, entrega en %d ms)"
+           " | bandas paradas %.2f s (evitado %.2f s)\n",
+           (unsigned long)restock->orders, (unsigned long)restock->units, config->restock.batch,
+           config->restock.lead_time_ms, restock->stall_ns / 1e9, restock->stall_ns_avoided / 1e9);
+    printf("[Main]   Demanda:");
+    for (uint32_t i = 0; i < shared_state->inventory.num_ingredients; i++)
+    {
+        printf("%s %s %.1f/s", i ? "," : "", shared_state->ingredient_info[i].name, restock->rate_milli[i] / 1000.0);
+    }
+    printf("\n");
+}
+
+void print_report(double elapsed)
+{
+    RunStats *stats = &shared_state->stats;
+    unsigned long completed = total_completed();
+    uint64_t samples = stats->depth_samples;
+
+    printf("[Main] ===== Reporte de la corrida =====\n");
+    printf("[Main] Bandas: %d | Duracion: %.3f s\n", shared_state->num_belts, elapsed);
+    printf("[Main] Ordenes generadas: %lu | completadas: %lu\n", (unsigned long)stats->orders_generated, completed);
+    printf("[Main] Throughput: %.1f ordenes/s\n", completed / elapsed);
+    if (shared_state->config.journal_path[0] != '\0')
+    {
+        unsigned long restored = 0;
+        for (int i = 0; i < shared_state->num_belts; i++)
+            restored += completed_at_start[i];
+        if (restored > 0 || recovered_pending > 0)
+            printf("[Main] Recuperadas del diario: %lu completadas antes de la caida (no cuentan arriba) | %zu pendientes"
+                   " devueltas a la cola (cuentan como completadas, no como generadas)\n",
+                   restored, recovered_pending);
+    }
+    if (autoscale_enabled)
+    {
+        printf("[Main] Autoescalado: %lu altas, %lu bajas | bandas activas min %d, max %d, media %.1f\n",
+               autoscaler.ups, autoscaler.downs, autoscaler.min_active, autoscaler.max_active,
+               autoscaler.samples ? autoscaler.active_sum / autoscaler.samples : 0.0);
+    }
+    uint32_t owner_deaths = atomic_load(&shared_state->inventory.owner_deaths);
+    if (belts_respawned > 0 || owner_deaths > 0)
+    {
+        printf("[Main] Fallas: %lu bandas reemplazadas | %u mutex recuperados de un dueno muerto\n", belts_respawned,
+               owner_deaths);
+    }
+    unsigned long batches = 0, batched_orders = 0;
+    for (int i = 0; i < shared_state->num_belts; i++)
+    {
+        batches += state_belt(shared_state, i)->batches;
+        batched_orders += state_belt(shared_state, i)->batched_orders;
+    }
+    double batch_mean = batches ? (double)batched_orders / batches : 1.0;
+    if (batches > 0)
+    {
+        printf("[Main] Lotes: %lu (hasta %d ordenes) | media %.2f ordenes por lote\n", batches,
+               shared_state->config.batch_size, batch_mean);
+    }
+    print_restock_report();
+    const ArrivalConfig *arrival = &shared_state->config.arrival;
+    if (arrival->profile != ARRIVAL_CLASSIC)
+    {
+        printf("[Main] Llegadas '%s': ofrecidas %.1f ordenes/s | descartadas %lu | esperaron en el generador %lu (max %u)\n",
+               arrival_profile_name(arrival->profile), stats->orders_generated / elapsed,
+               (unsigned long)stats->orders_dropped, (unsigned long)stats->orders_backlogged, (unsigned)stats->backlog_max);
+    }
+    print_pipeline_report(elapsed);
+    for (int i = 0; i < shared_state->num_belts; i++)
+    {
+        if (shared_state->config.num_stages > 0)
+        {
+            // cada trabajador cuenta las partes de su etapa; solo los de la
+            // ultima terminan ordenes
+            int s = pipeline_stage_of(&shared_state->config, i);
+            unsigned int items = state_belt(shared_state, i)->stage_items;
+            printf("[Main]   Banda %-3d (%s): %u partes (%.1f/s)", i, shared_state->config.stages[s].name, items,
+                   items / elapsed);
+            if (s + 1 == shared_state->config.num_stages)
+                printf(", %u ordenes terminadas", belt_completed(i));
+            printf("\n");
+        }
+        else if (shared_state->config.threaded_belts)
+            printf("[Main]   Banda %-3d: %u ordenes (%.1f/s), %u robadas\n", i, belt_completed(i),
+                   belt_completed(i) / elapsed, state_belt(shared_state, i)->orders_stolen);
+        else
+            printf("[Main]   Banda %-3d: %u ordenes (%.1f/s)\n", i, belt_completed(i), belt_completed(i) / elapsed);
+    }
+    printf("[Main] Cola: profundidad media %.2f | maxima %u/%d (%lu muestras)\n",
+           samples ? (double)stats->depth_sum / samples : 0.0, (unsigned)stats->depth_max, order_queue_capacity(&shared_state->waiting_orders) + shared_state->config.dispatch_window,
+           (unsigned long)samples);
+
+    static BeltMetrics merged;
+    char summary[96];
+    belt_metrics_merge_all(shared_state, &merged);
+    latency_summary(&merged.queue_wait, summary, sizeof(summary));
+    printf("[Main] Latencia espera en cola: %s\n", summary);
+    latency_summary(&merged.service, summary, sizeof(summary));
+    printf("[Main] Latencia en la banda:    %s\n", summary);
+    latency_summary(&merged.total, summary, sizeof(summary));
+    printf("[Main] Latencia total:          %s\n", summary);
+    print_class_report(&merged);
+
+    // linea compacta para comparar corridas (make bench)
+    printf("RESULTADO bandas=%d ordenes=%lu segundos=%.3f throughput=%.1f cola_media=%.2f cola_max=%u"
+           " total_p50_ns=%lu total_p99_ns=%lu total_p999_ns=%lu ofrecidas=%lu descartadas=%lu lote=%d lote_medio=%.2f\n",
+           shared_state->num_belts, completed, elapsed, completed / elapsed,
+           samples ? (double)stats->depth_sum / samples : 0.0, (unsigned)stats->depth_max,
+           (unsigned long)hist_percentile(&merged.total, 50.0), (unsigned long)hist_percentile(&merged.total, 99.0),
+           (unsigned long)hist_percentile(&merged.total, 99.9), (unsigned long)stats->orders_generated,
+           (unsigned long)stats->orders_dropped, shared_state->config.batch_size, batch_mean);
+}
+
+// deja listo un estado recien creado (en cero): configuracion, ingredientes,
+// inventario, cola y ventana de despacho. lo usan el modo real y la simulacion.
+// recovered: estado recuperado del diario (NULL: cantidades iniciales)
+void init_system_state(SharedSystemState *state, int num_belts, const SystemConfig *config, int initial_stock,
+                       bool locked_inventory, const JournalState *recovered)
+{
+    state->system_running = true;
+    state->num_belts = num_belts;
+    state->config = *config;
+    // sin anillos (modo silencioso o simulacion) no se registra nada
+    state->log.num_rings = state->layout.log_rings;
+    state->log.level = state->log.num_rings > 0 ? config->log_level : LOG_OFF;
+    state->log.start_ns = now_ns();
+    for (int i = 0; i < num_belts; ++i)
+    {
+        atomic_store(&state_belt(state, i)->command, BELT_RUN);
+        ec_init(&state_belt(state, i)->control);
+    }
 
     // definimos los ingredientes iniciales
-    strcpy(shared_state->ingredients[BUN].name, "Pan");
-    shared_state->ingredients[BUN].count = 50;
-    strcpy(shared_state->ingredients[PATTY].name, "Carne");
-    shared_state->ingredients[PATTY].count = 40;
-    strcpy(shared_state->ingredients[LETTUCE].name, "Lechuga");
-    shared_state->ingredients[LETTUCE].count = 100;
-    strcpy(shared_state->ingredients[TOMATO].name, "Tomate");
-    shared_state->ingredients[TOMATO].count = 80;
-    strcpy(shared_state->ingredients[ONION].name, "Cebolla");
-    shared_state->ingredients[ONION].count = 90;
-    strcpy(shared_state->ingredients[CHEESE].name, "Queso");
-    shared_state->ingredients[CHEESE].count = 60;
-
-    // inicializamos mutex y semaforos
-    pthread_mutexattr_t mutex_attr;
-    pthread_mutexattr_init(&mutex_attr);
-    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
-    for (int i = 0; i < MAX_INGREDIENTS; ++i)
-    {
-        if (strlen(shared_state->ingredients[i].name) > 0)
-        {
-            pthread_mutex_init(&shared_state->ingredients[i].mutex, &mutex_attr);
-        }
-    }
-    pthread_mutex_init(&shared_state->waiting_orders.mutex, &mutex_attr);
-    pthread_mutexattr_destroy(&mutex_attr);
-    sem_init(&shared_state->sem_orders_available, 1, 0);
-    sem_init(&shared_state->sem_space_available, 1, MAX_ORDERS_IN_QUEUE);
+    int initial_counts[MAX_INGREDIENTS] = {0};
+    strcpy(state->ingredient_info[BUN].name, "Pan");
+    initial_counts[BUN] = 50;
+    strcpy(state->ingredient_info[PATTY].name, "Carne");
+    initial_counts[PATTY] = 40;
+    strcpy(state->ingredient_info[LETTUCE].name, "Lechuga");
+    initial_counts[LETTUCE] = 100;
+    strcpy(state->ingredient_info[TOMATO].name, "Tomate");
+    initial_counts[TOMATO] = 80;
+    strcpy(state->ingredient_info[ONION].name, "Cebolla");
+    initial_counts[ONION] = 90;
+    strcpy(state->ingredient_info[CHEESE].name, "Queso");
+    initial_counts[CHEESE] = 60;
+    int num_ingredients = CHEESE + 1;
+    if (initial_stock >= 0)
+    {
+        // para benchmarks se puede arrancar con otra cantidad de cada ingrediente
+        for (int i = 0; i < num_ingredients; ++i)
+        {
+            initial_counts[i] = initial_stock;
+        }
+    }
+    if (recovered != NULL)
+    {
+        // las existencias que quedaron al caer, no las de fabrica
+        for (int i = 0; i < num_ingredients; ++i)
+        {
+            initial_counts[i] = recovered->stock[i] > 0 ? (int)recovered->stock[i] : 0;
+        }
+        for (int i = 0; i < num_belts && i < (int)recovered->num_belts; ++i)
+        {
+            state_belt(state, i)->burgers_processed = recovered->completed[i];
+        }
+    }
+
+    // inicializamos el inventario y la cola de ordenes
+    inventory_init(&state->inventory, num_ingredients, initial_counts, locked_inventory);
+    // el segmento tiene las casillas de todos los carriles, una clase por carril
+    OrderSlot *queue_slots = (OrderSlot *)((char *)state + state->layout.queue_slots_offset);
+    int lanes = order_queue_lanes_for(config);
+    order_queue_init(&state->waiting_orders, queue_slots, state->layout.queue_capacity / lanes, lanes);
+    order_queue_set_deadlines(&state->waiting_orders, config->class_deadline_us, config->edf);
+    dispatcher_init(&state->dispatch_window);
+    pipeline_init(state);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_belts = DEFAULT_BELTS;
+    int queue_capacity = DEFAULT_QUEUE_CAPACITY;
+    SystemConfig config = {
+        .headless = false,
+        .log_level = LOG_OFF,
+        .service_time_us = 2000000,
+        .arrival_time_us = -1,
+        .run_seconds = 0,
+        .max_orders = 0,
+        .dispatch_window = 16,
+        .aging_limit = 8,
+        .batch_size = 0,
+        .threaded_belts = false,
+        .journal_records = JOURNAL_DEFAULT_RECORDS,
+        .journal_sync_ms = JOURNAL_DEFAULT_SYNC_MS,
+        .stage_queue_capacity = DEFAULT_STAGE_QUEUE,
+        .class_mix = {100, 0, 0},
+        .class_deadline_us = {DEFAULT_STANDARD_DEADLINE_US, DEFAULT_PREMIUM_DEADLINE_US, DEFAULT_WALKIN_DEADLINE_US},
+        .edf = false,
+        .restock = {.enabled = false, .lead_time_ms = DEFAULT_RESTOCK_LEAD_MS, .batch = DEFAULT_RESTOCK_BATCH},
+        .arrival = {
+            .profile = ARRIVAL_CLASSIC,
+            .rate = 0,
+            .burst_size = 10,
+            .step_rate = 0,
+            .step_seconds = 1,
+            .overflow = OVERFLOW_BACKLOG,
+        },
+    };
+    bool log_level_set = false;
+    bool locked_inventory = false;
+    AutoscaleConfig autoscale = {.min_belts = 1, .max_belts = 0, .target_wait_ns = 0};
+    int target_wait_us = AUTOSCALE_DEFAULT_TARGET_WAIT_US;
+    bool simulate = false;
+    int initial_stock = -1;
+    SegmentOptions segment = {.hugetlb_dir = "", .prefault = false};
+    affinity_init(&config.affinity);
+
+    static const struct option long_options[] = {
+        {"headless", no_argument, NULL, 'H'},
+        {"service-us", required_argument, NULL, 's'},
+        {"arrival-us", required_argument, NULL, 'a'},
+        {"duration", required_argument, NULL, 'd'},
+        {"orders", required_argument, NULL, 'n'},
+        {"stock", required_argument, NULL, 'S'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"log-level", required_argument, NULL, 'l'},
+        {"log", required_argument, NULL, 'G'},
+        {"quiet", no_argument, NULL, 'Q'},
+        {"locked-inventory", no_argument, NULL, 'L'},
+        {"window", required_argument, NULL, 'w'},
+        {"aging", required_argument, NULL, 'g'},
+        {"threads", no_argument, NULL, 'T'},
+        {"pipeline", required_argument, NULL, 'Z'},
+        {"stage-queue", required_argument, NULL, 'e'},
+        {"queue", required_argument, NULL, 'q'},
+        {"classes", required_argument, NULL, 'C'},
+        {"edf", no_argument, NULL, 'D'},
+        {"auto-restock", no_argument, NULL, 'O'},
+        {"restock-lead-ms", required_argument, NULL, 'I'},
+        {"restock-batch", required_argument, NULL, 'V'},
+        {"profile", required_argument, NULL, 'p'},
+        {"rate", required_argument, NULL, 'r'},
+        {"burst", required_argument, NULL, 'b'},
+        {"step-rate", required_argument, NULL, 'R'},
+        {"step-seconds", required_argument, NULL, 'E'},
+        {"overflow", required_argument, NULL, 'o'},
+        {"seed", required_argument, NULL, 'X'},
+        {"record", required_argument, NULL, 'W'},
+        {"replay", required_argument, NULL, 'Y'},
+        {"replay-fast", no_argument, NULL, 'F'},
+        {"simulate", no_argument, NULL, 'M'},
+        {"journal", required_argument, NULL, 'J'},
+        {"journal-records", required_argument, NULL, 'K'},
+        {"journal-sync-ms", required_argument, NULL, 'U'},
+        {"autoscale", no_argument, NULL, 'A'},
+        {"min-belts", required_argument, NULL, 'm'},
+        {"max-belts", required_argument, NULL, 'x'},
+        {"target-wait-us", required_argument, NULL, 'y'},
+        {"batch", required_argument, NULL, 'B'},
+        {"hugepages", optional_argument, NULL, 'P'},
+        {"prefault", no_argument, NULL, 'f'},
+        {"belt-cpus", required_argument, NULL, 'c'},
+        {"generator-cpu", required_argument, NULL, 'k'},
+        {"ui-cpu", required_argument, NULL, 'u'},
+        {"numa-node", required_argument, NULL, 'N'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "Hs:a:d:n:S:vQLw:g:Tq:p:r:b:o:h", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'H': config.headless = true; break;
+        case 's': config.service_time_us = parse_count(optarg, "--service-us"); break;
+        case 'a': config.arrival_time_us = parse_count(optarg, "--arrival-us"); break;
+        case 'd': config.run_seconds = parse_count(optarg, "--duration"); break;
+        case 'n': config.max_orders = parse_count(optarg, "--orders"); break;
+        case 'S': initial_stock = parse_count(optarg, "--stock"); break;
+        case 'v': config.log_level = LOG_DEBUG; log_level_set = true; break;
+        case 'Q': config.log_level = LOG_OFF; log_level_set = true; break;
+        case 'l':
+            if (!log_parse_level(optarg, &config.log_level))
+            {
+                fprintf(stderr, "Error: nivel de registro desconocido: '%s'.\n", optarg);
+                return 1;
+            }
+            log_level_set = true;
+            break;
+        case 'G': copy_path(config.log_path, sizeof(config.log_path), optarg, "--log"); break;
+        case 'L': locked_inventory = true; break;
+        case 'w': config.dispatch_window = parse_count(optarg, "--window"); break;
+        case 'g': config.aging_limit = parse_count(optarg, "--aging"); break;
+        case 'T': config.threaded_belts = true; break;
+        case 'Z':
+            if (!pipeline_parse(optarg, &config))
+            {
+                fprintf(stderr, "Error: etapas invalidas en --pipeline: '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'e': config.stage_queue_capacity = parse_count(optarg, "--stage-queue"); break;
+        case 'q': queue_capacity = parse_count(optarg, "--queue"); break;
+        case 'C':
+            if (!parse_classes(optarg, &config))
+            {
+                fprintf(stderr, "Error: clases invalidas en --classes: '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'D': config.edf = true; break;
+        case 'O': config.restock.enabled = true; break;
+        case 'I': config.restock.lead_time_ms = parse_count(optarg, "--restock-lead-ms"); break;
+        case 'V': config.restock.batch = parse_count(optarg, "--restock-batch"); break;
+        case 'p':
+            if (!arrival_parse_profile(optarg, &config.arrival.profile))
+            {
+                fprintf(stderr, "Error: perfil de llegadas desconocido: '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r': config.arrival.rate = parse_rate(optarg, "--rate"); break;
+        case 'b': config.arrival.burst_size = parse_count(optarg, "--burst"); break;
+        case 'R': config.arrival.step_rate = parse_rate(optarg, "--step-rate"); break;
+        case 'E': config.arrival.step_seconds = parse_count(optarg, "--step-seconds"); break;
+        case 'X': config.seed = parse_seed(optarg, "--seed"); break;
+        case 'W': copy_path(config.record_path, sizeof(config.record_path), optarg, "--record"); break;
+        case 'Y': copy_path(config.replay_path, sizeof(config.replay_path), optarg, "--replay"); break;
+        case 'F': config.replay_fast = true; break;
+        case 'M': simulate = true; break;
+        case 'J': copy_path(config.journal_path, sizeof(config.journal_path), optarg, "--journal"); break;
+        case 'K': config.journal_records = parse_count(optarg, "--journal-records"); break;
+        case 'U': config.journal_sync_ms = parse_count(optarg, "--journal-sync-ms"); break;
+        case 'A': autoscale_enabled = true; break;
+        case 'm': autoscale.min_belts = parse_count(optarg, "--min-belts"); break;
+        case 'x': autoscale.max_belts = parse_count(optarg, "--max-belts"); break;
+        case 'y': target_wait_us = parse_count(optarg, "--target-wait-us"); break;
+        case 'B': config.batch_size = parse_count(optarg, "--batch"); break;
+        case 'P':
+            copy_path(segment.hugetlb_dir, sizeof(segment.hugetlb_dir), optarg ? optarg : DEFAULT_HUGETLB_DIR,
+                      "--hugepages");
+            break;
+        case 'f': segment.prefault = true; break;
+        case 'c':
+            if (!affinity_parse_list(optarg, config.affinity.belt_cpus, &config.affinity.belt_cpu_count))
+            {
+                fprintf(stderr, "Error: lista de cpus invalida en --belt-cpus: '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k': config.affinity.generator_cpu = parse_count(optarg, "--generator-cpu"); break;
+        case 'u': config.affinity.ui_cpu = parse_count(optarg, "--ui-cpu"); break;
+        case 'N': config.affinity.numa_node = parse_count(optarg, "--numa-node"); break;
+        case 'o':
+            if (strcmp(optarg, "drop") == 0)
+                config.arrival.overflow = OVERFLOW_DROP;
+            else if (strcmp(optarg, "backlog") == 0)
+                config.arrival.overflow = OVERFLOW_BACKLOG;
+            else
+            {
+                fprintf(stderr, "Error: politica de cola llena desconocida: '%s'.\n", optarg);
+                return 1;
+            }
+            break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    // con interfaz se registra cada evento, pero en un archivo: la salida
+    // estandar es de ncurses
+    if (!log_level_set)
+    {
+        config.log_level = config.headless ? LOG_INFO : LOG_DEBUG;
+    }
+    if (config.log_path[0] == '\0')
+    {
+        strcpy(config.log_path, config.headless ? "-" : "burger_machine.log");
+    }
+
+    if (config.dispatch_window < 1 || config.dispatch_window > MAX_DISPATCH_WINDOW)
+    {
+        fprintf(stderr, "Error: La ventana de despacho debe estar entre 1 y %d.\n", MAX_DISPATCH_WINDOW);
+        return 1;
+    }
+
+    // la simulacion tiene una orden por banda y ninguna deque que robar
+    if (simulate && (config.threaded_belts || config.batch_size != 0))
+    {
+        fprintf(stderr, "Error: --threads y --batch no se pueden usar con --simulate.\n");
+        return 1;
+    }
+
+    // sin --batch las bandas proceso toman de a una y los hilos llenan su
+    // deque de a lotes pequenos
+    if (config.batch_size == 0)
+    {
+        config.batch_size = config.threaded_belts ? 4 : 1;
+    }
+    if (config.batch_size > config.dispatch_window)
+    {
+        config.batch_size = config.dispatch_window;
+    }
+
+    if (config.replay_fast && config.replay_path[0] == '\0')
+    {
+        fprintf(stderr, "Error: --replay-fast necesita --replay.\n");
+        return 1;
+    }
+    if (config.replay_path[0] != '\0')
+    {
+        // validamos la traza antes de crear los procesos; sin otro limite,
+        // la corrida termina cuando se completan todas sus ordenes
+        TraceReader trace;
+        if (!trace_reader_open(&trace, config.replay_path))
+        {
+            return 1;
+        }
+        if (config.max_orders == 0 || config.max_orders > trace.count)
+        {
+            config.max_orders = trace.count;
+        }
+        trace_reader_close(&trace);
+    }
+    if (config.arrival.profile != ARRIVAL_CLASSIC && config.arrival.rate <= 0 && config.replay_path[0] == '\0')
+    {
+        fprintf(stderr, "Error: el perfil '%s' necesita una tasa (--rate).\n", arrival_profile_name(config.arrival.profile));
+        return 1;
+    }
+    if (config.arrival.burst_size < 1)
+    {
+        config.arrival.burst_size = 1;
+    }
+    if (config.journal_path[0] != '\0' && simulate)
+    {
+        fprintf(stderr, "Error: --journal no se puede usar con --simulate.\n");
+        return 1;
+    }
+    if (config.journal_records < 1024)
+    {
+        config.journal_records = 1024;
+    }
+
+    if (optind < argc)
+    {
+        num_belts = atoi(argv[optind]);
+        if (num_belts <= 0 || num_belts > BELT_LIMIT)
+        {
+            fprintf(stderr, "Error: El numero de bandas debe estar entre 1 y %d.\n", BELT_LIMIT);
+            return 1;
+        }
+    }
+    if (queue_capacity < 1 || (unsigned)queue_capacity > QUEUE_CAPACITY_LIMIT)
+    {
+        fprintf(stderr, "Error: La capacidad de la cola debe estar entre 1 y %u.\n", QUEUE_CAPACITY_LIMIT);
+        return 1;
+    }
+    if (config.restock.batch < 1)
+    {
+        fprintf(stderr, "Error: --restock-batch debe ser al menos 1.\n");
+        return 1;
+    }
+    // en pipeline las bandas son los trabajadores de las etapas
+    if (config.num_stages > 0)
+    {
+        if (config.threaded_belts || autoscale_enabled || simulate)
+        {
+            fprintf(stderr, "Error: --pipeline no se puede usar con --threads, --autoscale ni --simulate.\n");
+            return 1;
+        }
+        if (config.stage_queue_capacity < 1 || config.stage_queue_capacity > STAGE_QUEUE_LIMIT)
+        {
+            fprintf(stderr, "Error: --stage-queue debe estar entre 1 y %d.\n", STAGE_QUEUE_LIMIT);
+            return 1;
+        }
+        num_belts = pipeline_workers(&config);
+        if (num_belts > BELT_LIMIT)
+        {
+            fprintf(stderr, "Error: El numero de trabajadores debe estar entre 1 y %d.\n", BELT_LIMIT);
+            return 1;
+        }
+        pipeline_resolve(&config);
+    }
+    // con autoescalado el segmento tiene lugar para max_belts bandas y
+    // arrancan activas las pedidas; las demas casillas quedan retiradas
+    int initial_belts = num_belts;
+    if (autoscale_enabled)
+    {
+        if (config.threaded_belts || simulate)
+        {
+            fprintf(stderr, "Error: --autoscale necesita bandas proceso (sin --threads ni --simulate).\n");
+            return 1;
+        }
+        if (autoscale.max_belts == 0)
+        {
+            autoscale.max_belts = num_belts * 4 < BELT_LIMIT ? num_belts * 4 : BELT_LIMIT;
+        }
+        if (autoscale.min_belts < 1 || autoscale.min_belts > autoscale.max_belts || autoscale.max_belts > BELT_LIMIT)
+        {
+            fprintf(stderr, "Error: Se necesita 1 <= --min-belts <= --max-belts <= %d.\n", BELT_LIMIT);
+            return 1;
+        }
+        autoscale.target_wait_ns = (uint64_t)target_wait_us * 1000;
+        initial_belts = num_belts < autoscale.min_belts ? autoscale.min_belts
+                      : num_belts > autoscale.max_belts ? autoscale.max_belts : num_belts;
+        num_belts = autoscale.max_belts;
+        printf("[Main] Iniciando sistema con %d bandas de preparacion (autoescalado entre %d y %d).\n", initial_belts,
+               autoscale.min_belts, autoscale.max_belts);
+    }
+    else if (config.num_stages > 0)
+    {
+        printf("[Main] Iniciando sistema con un pipeline de %d etapas:", config.num_stages);
+        for (int s = 0; s < config.num_stages; s++)
+        {
+            printf("%s %s (%d x %d us)", s ? " ->" : "", config.stages[s].name, config.stages[s].workers,
+                   config.stages[s].service_time_us);
+        }
+        printf(".\n");
+    }
+    else
+    {
+        printf("[Main] Iniciando sistema con %d bandas de preparacion.\n", num_belts);
+    }
+
+    if (simulate)
+    {
+        // sin limite la simulacion no termina, y sin tiempo de servicio el
+        // reloj virtual no avanzaria
+        if (config.run_seconds == 0 && config.max_orders == 0)
+        {
+            fprintf(stderr, "Error: --simulate necesita --duration, --orders o --replay.\n");
+            return 1;
+        }
+        if (config.service_time_us == 0)
+        {
+            fprintf(stderr, "Error: --simulate necesita --service-us mayor que 0.\n");
+            return 1;
+        }
+        // todo el estado vive en memoria privada de este proceso
+        config.headless = true;
+        shared_state = state_create_private(num_belts, queue_capacity * order_queue_lanes_for(&config));
+        if (shared_state == NULL)
+        {
+            exit(1);
+        }
+        init_system_state(shared_state, num_belts, &config, initial_stock, locked_inventory, NULL);
+        printf("[Main] Modo simulacion: servicio %d us, llegadas %s.\n", config.service_time_us,
+               config.replay_path[0] != '\0' ? config.replay_path : arrival_profile_name(config.arrival.profile));
+        double elapsed = simulation_run(shared_state);
+        print_report(elapsed);
+        inventory_destroy(&shared_state->inventory);
+        shm_detach(shared_state);
+        shared_state = NULL;
+        return 0;
+    }
+
+    // con diario, antes de crear nada recuperamos lo que dejo la corrida anterior
+    JournalState recovered;
+    BurgerOrder *pending = NULL;
+    size_t pending_count = 0;
+    int journal_status = 0;
+    if (config.journal_path[0] != '\0')
+    {
+        uint64_t t0 = now_ns();
+        journal_status = journal_recover(config.journal_path, &recovered);
+        if (journal_status < 0)
+        {
+            exit(1);
+        }
+        if (journal_status == 1)
+        {
+            pending_count = journal_state_requeue(&recovered, &pending);
+            // la cola tiene que poder recibir todas las ordenes pendientes
+            if (pending_count > (size_t)queue_capacity)
+            {
+                queue_capacity = pending_count;
+            }
+            unsigned long done = 0;
+            for (uint32_t i = 0; i < recovered.num_belts; i++)
+            {
+                done += recovered.completed[i];
+            }
+            printf("[Main] Recuperacion: %zu ordenes pendientes, %lu completadas, en %.1f ms.\n", pending_count, done,
+                   (now_ns() - t0) / 1e6);
+        }
+    }
+
+    // con --numa-node el padre pasa a las cpus del nodo antes de crear el
+    // segmento: lo pone en cero el, asi cada pagina se asigna en ese nodo, y
+    // todos los hijos heredan la mascara (las opciones por proceso la achican)
+    if (config.affinity.numa_node >= 0)
+    {
+        uint64_t node_cpus[AFFINITY_WORDS];
+        int node_cpu_count;
+        if (!affinity_node_cpus(config.affinity.numa_node, node_cpus, &node_cpu_count) ||
+            !affinity_pin_mask(node_cpus))
+        {
+            fprintf(stderr, "Error: no se pudo usar el nodo numa %d.\n", config.affinity.numa_node);
+            exit(1);
+        }
+        printf("[Main] Nodo numa %d: %d cpus.\n", config.affinity.numa_node, node_cpu_count);
+    }
+    shm_set_options(&segment);
+
+    // preparamos la memoria compartida, dimensionada para estas bandas y esta cola
+    // un anillo de registro por banda y otro para el generador
+    uint32_t log_rings = config.log_level != LOG_OFF ? num_belts + 1 : 0;
+    shared_state = shm_create(SHM_NAME, num_belts, queue_capacity * order_queue_lanes_for(&config), log_rings);
+    if (shared_state == NULL)
+    {
+        exit(1);
+    }
+    printf("[Main] Memoria compartida creada y mapeada correctamente (%zu bytes, paginas de %zu KiB%s).\n",
+           shared_state->layout.total_size, shm_page_size() / 1024, segment.prefault ? ", prepoblada" : "");
+
+    // inicializamos el estado del sistema (shm_create ya lo dejo en cero)
+    printf("[Main] Inicializando estado del sistema y primitivas de sincronizacion...\n");
+    init_system_state(shared_state, num_belts, &config, initial_stock, locked_inventory,
+                      journal_status == 1 ? &recovered : NULL);
+    if (journal_status == 1)
+    {
+        for (int i = 0; i < num_belts; i++)
+        {
+            completed_at_start[i] = state_belt(shared_state, i)->burgers_processed;
+        }
+        recovered_pending = pending_count;
+        uint64_t now = now_ns();
+        for (size_t i = 0; i < pending_count; i++)
+        {
+            pending[i].enqueued_ns = now;
+            order_queue_try_push(&shared_state->waiting_orders, &pending[i]);
+        }
+        free(pending);
+        shared_state->order_id_base = recovered.max_order_id;
+    }
+    if (config.journal_path[0] != '\0')
+    {
+        // los hijos heredan el mapeo del diario con fork
+        if (!journal_create(config.journal_path, config.journal_records, shared_state,
+                            journal_status == 1 ? &recovered : NULL))
+        {
+            exit(1);
+        }
+    }
+
+    // segmento de solo lectura para burger_stat; sin el la corrida sigue igual
+    stats_segment = stats_segment_create(num_belts, shared_state->inventory.num_ingredients);
+    if (stats_segment != NULL)
+    {
+        stats_segment->start_ns = now_ns();
+        for (int i = 0; i < MAX_INGREDIENTS; i++)
+        {
+            memcpy(stats_segment->ingredient_names[i], shared_state->ingredient_info[i].name, sizeof(stats_segment->ingredient_names[i]));
+        }
+        stats_segment->num_stages = config.num_stages;
+        stats_segment->num_classes = shared_state->waiting_orders.num_lanes;
+        stats_segment->edf = config.edf;
+        stats_segment->auto_restock = config.restock.enabled;
+        for (int c = 0; c < ORDER_CLASSES; c++)
+        {
+            snprintf(stats_segment->class_names[c], sizeof(stats_segment->class_names[c]), "%s", order_class_name(c));
+            stats_segment->classes[c].deadline_us = config.class_deadline_us[c];
+        }
+        for (int s = 0; s < config.num_stages; s++)
+        {
+            memcpy(stats_segment->stages[s].name, config.stages[s].name, sizeof(stats_segment->stages[s].name));
+            stats_segment->stages[s].workers = config.stages[s].workers;
+        }
+        publish_stats(false);
+    }
 
     // registramos el manejador de senales
     signal(SIGINT, signal_handler);
 
     // creamos todos los procesos hijos
     printf("[Main] Creando procesos hijos...\n");
-    int total_child_processes = num_belts + 2;
+    // vaciamos stdout para que los hijos no hereden (y repitan) lo pendiente
+    fflush(stdout);
+    // en modo con hilos o pipeline todas las bandas viven en un solo proceso hijo
+    int belt_processes = config.threaded_belts || config.num_stages > 0 ? 1 : num_belts;
+    int total_child_processes = belt_processes + (config.headless ? 1 : 2);
     pid_t pids[total_child_processes];
-    for (int i = 0; i < num_belts; ++i)
+    // el registrador arranca primero y termina ultimo, cuando ya no queda
+    // nadie que escriba en los anillos
+    pid_t logger_pid = -1;
+    if (shared_state->log.num_rings > 0)
     {
-        pids[i] = fork();
-        if (pids[i] < 0)
+        logger_pid = fork();
+        if (logger_pid < 0)
         {
-            perror("fork para banda");
+            perror("fork para registrador");
             exit(1);
         }
-        if (pids[i] == 0)
+        if (logger_pid == 0)
         {
-            start_belt_process(i, SHM_NAME);
+            start_logger_process(SHM_NAME);
             exit(0);
         }
-        else
+        if (!config.headless)
+        {
+            printf("[Main] Registro de eventos en %s (nivel %s).\n", config.log_path, log_level_name(config.log_level));
+        }
+    }
+    for (int i = 0; i < belt_processes; ++i)
+    {
+        // casillas de autoescalado sin banda todavia
+        if (i >= initial_belts)
+        {
+            PreparationBelt *belt = state_belt(shared_state, i);
+            atomic_store(&belt->command, BELT_DRAIN);
+            belt_set_state(belt, DRAINED, 0);
+            pids[i] = 0;
+            continue;
+        }
+        pids[i] = spawn_belts(i);
+        if (pids[i] < 0)
         {
-            shared_state->belts[i].pid = pids[i];
+            exit(1);
         }
     }
-    pids[num_belts] = fork();
-    if (pids[num_belts] < 0)
+    if (autoscale_enabled)
+    {
+        autoscaler_init(&autoscaler, &autoscale, initial_belts, now_ns());
+        autoscale_prev_ns = now_ns();
+    }
+    pids[belt_processes] = fork();
+    if (pids[belt_processes] < 0)
     {
         perror("fork para generador");
         exit(1);
     }
-    if (pids[num_belts] == 0)
+    if (pids[belt_processes] == 0)
     {
         start_order_generator_process(SHM_NAME);
         exit(0);
     }
-    pids[num_belts + 1] = fork();
-    if (pids[num_belts + 1] < 0)
+    pid_t restock_pid = -1;
+    if (config.restock.enabled)
     {
-        perror("fork para ui/control");
-        exit(1);
+        restock_pid = fork();
+        if (restock_pid < 0)
+        {
+            perror("fork para reposicion");
+            exit(1);
+        }
+        if (restock_pid == 0)
+        {
+            start_restock_process(SHM_NAME);
+            exit(0);
+        }
     }
-    if (pids[num_belts + 1] == 0)
+    if (!config.headless)
     {
-        start_ui_control_process(SHM_NAME);
-        exit(0);
+        pids[belt_processes + 1] = fork();
+        if (pids[belt_processes + 1] < 0)
+        {
+            perror("fork para ui/control");
+            exit(1);
+        }
+        if (pids[belt_processes + 1] == 0)
+        {
+            start_ui_control_process(SHM_NAME);
+            exit(0);
+        }
     }
     printf("[Main] Todos los procesos han sido creados. El sistema esta operativo.\n");
-    printf("[Main] La interfaz de control esta activa en esta terminal.\n");
+    if (config.headless)
+    {
+        if (config.num_stages > 0)
+        {
+            printf("[Main] Modo sin interfaz: etapas");
+            for (int s = 0; s < config.num_stages; s++)
+                printf("%s %s:%d:%d", s ? "," : "", config.stages[s].name, config.stages[s].workers,
+                       config.stages[s].service_time_us);
+            printf(", llegadas %d us.\n", config.arrival_time_us);
+        }
+        else
+            printf("[Main] Modo sin interfaz: servicio %d us, llegadas %d us.\n", config.service_time_us,
+                   config.arrival_time_us);
+    }
+    else
+    {
+        printf("[Main] La interfaz de control esta activa en esta terminal.\n");
+    }
+    double elapsed = monitor_run(pids, belt_processes);
     
     // el proceso padre se queda esperando a que terminen los hijos
     printf("[Main] Esperando la terminacion de los procesos hijos (Ctrl+C para salir)...\n");
+    // mientras tanto el diario sigue su commit en grupo: los hijos pueden
+    // estar esperando lugar en el anillo para sus ultimos registros
     for (int i = 0; i < total_child_processes; ++i)
     {
-        wait(NULL);
+        // 0: banda ya recogida por el supervisor
+        while (pids[i] > 0 && waitpid(pids[i], NULL, config.journal_path[0] != '\0' ? WNOHANG : 0) == 0)
+        {
+            journal_tick(config.journal_sync_ms, false);
+            sleep_us(10000);
+        }
+    }
+    // la reposicion sale en su proxima vuelta (puede estar anotando un pedido)
+    while (restock_pid > 0 && waitpid(restock_pid, NULL, WNOHANG) == 0)
+    {
+        journal_tick(config.journal_sync_ms, false);
+        sleep_us(10000);
+    }
+    journal_tick(config.journal_sync_ms, true);
+    journal_close();
+    if (logger_pid > 0)
+    {
+        shared_state->log.stop = true;
+        waitpid(logger_pid, NULL, 0);
+    }
+    // ultima foto: burger_stat ve la corrida terminada con los totales finales
+    publish_stats(true);
+
+    if (config.headless)
+    {
+        print_report(elapsed);
     }
     
     // una vez que todos terminan, limpiamos
@@ -6,97 +6,361 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <time.h> 
+#include <time.h>
 
 #include "shared_data.h"
+#include "order_queue.h"
+#include "dispatcher.h"
+#include "clock_utils.h"
+#include "arrival.h"
+#include "trace.h"
+#include "journal.h"
+
+// ordenes que el generador puede guardar cuando la cola esta llena
+// (politica backlog). si tambien se llena, las que sobran se descartan
+#define BACKLOG_CAPACITY 65536
 
 // puntero a la estructura de estado compartida
 static SharedSystemState *shared_state = NULL;
 
+// estado del generador pseudoaleatorio de este proceso
+static uint64_t rng_state;
 
+// espera local de ordenes que llegaron con la cola llena (anillo simple,
+// solo lo usa este proceso)
+static BurgerOrder *backlog = NULL;
+static unsigned int backlog_head = 0;
+static unsigned int backlog_count = 0;
 
-void start_order_generator_process(const char *shm_name)
+// grabacion y reproduccion de trazas
+static TraceWriter recorder;
+static bool recording = false;
+static uint64_t record_start_ns;
+static TraceReader replay;
+static bool replaying = false;
+static uint64_t replay_next = 0;
+
+// siguiente orden de la traza que se reproduce (false si ya no quedan)
+static bool next_replayed_order(BurgerOrder *order, uint64_t *arrival_offset_ns)
 {
-    // --- 1. conectarse a la memoria compartida ---
-    int shm_fd = shm_open(shm_name, O_RDWR, 0666);
-    if (shm_fd == -1)
+    if (replay_next >= replay.count)
+        return false;
+    const TraceRecord *rec = &replay.records[replay_next++];
+    trace_record_to_order(rec, order);
+    *arrival_offset_ns = rec->arrival_offset_ns;
+    return true;
+}
+
+// graba la orden (si se pidio) con su llegada relativa al inicio
+static void record_order(const BurgerOrder *order)
+{
+    if (recording && !trace_writer_append(&recorder, order, order->enqueued_ns - record_start_ns))
     {
-        perror("shm_open (generator)");
-        exit(1);
+        perror("fwrite (traza)");
+        trace_writer_close(&recorder);
+        recording = false;
     }
+}
 
-    // mapeamos la memoria compartida a nuestro espacio de direcciones
-    shared_state = mmap(NULL, sizeof(SharedSystemState), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_state == MAP_FAILED)
+// muestrea la profundidad de la cola en cada llegada
+static int record_arrival(unsigned int order_counter)
+{
+    RunStats *stats = &shared_state->stats;
+    int depth = dispatcher_pending(shared_state);
+    seqlock_write_begin(&stats->seq);
+    atomic_store_explicit(&stats->orders_generated, order_counter, memory_order_relaxed);
+    atomic_store_explicit(&stats->depth_samples, stats->depth_samples + 1, memory_order_relaxed);
+    atomic_store_explicit(&stats->depth_sum, stats->depth_sum + depth, memory_order_relaxed);
+    if ((uint32_t)depth > stats->depth_max)
     {
-        perror("mmap (generator)");
-        exit(1);
+        atomic_store_explicit(&stats->depth_max, depth, memory_order_relaxed);
     }
-    close(shm_fd); // ya no necesitamos el descriptor
+    seqlock_write_end(&stats->seq);
+    return depth;
+}
 
-    // inicializamos la semilla para el generador de numeros aleatorios
-    // usamos el pid para que cada proceso generador (si hubiera mas) tenga una semilla diferente
-    srand(time(NULL) ^ getpid());
+// lazo cerrado (comportamiento original): espera entre ordenes y, si la cola
+// esta llena, se bloquea hasta que una banda libere una casilla. tambien
+// reproduce trazas lo mas rapido posible (sin esperas entre ordenes)
+static void run_closed_loop()
+{
+    const SystemConfig *config = &shared_state->config;
+    unsigned int order_counter = 0;
 
-    printf("[Generator, PID %d] Conectado y listo para crear ordenes.\n", getpid());
+    while (shared_state->system_running)
+    {
+        // en modo benchmark se puede pedir un numero fijo de ordenes
+        if (config->max_orders > 0 && order_counter >= config->max_orders)
+        {
+            break;
+        }
+
+        BurgerOrder new_order;
+        if (replaying)
+        {
+            uint64_t offset;
+            if (!next_replayed_order(&new_order, &offset))
+            {
+                break;
+            }
+            ++order_counter;
+        }
+        else
+        {
+            // esperamos un tiempo para simular la llegada de clientes
+            // (aleatorio entre 1 y 3 segundos salvo que se configure otro)
+            if (config->arrival_time_us < 0)
+            {
+                sleep((rng_next(&rng_state) % 3) + 1);
+            }
+            else
+            {
+                sleep_us(config->arrival_time_us);
+            }
 
+            // creamos una nueva orden
+            order_build_random(&new_order, shared_state->order_id_base + ++order_counter, &rng_state);
+            order_assign_class(&new_order, config, &rng_state);
+        }
+        new_order.enqueued_ns = now_ns();
+        record_order(&new_order);
+        journal_append(JR_ENQUEUE, &new_order, 0);
+
+        // anadimos la orden a la cola sin bloqueos. si la cola esta llena,
+        // este proceso duerme hasta que una banda libere una casilla
+        // (la propia cola despierta a una banda que este esperando)
+        if (!order_queue_push(&shared_state->waiting_orders, &new_order, &shared_state->system_running))
+        {
+            // nos despertaron porque el sistema se esta apagando: la orden
+            // nunca entro
+            journal_append(JR_DROP, &new_order, 0);
+            break;
+        }
+
+        int depth = record_arrival(order_counter);
+        log_event(shared_state, LOG_GENERATOR, LOG_DEBUG, LOG_EV_ORDER_CREATED, new_order.order_id, depth);
+    }
+}
+
+// pasa a la cola las ordenes de la espera local, en orden de llegada
+static void flush_backlog()
+{
+    unsigned int before = backlog_count;
+    while (backlog_count > 0 && order_queue_try_push(&shared_state->waiting_orders, &backlog[backlog_head]))
+    {
+        backlog_head = (backlog_head + 1) % BACKLOG_CAPACITY;
+        backlog_count--;
+    }
+    if (backlog_count != before)
+    {
+        RunStats *stats = &shared_state->stats;
+        seqlock_write_begin(&stats->seq);
+        atomic_store_explicit(&stats->backlog_depth, backlog_count, memory_order_relaxed);
+        seqlock_write_end(&stats->seq);
+    }
+}
+
+// una orden llego con la cola llena: se guarda o se descarta segun la politica
+static void handle_overflow(const BurgerOrder *order)
+{
+    RunStats *stats = &shared_state->stats;
+    if (shared_state->config.arrival.overflow == OVERFLOW_DROP || backlog_count == BACKLOG_CAPACITY)
+    {
+        seqlock_write_begin(&stats->seq);
+        atomic_store_explicit(&stats->orders_dropped, stats->orders_dropped + 1, memory_order_relaxed);
+        seqlock_write_end(&stats->seq);
+        log_event(shared_state, LOG_GENERATOR, LOG_DEBUG, LOG_EV_ORDER_DROPPED, order->order_id, 0);
+        journal_append(JR_DROP, order, 0);
+        return;
+    }
+    backlog[(backlog_head + backlog_count) % BACKLOG_CAPACITY] = *order;
+    backlog_count++;
+    seqlock_write_begin(&stats->seq);
+    atomic_store_explicit(&stats->orders_backlogged, stats->orders_backlogged + 1, memory_order_relaxed);
+    atomic_store_explicit(&stats->backlog_depth, backlog_count, memory_order_relaxed);
+    if (backlog_count > stats->backlog_max)
+    {
+        atomic_store_explicit(&stats->backlog_max, backlog_count, memory_order_relaxed);
+    }
+    seqlock_write_end(&stats->seq);
+}
+
+// lazo abierto: las ordenes llegan segun el reloj del perfil elegido, sin
+// importar si la cola tiene lugar. el horario es absoluto (no se acumula el
+// error de cada espera) y, si el generador se atrasa, emite de una vez todas
+// las llegadas vencidas. la hora de encolado es la hora de llegada prevista,
+// asi la latencia incluye lo que la orden espero por una cola llena.
+// al reproducir una traza en tiempo real, las llegadas son las grabadas
+static void run_open_loop()
+{
+    const SystemConfig *config = &shared_state->config;
+    OrderQueue *q = &shared_state->waiting_orders;
     unsigned int order_counter = 0;
 
-    // --- 2. bucle principal de generacion ---
-    while (shared_state->system_running)
+    backlog = malloc(sizeof(BurgerOrder) * BACKLOG_CAPACITY);
+    if (backlog == NULL)
     {
-        // esperamos un tiempo aleatorio para simular la llegada de clientes
-        sleep((rand() % 3) + 1); 
+        perror("malloc (backlog)");
+        exit(1);
+    }
 
-        // esperamos a que haya espacio disponible en la cola de ordenes
-        // si la cola esta llena, este proceso se quedara bloqueado aqui
-        sem_wait(&shared_state->sem_space_available);
+    ArrivalClock clock;
+    uint64_t start_ns = now_ns();
+    record_start_ns = start_ns;
+    arrival_clock_init(&clock, &config->arrival, start_ns, rng_next(&rng_state));
 
-        // al despertar, verificamos si es porque el sistema se esta apagando
-        if (!shared_state->system_running)
+    while (shared_state->system_running)
+    {
+        bool arrivals_done = (config->max_orders > 0 && order_counter >= config->max_orders) ||
+                             (replaying && replay_next >= replay.count);
+        if (arrivals_done && backlog_count == 0)
         {
             break;
         }
+        flush_backlog();
+
+        uint64_t due = replaying && !arrivals_done ? start_ns + replay.records[replay_next].arrival_offset_ns
+                                                   : arrival_clock_peek(&clock);
+        uint64_t now = now_ns();
+        if (arrivals_done || due > now)
+        {
+            if (backlog_count == 0)
+            {
+                // a tasas bajas no dormimos mas de 100 ms seguidos para ver el apagado
+                sleep_until_ns(due - now > 100000000 ? now + 100000000 : due);
+                continue;
+            }
+            // hay ordenes esperando lugar: dormimos hasta que se libere una
+            // casilla o hasta la proxima llegada, lo que pase primero
+            uint64_t timeout = arrivals_done ? 1000000 : due - now;
+            uint32_t key = ec_prepare_wait(&q->not_full);
+            if (order_queue_has_room(q, &backlog[backlog_head]) || !shared_state->system_running)
+            {
+                ec_cancel_wait(&q->not_full);
+                continue;
+            }
+            ec_wait_timeout(&q->not_full, key, timeout);
+            continue;
+        }
 
-        // creamos una nueva orden
         BurgerOrder new_order;
-        new_order.order_id = ++order_counter;
-        // ingredientes base que toda hamburguesa lleva
-        new_order.ingredients_needed[BUN] = 2;
-        new_order.ingredients_needed[PATTY] = 1;
-
-        // ingredientes opcionales, se anaden con cierta probabilidad
-        new_order.ingredients_needed[LETTUCE] = (rand() % 100 < 80) ? 1 : 0; 
-        new_order.ingredients_needed[TOMATO] = (rand() % 100 < 70) ? 1 : 0; 
-        new_order.ingredients_needed[ONION] = (rand() % 100 < 60) ? 1 : 0;  
-        new_order.ingredients_needed[CHEESE] = (rand() % 100 < 90) ? 1 : 0;  
-
-        // nos aseguramos de que los demas ingredientes esten en cero
-        for (int i = CHEESE + 1; i < MAX_INGREDIENTS; i++)
+        if (replaying)
         {
-            new_order.ingredients_needed[i] = 0;
+            uint64_t offset = 0;
+            next_replayed_order(&new_order, &offset);
+            ++order_counter;
+            new_order.enqueued_ns = start_ns + offset;
         }
-    
-        // bloqueamos el mutex para poder modificar la cola de ordenes de forma segura
-        pthread_mutex_lock(&shared_state->waiting_orders.mutex);
+        else
+        {
+            order_build_random(&new_order, shared_state->order_id_base + ++order_counter, &rng_state);
+            order_assign_class(&new_order, config, &rng_state);
+            new_order.enqueued_ns = arrival_clock_advance(&clock);
+        }
+        record_order(&new_order);
+        // la espera local tambien cuenta como aceptada: si la corrida cae,
+        // esas ordenes vuelven a la cola al retomarla
+        journal_append(JR_ENQUEUE, &new_order, 0);
 
-        // anadimos la nueva orden al final de la cola (en la posicion 'tail')
-        int tail_pos = shared_state->waiting_orders.tail;
-        shared_state->waiting_orders.orders[tail_pos] = new_order;
-        // movemos el puntero 'tail' a la siguiente posicion, de forma circular
-        shared_state->waiting_orders.tail = (tail_pos + 1) % MAX_ORDERS_IN_QUEUE;
-        shared_state->waiting_orders.count++;
+        // las ordenes en espera local llegaron antes: no se las adelanta
+        if (backlog_count > 0 || !order_queue_try_push(q, &new_order))
+        {
+            handle_overflow(&new_order);
+        }
 
-        printf("[Generator] Nueva orden #%u creada. Total en cola: %d\n", new_order.order_id, shared_state->waiting_orders.count);
+        int depth = record_arrival(order_counter);
+        log_event(shared_state, LOG_GENERATOR, LOG_DEBUG, LOG_EV_ORDER_CREATED, new_order.order_id, depth);
+    }
 
-        // liberamos el mutex para que otros procesos puedan acceder a la cola
-        pthread_mutex_unlock(&shared_state->waiting_orders.mutex);
+    free(backlog);
+    backlog = NULL;
+}
 
-        // incrementamos el semaforo de ordenes disponibles para 'despertar' a una banda
-        sem_post(&shared_state->sem_orders_available);
+void start_order_generator_process(const char *shm_name)
+{
+    // --- 1. conectarse a la memoria compartida ---
+    // el tamano del segmento se lee de su cabecera
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL)
+    {
+        exit(1);
+    }
+
+    const SystemConfig *config = &shared_state->config;
+    if (config->affinity.generator_cpu >= 0)
+    {
+        affinity_pin_cpu(config->affinity.generator_cpu);
+    }
+
+    // inicializamos la semilla para el generador de numeros aleatorios
+    // sin semilla fija usamos la hora y el pid, asi cada corrida es distinta
+    if (config->seed != 0)
+    {
+        rng_state = config->seed;
+    }
+    else
+    {
+        rng_state = ((uint64_t)time(NULL) << 20) ^ (uint64_t)getpid() ^ 0x9E3779B97F4A7C15ull;
+    }
+
+    if (config->replay_path[0] != '\0')
+    {
+        if (!trace_reader_open(&replay, config->replay_path))
+        {
+            exit(1);
+        }
+        replaying = true;
+    }
+    if (config->record_path[0] != '\0')
+    {
+        if (!trace_writer_open(&recorder, config->record_path))
+        {
+            exit(1);
+        }
+        recording = true;
+    }
+
+    const ArrivalConfig *arrival = &config->arrival;
+    if (replaying)
+    {
+        printf("[Generator, PID %d] Conectado. Reproduciendo %lu ordenes de %s (%s).\n", getpid(),
+               (unsigned long)replay.count, config->replay_path,
+               config->replay_fast ? "lo mas rapido posible" : "con los tiempos grabados");
+    }
+    else if (arrival->profile == ARRIVAL_CLASSIC)
+    {
+        printf("[Generator, PID %d] Conectado y listo para crear ordenes.\n", getpid());
+    }
+    else
+    {
+        printf("[Generator, PID %d] Conectado. Llegadas '%s' a %.1f ordenes/s (cola llena: %s).\n", getpid(),
+               arrival_profile_name(arrival->profile), arrival->rate,
+               arrival->overflow == OVERFLOW_DROP ? "descartar" : "esperar");
+    }
+
+    // --- 2. bucle principal de generacion ---
+    record_start_ns = now_ns();
+    bool closed_loop = replaying ? config->replay_fast : arrival->profile == ARRIVAL_CLASSIC;
+    if (closed_loop)
+    {
+        run_closed_loop();
+    }
+    else
+    {
+        run_open_loop();
+    }
+
+    if (recording)
+    {
+        printf("[Generator, PID %d] %lu ordenes grabadas en %s.\n", getpid(), (unsigned long)recorder.count, config->record_path);
+        trace_writer_close(&recorder);
+    }
+    if (replaying)
+    {
+        trace_reader_close(&replay);
     }
 
     printf("[Generator, PID %d] Terminando...\n", getpid());
     // liberamos la memoria mapeada antes de salir
-    munmap(shared_state, sizeof(SharedSystemState));
-}
\ No newline at end of file
+    shm_detach(shared_state);
+}
@@ -0,0 +1,345 @@
+// File: order_queue.c
+
+#include "order_queue.h"
+
+static inline OrderSlot *queue_slot(OrderQueue *q, const OrderLane *lane, uint64_t pos)
+{
+    return (OrderSlot *)((char *)q + lane->slots_offset) + pos % q->capacity;
+}
+
+// la casilla guarda la orden empaquetada y su llegada; la clase es la del
+// carril y el plazo sale de la llegada. las demas marcas de tiempo las
+// pone la banda
+static inline void slot_load(const OrderSlot *slot, const OrderLane *lane, int order_class, BurgerOrder *out)
+{
+    out->packed = slot->order;
+    out->enqueued_ns = atomic_load_explicit(&slot->enqueued_ns, memory_order_relaxed);
+    out->dequeued_ns = 0;
+    out->completed_ns = 0;
+    out->deadline_ns = out->enqueued_ns + lane->slack_ns;
+    out->priority = order_class;
+}
+
+void order_queue_init(OrderQueue *q, OrderSlot *slots, uint32_t capacity, int num_lanes)
+{
+    ec_init(&q->not_empty);
+    ec_init(&q->not_full);
+    q->capacity = capacity;
+    q->num_lanes = num_lanes;
+    q->edf = false;
+    for (int l = 0; l < num_lanes; l++)
+    {
+        OrderLane *lane = &q->lanes[l];
+        OrderSlot *lane_slots = slots + (size_t)l * capacity;
+        atomic_init(&lane->enqueue_pos, 0);
+        atomic_init(&lane->dequeue_pos, 0);
+        lane->slots_offset = (size_t)((char *)lane_slots - (char *)q);
+        lane->slack_ns = 0;
+        // cada casilla empieza esperando al productor de la posicion i
+        for (uint32_t i = 0; i < capacity; i++)
+        {
+            atomic_init(&lane_slots[i].seq, i);
+            atomic_init(&lane_slots[i].enqueued_ns, 0);
+        }
+    }
+}
+
+void order_queue_set_deadlines(OrderQueue *q, const uint64_t deadline_us[ORDER_CLASSES], bool edf)
+{
+    for (uint32_t l = 0; l < q->num_lanes; l++)
+        q->lanes[l].slack_ns = deadline_us[l] * 1000ull;
+    q->edf = edf;
+}
+
+// carril de una orden: el de su clase (todas al unico carril si no hay mas)
+static inline OrderLane *lane_of(OrderQueue *q, const BurgerOrder *order)
+{
+    return &q->lanes[order->priority < q->num_lanes ? order->priority : 0];
+}
+
+bool order_queue_try_push(OrderQueue *q, const BurgerOrder *order)
+{
+    OrderLane *lane = lane_of(q, order);
+    OrderSlot *slot;
+    uint64_t pos = atomic_load_explicit(&lane->enqueue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot = queue_slot(q, lane, pos);
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0)
+        {
+            // la casilla esta libre, intentamos reservar la posicion
+            if (atomic_compare_exchange_weak_explicit(&lane->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // la casilla aun no la libera el consumidor de la vuelta anterior: llena
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&lane->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->order = order->packed;
+    atomic_store_explicit(&slot->enqueued_ns, order->enqueued_ns, memory_order_relaxed);
+    // publicamos la orden para el consumidor de esta posicion
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    ec_notify(&q->not_empty, false);
+    return true;
+}
+
+// clave de la cabeza de un carril (UINT64_MAX si esta vacio): el plazo con
+// edf, la llegada sin el. la casilla puede cambiar mientras se lee; el CAS
+// del que saca la orden decide
+static uint64_t lane_head_key(OrderQueue *q, OrderLane *lane)
+{
+    uint64_t pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        OrderSlot *slot = queue_slot(q, lane, pos);
+        int64_t diff = (int64_t)atomic_load_explicit(&slot->seq, memory_order_acquire) - (int64_t)(pos + 1);
+        if (diff < 0)
+            return UINT64_MAX;
+        if (diff == 0)
+            return atomic_load_explicit(&slot->enqueued_ns, memory_order_relaxed) + (q->edf ? lane->slack_ns : 0);
+        pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+    }
+}
+
+// carril cuya cabeza va primero (-1: todos vacios). en *runner_up deja la
+// clave de la mejor cabeza de los demas carriles, el limite de un lote
+static int pick_lane(OrderQueue *q, uint64_t *runner_up)
+{
+    *runner_up = UINT64_MAX;
+    if (q->num_lanes == 1)
+        return 0;
+    int best = -1;
+    uint64_t best_key = UINT64_MAX;
+    for (uint32_t l = 0; l < q->num_lanes; l++)
+    {
+        uint64_t key = lane_head_key(q, &q->lanes[l]);
+        if (key < best_key)
+        {
+            *runner_up = best_key;
+            best_key = key;
+            best = (int)l;
+        }
+        else if (key < *runner_up)
+        {
+            *runner_up = key;
+        }
+    }
+    return best;
+}
+
+static bool lane_try_pop(OrderQueue *q, int l, BurgerOrder *out)
+{
+    OrderLane *lane = &q->lanes[l];
+    OrderSlot *slot;
+    uint64_t pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot = queue_slot(q, lane, pos);
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&lane->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // el productor todavia no ha escrito esta casilla: vacia
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    slot_load(slot, lane, l, out);
+    // liberamos la casilla para el productor de la siguiente vuelta
+    atomic_store_explicit(&slot->seq, pos + q->capacity, memory_order_release);
+    ec_notify(&q->not_full, false);
+    return true;
+}
+
+bool order_queue_try_pop(OrderQueue *q, BurgerOrder *out)
+{
+    for (;;)
+    {
+        uint64_t runner_up;
+        int l = pick_lane(q, &runner_up);
+        if (l < 0)
+            return false;
+        if (lane_try_pop(q, l, out))
+            return true;
+        // otro consumidor vacio el carril elegido
+        if (q->num_lanes == 1)
+            return false;
+    }
+}
+
+int order_queue_try_pop_batch(OrderQueue *q, BurgerOrder out[], int max)
+{
+    uint64_t limit;
+    int l = pick_lane(q, &limit);
+    if (l < 0)
+        return 0;
+    OrderLane *lane = &q->lanes[l];
+    uint64_t slack = q->edf ? lane->slack_ns : 0;
+    uint64_t pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+    int n;
+    for (;;)
+    {
+        // cuantas casillas seguidas desde pos ya publico su productor, sin
+        // pasar a la cabeza de otro carril que deba ir antes
+        n = 0;
+        while (n < max)
+        {
+            OrderSlot *slot = queue_slot(q, lane, pos + n);
+            uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            if (seq != pos + n + 1)
+                break;
+            if (n > 0 && atomic_load_explicit(&slot->enqueued_ns, memory_order_relaxed) + slack > limit)
+                break;
+            n++;
+        }
+        if (n == 0)
+        {
+            int64_t diff = (int64_t)atomic_load_explicit(&queue_slot(q, lane, pos)->seq, memory_order_acquire) -
+                           (int64_t)(pos + 1);
+            if (diff < 0)
+                return 0;
+            pos = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+            continue;
+        }
+        // reservamos las n posiciones de una vez; si otro consumidor se
+        // adelanto, pos queda actualizada y se vuelve a contar
+        if (atomic_compare_exchange_weak_explicit(&lane->dequeue_pos, &pos, pos + n,
+                                                  memory_order_relaxed, memory_order_relaxed))
+            break;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        OrderSlot *slot = queue_slot(q, lane, pos + i);
+        slot_load(slot, lane, l, &out[i]);
+        atomic_store_explicit(&slot->seq, pos + i + q->capacity, memory_order_release);
+    }
+    ec_notify(&q->not_full, n > 1);
+    return n;
+}
+
+bool order_queue_push(OrderQueue *q, const BurgerOrder *order, atomic_bool *running)
+{
+    while (!order_queue_try_push(q, order))
+    {
+        uint32_t key = ec_prepare_wait(&q->not_full);
+        if (order_queue_try_push(q, order))
+        {
+            ec_cancel_wait(&q->not_full);
+            return true;
+        }
+        if (!atomic_load(running))
+        {
+            ec_cancel_wait(&q->not_full);
+            return false;
+        }
+        ec_wait(&q->not_full, key);
+    }
+    return true;
+}
+
+bool order_queue_pop(OrderQueue *q, BurgerOrder *out, atomic_bool *running)
+{
+    while (!order_queue_try_pop(q, out))
+    {
+        uint32_t key = ec_prepare_wait(&q->not_empty);
+        if (order_queue_try_pop(q, out))
+        {
+            ec_cancel_wait(&q->not_empty);
+            return true;
+        }
+        if (!atomic_load(running))
+        {
+            ec_cancel_wait(&q->not_empty);
+            return false;
+        }
+        ec_wait(&q->not_empty, key);
+    }
+    return true;
+}
+
+void order_queue_wake_all(OrderQueue *q)
+{
+    ec_notify(&q->not_empty, true);
+    ec_notify(&q->not_full, true);
+}
+
+static int lane_size(const OrderQueue *q, const OrderLane *lane)
+{
+    uint64_t tail = atomic_load_explicit(&lane->enqueue_pos, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&lane->dequeue_pos, memory_order_relaxed);
+    int64_t size = (int64_t)(tail - head);
+    if (size < 0)
+        return 0;
+    if (size > q->capacity)
+        return q->capacity;
+    return (int)size;
+}
+
+int order_queue_size(OrderQueue *q)
+{
+    int size = 0;
+    for (uint32_t l = 0; l < q->num_lanes; l++)
+        size += lane_size(q, &q->lanes[l]);
+    return size;
+}
+
+int order_queue_class_size(OrderQueue *q, int order_class)
+{
+    if (order_class < 0 || (uint32_t)order_class >= q->num_lanes)
+        return 0;
+    return lane_size(q, &q->lanes[order_class]);
+}
+
+void order_queue_pending_needs(OrderQueue *q, uint64_t needs[MAX_INGREDIENTS])
+{
+    for (uint32_t l = 0; l < q->num_lanes; l++)
+    {
+        OrderLane *lane = &q->lanes[l];
+        uint64_t head = atomic_load_explicit(&lane->dequeue_pos, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&lane->enqueue_pos, memory_order_acquire);
+        if (tail - head > q->capacity)
+            tail = head + q->capacity;
+        for (uint64_t pos = head; pos < tail; pos++)
+        {
+            // como un seqlock: la copia vale si la casilla sigue publicada
+            // para la misma posicion despues de leerla
+            OrderSlot *slot = queue_slot(q, lane, pos);
+            if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1)
+                continue;
+            PackedOrder order = slot->order;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != pos + 1)
+                continue;
+            for (int i = 0; i < MAX_INGREDIENTS; i++)
+                needs[i] += order.count[i];
+        }
+    }
+}
+
+int order_queue_capacity(const OrderQueue *q)
+{
+    return (int)(q->capacity * q->num_lanes);
+}
+
+bool order_queue_has_room(OrderQueue *q, const BurgerOrder *order)
+{
+    return lane_size(q, lane_of(q, order)) < (int)q->capacity;
+}
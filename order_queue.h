@@ -0,0 +1,49 @@
+// File: order_queue.h
+
+#ifndef ORDER_QUEUE_H
+#define ORDER_QUEUE_H
+
+#include "shared_data.h"
+
+// inicializa la cola (solo lo hace el proceso principal) con num_lanes
+// carriles de capacity casillas cada uno. slots debe estar en el mismo
+// segmento que la cola y tener lugar para capacity * num_lanes casillas
+void order_queue_init(OrderQueue *q, OrderSlot *slots, uint32_t capacity, int num_lanes);
+
+// plazo de cada clase (en us desde la llegada) y si se saca primero el
+// plazo mas cercano (edf) o la orden mas antigua de cualquier carril
+void order_queue_set_deadlines(OrderQueue *q, const uint64_t deadline_us[ORDER_CLASSES], bool edf);
+
+// operaciones sin bloqueo: devuelven false si la cola esta llena/vacia
+bool order_queue_try_push(OrderQueue *q, const BurgerOrder *order);
+bool order_queue_try_pop(OrderQueue *q, BurgerOrder *out);
+
+// saca hasta max ordenes consecutivas de un carril con un solo movimiento
+// de su posicion de desencolado, sin adelantar a la cabeza de otro carril
+// que deba ir antes. devuelve cuantas saco (0: vacia)
+int order_queue_try_pop_batch(OrderQueue *q, BurgerOrder out[], int max);
+
+// operaciones bloqueantes: duermen en un futex mientras la cola este
+// llena/vacia. devuelven false si el sistema se esta apagando
+bool order_queue_push(OrderQueue *q, const BurgerOrder *order, atomic_bool *running);
+bool order_queue_pop(OrderQueue *q, BurgerOrder *out, atomic_bool *running);
+
+// despierta a todos los procesos dormidos en la cola (se usa al apagar)
+void order_queue_wake_all(OrderQueue *q);
+
+// numero aproximado de ordenes en la cola (en total o de una clase)
+int order_queue_size(OrderQueue *q);
+int order_queue_class_size(OrderQueue *q, int order_class);
+
+// suma a needs lo que piden las ordenes que esperan en la cola. es una
+// foto aproximada: no frena a productores ni consumidores y se salta las
+// casillas que cambian mientras se leen
+void order_queue_pending_needs(OrderQueue *q, uint64_t needs[MAX_INGREDIENTS]);
+
+// casillas de todos los carriles
+int order_queue_capacity(const OrderQueue *q);
+
+// true si el carril de la orden tiene lugar (aproximado, como el tamaño)
+bool order_queue_has_room(OrderQueue *q, const BurgerOrder *order);
+
+#endif
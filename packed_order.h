@@ -0,0 +1,119 @@
+// File: packed_order.h
+
+#ifndef PACKED_ORDER_H
+#define PACKED_ORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "shared_data.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// operaciones vectoriales sobre ordenes empaquetadas (PackedOrder). las
+// cantidades de una orden son un vector de 16 carriles de 8 bits; del
+// inventario se toma una foto con la misma forma (inventory_snapshot) y
+// comparar una orden contra ella es un max, un compare y un movemask.
+// con SSE2 (siempre en x86-64) se compara una orden por instruccion; si se
+// compila con AVX2 (make CFLAGS="-O2 -mavx2") packed_fits_many compara dos.
+// sin SIMD hay una version escalar equivalente.
+//
+// los carriles desde MAX_INGREDIENTS son la mascara y el id: no cuentan
+#define PACKED_LANES 16
+#define PACKED_COUNT_LANES ((1u << MAX_INGREDIENTS) - 1)
+
+// recalcula la mascara de presencia a partir de las cantidades
+static inline void packed_update_mask(PackedOrder *p)
+{
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    uint32_t zero = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    p->need_mask = ~zero & PACKED_COUNT_LANES;
+#else
+    uint16_t mask = 0;
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+    {
+        if (p->count[i] > 0)
+            mask |= 1u << i;
+    }
+    p->need_mask = mask;
+#endif
+}
+
+// true si cada cantidad de la orden cabe en avail (un carril por ingrediente)
+static inline bool packed_fits(const PackedOrder *p, const uint8_t avail[PACKED_LANES])
+{
+#if defined(__SSE2__)
+    __m128i need = _mm_loadu_si128((const __m128i *)p);
+    __m128i have = _mm_loadu_si128((const __m128i *)avail);
+    // need <= have  <=>  max(need, have) == have
+    uint32_t ok = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(need, have), have));
+    return (ok & PACKED_COUNT_LANES) == PACKED_COUNT_LANES;
+#else
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+    {
+        if (p->count[i] > avail[i])
+            return false;
+    }
+    return true;
+#endif
+}
+
+// mascara de las ordenes de orders[0..n) (n <= 32) que caben en avail
+static inline uint32_t packed_fits_many(const PackedOrder *orders, int n, const uint8_t avail[PACKED_LANES])
+{
+    uint32_t fits = 0;
+    int k = 0;
+#if defined(__AVX2__)
+    // dos ordenes por registro de 32 bytes, contra la foto repetida
+    __m256i have = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)avail));
+    for (; k + 1 < n; k += 2)
+    {
+        __m256i need = _mm256_loadu_si256((const __m256i *)&orders[k]);
+        uint32_t ok = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(need, have), have));
+        if ((ok & PACKED_COUNT_LANES) == PACKED_COUNT_LANES)
+            fits |= 1u << k;
+        if (((ok >> 16) & PACKED_COUNT_LANES) == PACKED_COUNT_LANES)
+            fits |= 1u << (k + 1);
+    }
+#endif
+    for (; k < n; k++)
+    {
+        if (packed_fits(&orders[k], avail))
+            fits |= 1u << k;
+    }
+    return fits;
+}
+
+// suma las cantidades de p a total, saturando en 255. devuelve false si
+// algun carril se saturo (la suma ya no es exacta)
+static inline bool packed_add(PackedOrder *total, const PackedOrder *p)
+{
+    total->need_mask |= p->need_mask;
+#if defined(__SSE2__)
+    // a los carriles de mascara e id se les suma cero: quedan intactos
+    const __m128i lanes = _mm_cmplt_epi8(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                         _mm_set1_epi8(MAX_INGREDIENTS));
+    __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)p), lanes);
+    __m128i t = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)total), v);
+    _mm_storeu_si128((__m128i *)total, t);
+    uint32_t full = _mm_movemask_epi8(_mm_cmpeq_epi8(t, _mm_set1_epi8(-1)));
+    return (full & PACKED_COUNT_LANES) == 0;
+#else
+    bool exact = true;
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+    {
+        unsigned sum = total->count[i] + p->count[i];
+        total->count[i] = sum > 255 ? 255 : sum;
+        if (sum >= 255)
+            exact = false;
+    }
+    return exact;
+#endif
+}
+
+#endif
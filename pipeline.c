@@ -0,0 +1,364 @@
+// File: pipeline.c
+//
+// modo pipeline: un proceso con un hilo por trabajador de cada etapa. las
+// ordenes pasan de una etapa a la siguiente por colas acotadas en la
+// memoria compartida; un trabajador que encuentra llena la cola siguiente
+// espera (contrapresion), asi la etapa lenta frena a las anteriores en vez
+// de acumular ordenes sin limite. las ordenes que tiene en la mano un
+// trabajador se pierden si el proceso muere (como los deques de --threads);
+// las de las colas siguen ahi para el proceso que lo reemplace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pipeline.h"
+#include "dispatcher.h"
+#include "order_queue.h"
+#include "clock_utils.h"
+#include "journal.h"
+#include "belt.h"
+
+typedef struct {
+    pthread_t thread;
+    int id;       // casilla de banda
+    int stage;
+} StageWorker;
+
+static SharedSystemState *shared_state = NULL;
+
+bool pipeline_parse(const char *spec, SystemConfig *config)
+{
+    config->num_stages = 0;
+    const char *p = spec;
+    while (*p != '\0')
+    {
+        if (config->num_stages == MAX_STAGES)
+            return false;
+        StageConfig *stage = &config->stages[config->num_stages++];
+        size_t len = strcspn(p, ":,");
+        if (len == 0 || len >= sizeof(stage->name))
+            return false;
+        memcpy(stage->name, p, len);
+        stage->name[len] = '\0';
+        stage->workers = 1;
+        stage->service_time_us = -1;
+        p += len;
+        char *end;
+        if (*p == ':')
+        {
+            long workers = strtol(p + 1, &end, 10);
+            if (end == p + 1 || workers < 1 || workers > BELT_LIMIT)
+                return false;
+            stage->workers = (int)workers;
+            p = end;
+        }
+        if (*p == ':')
+        {
+            long us = strtol(p + 1, &end, 10);
+            if (end == p + 1 || us < 0 || us > 2000000000L)
+                return false;
+            stage->service_time_us = (int)us;
+            p = end;
+        }
+        if (*p == ',')
+            p++;
+        else if (*p != '\0')
+            return false;
+    }
+    return config->num_stages > 0;
+}
+
+void pipeline_resolve(SystemConfig *config)
+{
+    for (int s = 0; s < config->num_stages; s++)
+    {
+        if (config->stages[s].service_time_us < 0)
+            config->stages[s].service_time_us = config->service_time_us / config->num_stages;
+    }
+}
+
+int pipeline_workers(const SystemConfig *config)
+{
+    int total = 0;
+    for (int s = 0; s < config->num_stages; s++)
+        total += config->stages[s].workers;
+    return total;
+}
+
+int pipeline_stage_of(const SystemConfig *config, int belt_id)
+{
+    for (int s = 0; s < config->num_stages; s++)
+    {
+        if (belt_id < config->stages[s].workers)
+            return s;
+        belt_id -= config->stages[s].workers;
+    }
+    return -1;
+}
+
+bool pipeline_can_stop(SharedSystemState *state, int belt_id)
+{
+    const SystemConfig *config = &state->config;
+    int stage = pipeline_stage_of(config, belt_id);
+    if (stage <= 0)
+        return true;
+    int first = 0;
+    for (int s = 0; s < stage; s++)
+        first += config->stages[s].workers;
+    for (int i = first; i < first + config->stages[stage].workers; i++)
+    {
+        if (i != belt_id &&
+            atomic_load_explicit(&state_belt(state, i)->command, memory_order_relaxed) == BELT_RUN)
+            return true;
+    }
+    return false;
+}
+
+void pipeline_init(SharedSystemState *state)
+{
+    for (int s = 0; s < state->config.num_stages; s++)
+    {
+        StageQueue *q = &state->pipeline[s].input;
+        atomic_init(&q->enqueue_pos, 0);
+        atomic_init(&q->dequeue_pos, 0);
+        ec_init(&q->not_empty);
+        ec_init(&q->not_full);
+        q->capacity = state->config.stage_queue_capacity;
+        for (uint32_t i = 0; i < q->capacity; i++)
+            atomic_init(&q->slots[i].seq, i);
+    }
+}
+
+static int stage_queue_size(StageQueue *q)
+{
+    uint64_t tail = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    int64_t size = (int64_t)(tail - head);
+    if (size < 0)
+        return 0;
+    return size > q->capacity ? (int)q->capacity : (int)size;
+}
+
+int pipeline_queue_depth(SharedSystemState *state, int stage)
+{
+    if (stage == 0)
+        return dispatcher_pending(state);
+    return stage_queue_size(&state->pipeline[stage].input);
+}
+
+int pipeline_queue_capacity(SharedSystemState *state, int stage)
+{
+    if (stage == 0)
+        return order_queue_capacity(&state->waiting_orders) + state->config.dispatch_window;
+    return (int)state->pipeline[stage].input.capacity;
+}
+
+void pipeline_wake_all(SharedSystemState *state)
+{
+    for (int s = 1; s < state->config.num_stages; s++)
+    {
+        ec_notify(&state->pipeline[s].input.not_empty, true);
+        ec_notify(&state->pipeline[s].input.not_full, true);
+    }
+}
+
+// mismas reglas que order_queue_try_push/try_pop, con la orden completa
+static bool stage_queue_try_push(StageQueue *q, const BurgerOrder *order)
+{
+    StageSlot *slot;
+    uint64_t pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &q->slots[pos % q->capacity];
+        int64_t diff = (int64_t)atomic_load_explicit(&slot->seq, memory_order_acquire) - (int64_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = atomic_load_explicit(&q->enqueue_pos, memory_order_relaxed);
+    }
+    slot->order = *order;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    ec_notify(&q->not_empty, false);
+    return true;
+}
+
+static bool stage_queue_try_pop(StageQueue *q, BurgerOrder *out)
+{
+    StageSlot *slot;
+    uint64_t pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &q->slots[pos % q->capacity];
+        int64_t diff = (int64_t)atomic_load_explicit(&slot->seq, memory_order_acquire) - (int64_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&q->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+            return false;
+        else
+            pos = atomic_load_explicit(&q->dequeue_pos, memory_order_relaxed);
+    }
+    *out = slot->order;
+    atomic_store_explicit(&slot->seq, pos + q->capacity, memory_order_release);
+    ec_notify(&q->not_full, false);
+    return true;
+}
+
+// pasa la orden a la etapa stage, esperando lugar en su cola. solo se
+// rinde al apagar: la orden ya tiene sus ingredientes reservados
+static void stage_push(PipelineStage *stage, const BurgerOrder *order)
+{
+    StageQueue *q = &stage->input;
+    while (!stage_queue_try_push(q, order))
+    {
+        uint32_t key = ec_prepare_wait(&q->not_full);
+        if (stage_queue_try_push(q, order))
+        {
+            ec_cancel_wait(&q->not_full);
+            break;
+        }
+        if (!shared_state->system_running)
+        {
+            ec_cancel_wait(&q->not_full);
+            return;
+        }
+        ec_wait(&q->not_full, key);
+    }
+    uint32_t depth = stage_queue_size(q);
+    uint32_t max = atomic_load_explicit(&stage->depth_max, memory_order_relaxed);
+    while (depth > max &&
+           !atomic_compare_exchange_weak_explicit(&stage->depth_max, &max, depth, memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+// siguiente orden de la cola de entrada de la etapa. devuelve false al
+// apagar o si la interfaz le mando un comando al trabajador
+static bool stage_pop(StageWorker *w, BurgerOrder *out)
+{
+    StageQueue *q = &shared_state->pipeline[w->stage].input;
+    PreparationBelt *belt = state_belt(shared_state, w->id);
+    for (;;)
+    {
+        if (stage_queue_try_pop(q, out))
+            return true;
+        uint32_t key = ec_prepare_wait(&q->not_empty);
+        if (stage_queue_try_pop(q, out))
+        {
+            ec_cancel_wait(&q->not_empty);
+            return true;
+        }
+        if (!shared_state->system_running ||
+            atomic_load_explicit(&belt->command, memory_order_acquire) != BELT_RUN)
+        {
+            ec_cancel_wait(&q->not_empty);
+            return false;
+        }
+        ec_wait(&q->not_empty, key);
+    }
+}
+
+// la parte de la etapa: la prepara y la pasa a la siguiente o, en la
+// ultima, la registra como terminada
+static void work_on(StageWorker *w, BurgerOrder *order)
+{
+    PipelineStage *stage = &shared_state->pipeline[w->stage];
+    PreparationBelt *belt = state_belt(shared_state, w->id);
+    belt_set_state(belt, PREPARING, order->order_id);
+    log_event(shared_state, w->id, LOG_DEBUG, LOG_EV_BELT_PREPARING, order->order_id, 0);
+    uint64_t start = now_ns();
+    sleep_us(shared_state->config.stages[w->stage].service_time_us);
+    uint64_t end = now_ns();
+    atomic_fetch_add_explicit(&stage->busy_ns, end - start, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage->processed, 1, memory_order_relaxed);
+    belt_count_stage_item(belt);
+
+    if (w->stage + 1 < shared_state->config.num_stages)
+    {
+        belt_set_state(belt, IDLE, 0);
+        stage_push(&shared_state->pipeline[w->stage + 1], order);
+        return;
+    }
+    order->completed_ns = end;
+    belt_record_latency(shared_state, w->id, order);
+    journal_append(JR_COMPLETE, order, w->id);
+    belt_count_processed(belt);
+    log_event(shared_state, w->id, LOG_DEBUG, LOG_EV_BELT_DONE, order->order_id, belt->burgers_processed);
+}
+
+static void *stage_worker_main(void *arg)
+{
+    StageWorker *w = arg;
+    PreparationBelt *belt = state_belt(shared_state, w->id);
+    int stage_workers = shared_state->config.stages[w->stage].workers;
+
+    affinity_pin_belt(&shared_state->config.affinity, w->id);
+    belt_recover(shared_state, w->id);
+    while (belt_wait_runnable(shared_state, w->id))
+    {
+        belt_set_state(belt, IDLE, 0);
+
+        // la primera etapa despacha (ingredientes reservados); las demas
+        // toman lo que dejo la anterior
+        BurgerOrder batch[MAX_BATCH_SIZE];
+        int n;
+        if (w->stage == 0)
+        {
+            n = dispatcher_next(shared_state, w->id, batch, dispatcher_batch_size(shared_state, stage_workers));
+            if (n > 0 && shared_state->config.batch_size > 1)
+                belt_count_batch(belt, n);
+        }
+        else
+        {
+            n = stage_pop(w, &batch[0]) ? 1 : 0;
+        }
+        for (int k = 0; k < n; k++)
+            work_on(w, &batch[k]);
+    }
+    return NULL;
+}
+
+void start_pipeline_process(const char *shm_name)
+{
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL) { exit(1); }
+
+    const SystemConfig *config = &shared_state->config;
+    int num_workers = shared_state->num_belts;
+    StageWorker *workers = calloc(num_workers, sizeof(StageWorker));
+    if (workers == NULL) { perror("calloc (pipeline)"); exit(1); }
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers[i].id = i;
+        workers[i].stage = pipeline_stage_of(config, i);
+    }
+
+    printf("[Pipeline, PID %d] %d etapas con %d trabajadores como hilos.\n", getpid(), config->num_stages,
+           num_workers);
+    for (int i = 0; i < num_workers; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, stage_worker_main, &workers[i]) != 0)
+        {
+            perror("pthread_create (pipeline)");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < num_workers; i++)
+        pthread_join(workers[i].thread, NULL);
+    free(workers);
+
+    printf("[Pipeline, PID %d] Terminando...\n", getpid());
+    shm_detach(shared_state);
+}
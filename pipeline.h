@@ -0,0 +1,49 @@
+// File: pipeline.h
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "shared_data.h"
+
+// modo pipeline (--pipeline): la preparacion se divide en etapas (por
+// ejemplo grill -> assemble -> wrap), cada una con su grupo de trabajadores
+// y una cola acotada hacia la siguiente. asi una etapa lenta no retiene una
+// banda entera y se puede agrandar solo la etapa que hace de cuello de
+// botella. todos los trabajadores son hilos de un solo proceso y cada uno
+// ocupa una casilla de banda (estado, comandos, registro); los de la
+// primera etapa toman ordenes del despachador y los de la ultima las
+// registran como terminadas
+
+// lee la especificacion "nombre[:trabajadores[:us]],..." en config. una
+// etapa sin tiempo propio queda con -1 (ver pipeline_resolve). devuelve
+// false si la especificacion no es valida
+bool pipeline_parse(const char *spec, SystemConfig *config);
+
+// reparte --service-us en partes iguales entre las etapas sin tiempo propio
+void pipeline_resolve(SystemConfig *config);
+
+// trabajadores de todas las etapas (las casillas de banda que ocupan)
+int pipeline_workers(const SystemConfig *config);
+
+// etapa a la que pertenece la banda belt_id (-1 sin pipeline)
+int pipeline_stage_of(const SystemConfig *config, int belt_id);
+
+// true si se puede pausar o retirar la banda belt_id. un trabajador de una
+// etapa que no es la primera no puede ser el ultimo que corre en ella: los
+// de la etapa anterior se quedarian esperando lugar en stage_push con
+// ordenes que ya tienen sus ingredientes reservados
+bool pipeline_can_stop(SharedSystemState *state, int belt_id);
+
+// deja vacias las colas entre etapas (solo el proceso principal)
+void pipeline_init(SharedSystemState *state);
+
+// ordenes que esperan a la etapa: las de la cola de ordenes para la
+// primera, las de su cola de entrada para las demas
+int pipeline_queue_depth(SharedSystemState *state, int stage);
+int pipeline_queue_capacity(SharedSystemState *state, int stage);
+
+// despierta a los trabajadores dormidos en las colas entre etapas (al
+// apagar o al mandarles un comando)
+void pipeline_wake_all(SharedSystemState *state);
+
+#endif
@@ -0,0 +1,268 @@
+// File: restocker.c
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "restocker.h"
+#include "dispatcher.h"
+#include "inventory.h"
+
+// ordenes por segundo que dan abasto las bandas (0: sin limite conocido)
+static double belt_capacity(const SharedSystemState *state)
+{
+    const SystemConfig *config = &state->config;
+    if (config->num_stages > 0)
+    {
+        // el pipeline va al paso de su etapa mas lenta
+        double capacity = 0.0;
+        for (int s = 0; s < config->num_stages; s++)
+        {
+            if (config->stages[s].service_time_us <= 0)
+                continue;
+            double stage = config->stages[s].workers * 1e6 / config->stages[s].service_time_us;
+            if (capacity == 0.0 || stage < capacity)
+                capacity = stage;
+        }
+        return capacity;
+    }
+    return config->service_time_us > 0 ? state->num_belts * 1e6 / config->service_time_us : 0.0;
+}
+
+// ordenes por segundo que promete la configuracion: la tasa del perfil de
+// lazo abierto o la espera del lazo cerrado, que ademas no pasa de lo que
+// dan abasto las bandas. una traza no tiene tasa: se aprende midiendo
+static double configured_arrival_rate(const SharedSystemState *state)
+{
+    const SystemConfig *config = &state->config;
+    if (config->replay_path[0] != '\0')
+        return 0.0;
+    if (config->arrival.profile != ARRIVAL_CLASSIC)
+        return config->arrival.rate;
+    double rate = config->arrival_time_us > 0 ? 1e6 / config->arrival_time_us
+                : config->arrival_time_us < 0 ? 0.5   // aleatorio 1-3 s
+                : 0.0;
+    double capacity = belt_capacity(state);
+    if (capacity > 0.0 && (rate == 0.0 || rate > capacity))
+        rate = capacity;
+    return rate;
+}
+
+void restock_init(RestockEngine *e, SharedSystemState *state)
+{
+    memset(e, 0, sizeof(*e));
+    e->config = state->config.restock;
+    e->arrival_rate = configured_arrival_rate(state);
+    order_expected_needs(e->prior_needs);
+}
+
+bool restock_in_transit(const RestockEngine *e)
+{
+    return e->num_pending > 0;
+}
+
+static uint64_t accepted_orders(SharedSystemState *state)
+{
+    RunStats *stats = &state->stats;
+    return atomic_load_explicit(&stats->orders_generated, memory_order_relaxed) -
+           atomic_load_explicit(&stats->orders_dropped, memory_order_relaxed);
+}
+
+// lo que pide en promedio una orden: las terminadas y las que esperan,
+// arrancando de la receta con peso RESTOCK_PRIOR_ORDERS (una traza puede
+// pedir otra cosa)
+static void needs_per_order(RestockEngine *e, SharedSystemState *state, const uint64_t queued[MAX_INGREDIENTS],
+                            double out[MAX_INGREDIENTS])
+{
+    double orders = RESTOCK_PRIOR_ORDERS + dispatcher_pending(state);
+    double units[MAX_INGREDIENTS];
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        units[i] = RESTOCK_PRIOR_ORDERS * e->prior_needs[i] + (double)queued[i];
+    for (int b = 0; b < state->num_belts; b++)
+    {
+        BeltMetrics *metrics = state_belt_metrics(state, b);
+        orders += atomic_load_explicit(&metrics->total.total, memory_order_relaxed);
+        for (int i = 0; i < MAX_INGREDIENTS; i++)
+            units[i] += atomic_load_explicit(&metrics->consumed[i], memory_order_relaxed);
+    }
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        out[i] = units[i] / orders;
+}
+
+// la demanda sale de las ordenes que llegan: mientras una banda esta parada
+// las llegadas siguen y su demanda no se pierde. devuelve lo que paso desde
+// la vuelta anterior (0 en la primera)
+static uint64_t measure(RestockEngine *e, SharedSystemState *state, uint64_t now, int stalled_belts,
+                        const uint64_t queued[MAX_INGREDIENTS])
+{
+    uint64_t accepted = accepted_orders(state);
+    uint64_t dt_ns = 0;
+    if (e->last_ns != 0 && now > e->last_ns)
+    {
+        dt_ns = now - e->last_ns;
+        double rate = (accepted - e->accepted) * 1e9 / dt_ns;
+        // con bandas paradas lo medido es una cota baja (en lazo cerrado el
+        // generador se frena con la cola llena): no baja la estimacion
+        if (stalled_belts == 0 || rate > e->arrival_rate)
+            e->arrival_rate = RESTOCK_EWMA_ALPHA * rate + (1.0 - RESTOCK_EWMA_ALPHA) * e->arrival_rate;
+        atomic_fetch_add_explicit(&state->restock.stall_ns, (uint64_t)stalled_belts * dt_ns, memory_order_relaxed);
+    }
+    e->last_ns = now;
+    e->accepted = accepted;
+
+    double per_order[MAX_INGREDIENTS];
+    needs_per_order(e, state, queued, per_order);
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        e->rate[i] = e->arrival_rate * per_order[i];
+    return dt_ns;
+}
+
+// unidades de cada ingrediente que piden las ordenes que esperan: cola y
+// ventana (exacto) mas la espera local del generador (por lo que pide en
+// promedio una orden)
+static void waiting_needs(RestockEngine *e, SharedSystemState *state, const uint64_t queued[MAX_INGREDIENTS],
+                          double out[MAX_INGREDIENTS])
+{
+    uint32_t backlog = atomic_load_explicit(&state->stats.backlog_depth, memory_order_relaxed);
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        out[i] = (double)queued[i] + (e->arrival_rate > 0 ? backlog * e->rate[i] / e->arrival_rate : 0.0);
+}
+
+// entrega los pedidos vencidos
+static void deliver(RestockEngine *e, SharedSystemState *state, uint64_t now)
+{
+    int k = 0;
+    while (k < e->num_pending)
+    {
+        RestockDelivery d = e->pending[k];
+        if (d.due_ns > now)
+        {
+            k++;
+            continue;
+        }
+        dispatcher_restock(state, d.ingredient, d.quantity);
+        e->in_transit[d.ingredient] -= d.quantity;
+        e->delivered[d.ingredient] += d.quantity;
+        atomic_fetch_add_explicit(&state->restock.units, d.quantity, memory_order_relaxed);
+        e->pending[k] = e->pending[--e->num_pending];
+    }
+}
+
+// pide lotes enteros para que lo que hay mas lo que viene en camino cubra
+// las ordenes que esperan y la demanda hasta que llegue un pedido hecho en
+// la proxima vuelta (que se entrega en la vuelta siguiente a su plazo), con
+// un margen para la variacion de las llegadas
+static void order_missing(RestockEngine *e, SharedSystemState *state, uint64_t now,
+                          const double waiting[MAX_INGREDIENTS])
+{
+    RestockStats *stats = &state->restock;
+    double horizon_s = (e->config.lead_time_ms + 2 * RESTOCK_INTERVAL_MS) / 1000.0;
+    for (uint32_t i = 0; i < state->inventory.num_ingredients; i++)
+    {
+        double cover = (double)inventory_count(&state->inventory, i) + e->in_transit[i];
+        double arriving = e->rate[i] * horizon_s;
+        double demand = waiting[i] + arriving + RESTOCK_SAFETY_SIGMAS * sqrt(arriving);
+        if (cover >= demand || e->num_pending == RESTOCK_MAX_PENDING)
+            continue;
+        long deficit = (long)(demand - cover) + 1;
+        long lots = (deficit + e->config.batch - 1) / e->config.batch;
+        int quantity = (int)(lots * e->config.batch);
+        e->pending[e->num_pending++] = (RestockDelivery){
+            .due_ns = now + (uint64_t)e->config.lead_time_ms * 1000000,
+            .ingredient = (int)i,
+            .quantity = quantity,
+        };
+        e->in_transit[i] += quantity;
+        atomic_fetch_add_explicit(&stats->orders, 1, memory_order_relaxed);
+    }
+}
+
+// parada evitada: se compara con una proyeccion sin reposicion. sin
+// nuestras entregas las existencias serian las de ahora menos todo lo que
+// entregamos (lo que consumieron las bandas se habria consumido igual hasta
+// agotarse). si con eso algun ingrediente no cubre las ordenes que esperan,
+// las bandas que preparan tambien estarian paradas: ese tiempo se evito.
+// nunca pasa del tiempo de banda que existio, porque las que preparan y las
+// paradas son bandas distintas
+static void account_avoided(RestockEngine *e, SharedSystemState *state, uint64_t dt_ns, int working_belts,
+                            const double waiting[MAX_INGREDIENTS])
+{
+    if (dt_ns == 0 || working_belts == 0)
+        return;
+    for (uint32_t i = 0; i < state->inventory.num_ingredients; i++)
+    {
+        double without = (double)inventory_count(&state->inventory, i) - e->delivered[i];
+        if (without < waiting[i])
+        {
+            atomic_fetch_add_explicit(&state->restock.stall_ns_avoided, (uint64_t)working_belts * dt_ns,
+                                      memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+static void publish(RestockEngine *e, SharedSystemState *state, const double waiting[MAX_INGREDIENTS])
+{
+    RestockStats *stats = &state->restock;
+    for (uint32_t i = 0; i < state->inventory.num_ingredients; i++)
+    {
+        double free = (double)inventory_count(&state->inventory, i) - waiting[i];
+        int64_t depletion = -1;
+        if (e->rate[i] > 0)
+            depletion = free > 0 ? (int64_t)(free / e->rate[i] * 1000.0) : 0;
+        atomic_store_explicit(&stats->rate_milli[i], (uint32_t)(e->rate[i] * 1000.0), memory_order_relaxed);
+        atomic_store_explicit(&stats->depletion_ms[i], depletion, memory_order_relaxed);
+        atomic_store_explicit(&stats->in_transit[i], (uint32_t)e->in_transit[i], memory_order_relaxed);
+    }
+}
+
+void restock_step(RestockEngine *e, SharedSystemState *state, uint64_t now, int stalled_belts, int working_belts)
+{
+    uint64_t queued[MAX_INGREDIENTS];
+    dispatcher_pending_needs(state, queued);
+    uint64_t dt_ns = measure(e, state, now, stalled_belts, queued);
+    deliver(e, state, now);
+    // lo que llego ya lo pueden tomar las ordenes que esperan: se vuelve a mirar
+    dispatcher_pending_needs(state, queued);
+    double waiting[MAX_INGREDIENTS];
+    waiting_needs(e, state, queued, waiting);
+    account_avoided(e, state, dt_ns, working_belts, waiting);
+    order_missing(e, state, now, waiting);
+    publish(e, state, waiting);
+}
+
+void start_restock_process(const char *shm_name)
+{
+    SharedSystemState *shared_state = shm_attach(shm_name);
+    if (shared_state == NULL)
+    {
+        exit(1);
+    }
+    const SystemConfig *config = &shared_state->config;
+    RestockEngine engine;
+    restock_init(&engine, shared_state);
+    printf("[Reposicion, PID %d] Lotes de %d unidades, entrega en %d ms.\n", getpid(), config->restock.batch,
+           config->restock.lead_time_ms);
+
+    while (shared_state->system_running)
+    {
+        int stalled = 0;
+        int working = 0;
+        for (int i = 0; i < shared_state->num_belts; i++)
+        {
+            BeltSnapshot belt;
+            belt_snapshot(state_belt(shared_state, i), &belt);
+            if (belt.status == NO_INGREDIENTS)
+                stalled++;
+            else if (belt.status == PREPARING)
+                working++;
+        }
+        restock_step(&engine, shared_state, now_ns(), stalled, working);
+        sleep_us(RESTOCK_INTERVAL_MS * 1000);
+    }
+
+    printf("[Reposicion, PID %d] Terminando...\n", getpid());
+    shm_detach(shared_state);
+}
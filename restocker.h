@@ -0,0 +1,67 @@
+// File: restocker.h
+
+#ifndef RESTOCKER_H
+#define RESTOCKER_H
+
+#include "shared_data.h"
+
+// reposicion automatica (--auto-restock): en vez de esperar a que una banda
+// se quede sin ingredientes, un proceso estima cada RESTOCK_INTERVAL_MS la
+// demanda de cada ingrediente y pide al proveedor lotes de --restock-batch
+// unidades cuando lo que hay mas lo que viene en camino no alcanza para lo
+// que piden las ordenes que esperan (cola, ventana y espera local del
+// generador) mas lo que llegara antes de que entre un pedido hecho ahora
+// (--restock-lead-ms). el pedido llega al inventario pasado ese plazo, como
+// una reposicion de la interfaz.
+//
+// la demanda sale de las llegadas, no de las ordenes terminadas: ordenes
+// por segundo que acepta el generador (media movil exponencial) por lo que
+// pide en promedio cada orden. asi una banda parada sigue contando como
+// demanda sin atender en vez de como consumo cero. antes de la primera
+// muestra se usa la tasa configurada y la receta de order_build_random, asi
+// que la primera vuelta (en t=0) ya pide lo que no cubren las existencias
+// iniciales
+#define RESTOCK_INTERVAL_MS 100
+#define RESTOCK_EWMA_ALPHA 0.2
+#define RESTOCK_PRIOR_ORDERS 20.0     // peso (en ordenes) de la receta al promediar lo que pide una orden
+#define RESTOCK_SAFETY_SIGMAS 3.0     // margen: desvios (llegadas de Poisson) sobre la demanda esperada
+#define RESTOCK_MAX_PENDING 64
+#define DEFAULT_RESTOCK_LEAD_MS 1000
+#define DEFAULT_RESTOCK_BATCH 50
+
+// un pedido en camino
+typedef struct {
+    uint64_t due_ns;
+    int ingredient;
+    int quantity;
+} RestockDelivery;
+
+typedef struct {
+    RestockConfig config;
+    uint64_t last_ns;                     // 0: todavia sin muestra
+    uint64_t accepted;                    // ordenes aceptadas (generadas menos descartadas) en la muestra anterior
+    double arrival_rate;                  // ordenes/s (EWMA)
+    double prior_needs[MAX_INGREDIENTS];  // lo que pide una orden segun la receta
+    double rate[MAX_INGREDIENTS];         // demanda en unidades/s
+    long in_transit[MAX_INGREDIENTS];
+    long delivered[MAX_INGREDIENTS];      // unidades entregadas (para la proyeccion sin reposicion)
+    RestockDelivery pending[RESTOCK_MAX_PENDING];
+    int num_pending;
+} RestockEngine;
+
+// arranca con la tasa de llegadas de la configuracion de state (en lazo
+// cerrado, a lo sumo lo que dan abasto las bandas)
+void restock_init(RestockEngine *e, SharedSystemState *state);
+
+// una vuelta del motor en el instante now: estima la demanda, entrega los
+// pedidos vencidos y pide lo que haga falta. stalled_belts son las bandas
+// paradas por ingredientes y working_belts las que preparan una orden desde
+// la vuelta anterior. lo publica en state->restock, con el tiempo de banda
+// parada y el que se evito frente a no reponer. lo usan el proceso de
+// reposicion y la simulacion (con su reloj virtual)
+void restock_step(RestockEngine *e, SharedSystemState *state, uint64_t now, int stalled_belts, int working_belts);
+
+// true si hay pedidos en camino
+bool restock_in_transit(const RestockEngine *e);
+
+#endif
@@ -0,0 +1,54 @@
+// File: seqlock.h
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// candado de secuencia para datos con un unico escritor y lectores que no
+// deben frenarlo (la interfaz). el escritor nunca espera: marca el numero
+// como impar mientras escribe y par al terminar. el lector copia los datos
+// y reintenta si el numero cambio o era impar, asi nunca ve un estado a medias
+//
+// escritor:                         lector:
+//     seqlock_write_begin(&s);          uint32_t v;
+//     ... escribir campos ...           do {
+//     seqlock_write_end(&s);                v = seqlock_read_begin(&s);
+//                                           ... copiar campos ...
+//                                       } while (seqlock_read_retry(&s, v));
+typedef struct {
+    _Atomic uint32_t seq;
+} SeqLock;
+
+static inline void seqlock_write_begin(SeqLock *s)
+{
+    uint32_t v = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, v + 1, memory_order_relaxed);
+    // el numero impar debe verse antes que cualquiera de los datos nuevos
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void seqlock_write_end(SeqLock *s)
+{
+    uint32_t v = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, v + 1, memory_order_release);
+}
+
+static inline uint32_t seqlock_read_begin(const SeqLock *s)
+{
+    uint32_t v;
+    while ((v = atomic_load_explicit(&s->seq, memory_order_acquire)) & 1)
+        ;
+    return v;
+}
+
+static inline bool seqlock_read_retry(const SeqLock *s, uint32_t start)
+{
+    // las lecturas de los datos no pueden pasar despues de esta comprobacion
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s->seq, memory_order_relaxed) != start;
+}
+
+#endif
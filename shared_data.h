@@ -4,23 +4,58 @@
 #define SHARED_DATA_H
 
 #include <pthread.h>
-#include <semaphore.h> 
 #include <stdbool.h> 
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 
-// constantes de configuracion del sistema
-#define MAX_BELTS 20
+#include "futex.h"
+#include "latency_hist.h"
+#include "arrival.h"
+#include "seqlock.h"
+#include "log_ring.h"
+#include "affinity.h"
+#include "clock_utils.h"
+
+// constantes de configuracion del sistema. el numero de bandas y el tamano
+// de la cola se eligen al arrancar (el segmento se dimensiona con ellos);
+// estos son solo los valores por defecto y los limites de cordura
+#define DEFAULT_BELTS 5
+#define BELT_LIMIT 4096
+#define DEFAULT_QUEUE_CAPACITY 50
+#define QUEUE_CAPACITY_LIMIT (1u << 24)
 #define MAX_INGREDIENTS 10
-#define MAX_ORDERS_IN_QUEUE 50
+// maximo de ordenes en la ventana de despacho (una por bit de una mascara)
+#define MAX_DISPATCH_WINDOW 32
+// maximo de ordenes que una banda toma de una vez. no pasa de la ventana:
+// las ordenes del lote que no se pueden servir se quedan esperando en ella
+#define MAX_BATCH_SIZE MAX_DISPATCH_WINDOW
+// modo pipeline: maximo de etapas y de casillas de cada cola entre etapas
+#define MAX_STAGES 4
+#define STAGE_QUEUE_LIMIT 64
+#define DEFAULT_STAGE_QUEUE 16
 
+// tamano de linea de cache usado para separar datos muy escritos
+#define CACHE_LINE_SIZE 64
 
 // representa los posibles estados de una banda
 typedef enum {
     IDLE,
     PREPARING,
     PAUSED,
-    NO_INGREDIENTS
+    NO_INGREDIENTS,
+    DRAINED        // retirada: termino su ultima orden y salio
 } BeltStatus;
 
+// comandos que la interfaz le envia a una banda. la banda los atiende en
+// un punto seguro, entre una orden y la siguiente: nunca se detiene con una
+// orden a medias ni dentro de la cola o del inventario
+typedef enum {
+    BELT_RUN,
+    BELT_PAUSE,    // se estaciona hasta que la reanuden
+    BELT_DRAIN     // termina la orden en curso y sale
+} BeltCommand;
+
 // indices para el array de ingredientes
 typedef enum {
     BUN,
@@ -31,57 +66,537 @@ typedef enum {
     CHEESE,
 } IngredientType;
 
-// define una orden de hamburguesa
+// clases de prioridad de una orden. cada clase tiene su plazo prometido
+// desde la llegada (--classes); la estandar es la de siempre, asi una traza
+// o un diario sin clases se leen como estandar
+#define ORDER_CLASSES 3
+typedef enum {
+    ORDER_STANDARD,
+    ORDER_PREMIUM,   // apps de reparto: plazo corto
+    ORDER_WALKIN,    // mostrador: con holgura
+} OrderClass;
+#define DEFAULT_STANDARD_DEADLINE_US 8000000
+#define DEFAULT_PREMIUM_DEADLINE_US 4000000
+#define DEFAULT_WALKIN_DEADLINE_US 15000000
+
+// orden empaquetada en 16 bytes: la cantidad de cada ingrediente en un
+// carril de 8 bits, la mascara de los ingredientes que lleva y el id. las
+// cantidades van primero para que un vector de 16 bytes las compare todas
+// de una vez (ver packed_order.h)
 typedef struct {
-    unsigned int order_id;
-    int ingredients_needed[MAX_INGREDIENTS];
+    uint8_t count[MAX_INGREDIENTS];
+    uint16_t need_mask;           // bit i: count[i] > 0
+    uint32_t order_id;
+} PackedOrder;
+
+_Static_assert(sizeof(PackedOrder) == 16, "PackedOrder debe medir 16 bytes");
+
+// define una orden de hamburguesa. los primeros 16 bytes son la orden
+// empaquetada; los campos con nombre propio son los mismos bytes
+typedef struct {
+    union {
+        PackedOrder packed;
+        struct {
+            uint8_t ingredients_needed[MAX_INGREDIENTS];
+            uint16_t need_mask;
+            unsigned int order_id;
+        };
+    };
+    // marcas de tiempo (CLOCK_MONOTONIC, ns) del recorrido de la orden
+    uint64_t enqueued_ns;   // entra en la cola de espera
+    uint64_t dequeued_ns;   // una banda la saca de la cola
+    uint64_t completed_ns;  // la banda termina de prepararla
+    uint64_t deadline_ns;   // plazo prometido (llegada + plazo de su clase)
+    uint32_t priority;      // OrderClass
 } BurgerOrder;
 
-// define el inventario de un tipo de ingrediente
+_Static_assert(offsetof(BurgerOrder, order_id) == offsetof(PackedOrder, order_id),
+               "BurgerOrder y PackedOrder deben coincidir");
+
+// datos frios de un ingrediente (solo se escriben al iniciar)
 typedef struct {
     char name[20];
-    int count;
+} IngredientInfo;
+
+// define el inventario de un tipo de ingrediente: el contador y su mutex
+// ocupan su propia linea de cache para no compartirla con otro ingrediente.
+// el mutex es robusto: si su dueno muere con una reserva sin confirmar
+// (undo_pending), el siguiente que lo toma repone el valor anterior
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) int count;
+    int undo_count;
+    bool undo_pending;
     pthread_mutex_t mutex;
 } Ingredient;
 
-// representa el estado de una banda de preparacion
+// maximo de ingredientes cuyas existencias caben empaquetadas en una
+// palabra de 64 bits; con mas ingredientes se usa la ruta con mutex
+#define INVENTORY_PACKED_MAX 8
+
+// inventario de ingredientes
+//
+// ruta rapida (hasta INVENTORY_PACKED_MAX ingredientes): las existencias "en
+// estante" de todos los ingredientes van empaquetadas en una sola palabra de
+// 64 bits, un carril de lane_bits bits por ingrediente. revisar y descontar
+// una orden completa es un solo compare-and-swap: todo o nada y sin mutex.
+// lo que no cabe en un carril queda en la bodega (reserve) y se pasa al
+// estante cuando este se queda corto.
+//
+// ruta de respaldo (mas ingredientes): un contador con mutex por ingrediente
+typedef struct {
+    uint32_t num_ingredients;
+    uint32_t lane_bits;
+    bool packed;
+    _Atomic uint32_t owner_deaths;   // mutex recuperados de un dueno muerto
+
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t shelf;
+    _Alignas(CACHE_LINE_SIZE) _Atomic int64_t reserve[MAX_INGREDIENTS];
+
+    Ingredient locked[MAX_INGREDIENTS];
+} Inventory;
+
+// datos frios de una banda (solo se escriben al crearla)
 typedef struct {
     pid_t pid;
+} BeltInfo;
+
+// representa el estado de una banda de preparacion. son los campos que la
+// banda escribe en cada orden, asi que cada banda tiene su propia linea.
+// la banda es la unica que los escribe y los publica bajo seq para que la
+// interfaz lea una foto consistente sin frenarla. command es de la interfaz;
+// la banda pausada duerme en control hasta que cambie
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) SeqLock seq;
     BeltStatus status;
     unsigned int burgers_processed;
     unsigned int current_order_id;
-    bool running;
+    unsigned int orders_stolen;   // ordenes robadas a otras bandas (modo hilos)
+    unsigned int batches;         // lotes tomados del despachador
+    unsigned int batched_orders;  // ordenes que trajeron esos lotes
+    unsigned int stage_items;     // partes de etapa preparadas (modo pipeline)
+    _Atomic uint32_t command;     // BeltCommand
+    EventCount control;
+    // ordenes en la banda (ingredientes ya reservados): el ultimo lote y
+    // cuantas de el ya termino. si la banda muere a mitad de un lote, la
+    // que la reemplaza termina las que faltan
+    _Atomic uint32_t inflight_count;
+    _Atomic uint32_t inflight_done;
+    BurgerOrder inflight[MAX_BATCH_SIZE];
+    // casillas de la ventana de despacho que la banda tiene tomadas
+    // (asignadas o reclamadas, sin soltar ni publicar) y, de esas, las que
+    // ya tienen su orden copiada. si la banda muere a mitad de un despacho,
+    // la que la reemplaza las devuelve (dispatcher_recover)
+    _Atomic uint32_t window_held;
+    _Atomic uint32_t window_filled;
 } PreparationBelt;
 
-// cola circular para las ordenes en espera
+// foto consistente de una banda (la arma la interfaz)
 typedef struct {
-    BurgerOrder orders[MAX_ORDERS_IN_QUEUE];
-    int head;
-    int tail;
-    int count;
-    pthread_mutex_t mutex;
+    BeltStatus status;
+    unsigned int burgers_processed;
+    unsigned int current_order_id;
+    unsigned int orders_stolen;
+    unsigned int batches;
+    unsigned int batched_orders;
+    BeltCommand command;
+} BeltSnapshot;
+
+static inline void belt_set_state(PreparationBelt *belt, BeltStatus status, unsigned int order_id)
+{
+    seqlock_write_begin(&belt->seq);
+    belt->status = status;
+    belt->current_order_id = order_id;
+    seqlock_write_end(&belt->seq);
+}
+
+static inline void belt_count_processed(PreparationBelt *belt)
+{
+    seqlock_write_begin(&belt->seq);
+    belt->burgers_processed++;
+    seqlock_write_end(&belt->seq);
+}
+
+static inline void belt_count_stolen(PreparationBelt *belt)
+{
+    seqlock_write_begin(&belt->seq);
+    belt->orders_stolen++;
+    seqlock_write_end(&belt->seq);
+}
+
+static inline void belt_count_stage_item(PreparationBelt *belt)
+{
+    seqlock_write_begin(&belt->seq);
+    belt->stage_items++;
+    seqlock_write_end(&belt->seq);
+}
+
+static inline void belt_count_batch(PreparationBelt *belt, int orders)
+{
+    seqlock_write_begin(&belt->seq);
+    belt->batches++;
+    belt->batched_orders += orders;
+    seqlock_write_end(&belt->seq);
+}
+
+static inline void belt_snapshot(const PreparationBelt *belt, BeltSnapshot *out)
+{
+    uint32_t v;
+    do
+    {
+        v = seqlock_read_begin(&belt->seq);
+        out->status = belt->status;
+        out->burgers_processed = belt->burgers_processed;
+        out->current_order_id = belt->current_order_id;
+        out->orders_stolen = belt->orders_stolen;
+        out->batches = belt->batches;
+        out->batched_orders = belt->batched_orders;
+    } while (seqlock_read_retry(&belt->seq, v));
+    out->command = atomic_load_explicit(&belt->command, memory_order_relaxed);
+}
+
+// casilla de la cola: el numero de secuencia indica si la casilla esta
+// libre para el productor de la vuelta actual o lista para el consumidor.
+// la orden viaja empaquetada (las otras marcas de tiempo las pone la banda),
+// asi caben dos casillas por linea de cache
+typedef struct {
+    _Atomic uint64_t seq;
+    PackedOrder order;
+    _Atomic uint64_t enqueued_ns;   // atomico: los consumidores lo miran para elegir carril
+} OrderSlot;
+
+_Static_assert(sizeof(OrderSlot) == 32, "OrderSlot debe medir 32 bytes");
+
+// histogramas de latencia de una banda (solo los escribe esa banda)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) LatencyHistogram queue_wait;    // espera en la cola (desencolado - encolado)
+    LatencyHistogram service;       // tiempo en la banda (terminada - desencolado)
+    LatencyHistogram total;         // latencia de punta a punta
+    LatencyHistogram lateness[ORDER_CLASSES];   // retraso sobre el plazo por clase (0: a tiempo)
+    _Atomic uint64_t missed[ORDER_CLASSES];     // ordenes terminadas fuera de plazo
+    _Atomic uint64_t consumed[MAX_INGREDIENTS]; // unidades de cada ingrediente en las ordenes terminadas
+} BeltMetrics;
+
+// un carril de la cola: el anillo de una clase de prioridad. sus
+// posiciones de encolado y desencolado van en lineas de cache distintas
+// para que productores y consumidores no se estorben. slots_offset es la
+// distancia desde la propia cola, valida en cualquier proceso
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t dequeue_pos;
+    size_t slots_offset;
+    uint64_t slack_ns;            // plazo prometido de la clase
+} OrderLane;
+
+// cola sin bloqueos para varios productores y consumidores: un anillo con
+// casillas numeradas por clase de prioridad (un solo carril si todas las
+// ordenes son estandar). al sacar se elige, entre las cabezas de los
+// carriles, la de plazo mas cercano (edf) o la que llego primero; como el
+// plazo de una clase es fijo, cada carril ya esta ordenado por plazo y
+// basta con mirar las cabezas. solo se duerme en un futex cuando la cola
+// esta vacia o llena. las casillas viven fuera de la estructura (su numero
+// se decide al arrancar)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) EventCount not_empty;
+    EventCount not_full;
+    uint32_t capacity;            // casillas de cada carril
+    uint32_t num_lanes;
+    bool edf;
+    OrderLane lanes[ORDER_CLASSES];
 } OrderQueue;
 
+// casilla de la ventana de despacho. los campos atomicos se leen sin
+// reclamar la casilla (solo para elegir candidata); la orden completa
+// solo se lee despues de reclamarla
+typedef struct {
+    _Atomic uint64_t needs[2];    // copia de la orden empaquetada, para descartar sin reclamar
+    _Atomic uint32_t skips;       // ordenes mas nuevas despachadas antes que esta
+    _Atomic uint64_t rank_ns;     // llegada a la cola o, con edf, plazo (menor = primero)
+    BurgerOrder order;
+} WindowSlot;
+
+// ventana de despacho: las ordenes mas antiguas de la cola que esperan
+// ingredientes. se maneja con dos mascaras de bits atomicas: used marca
+// las casillas asignadas y ready las que se pueden reclamar para despachar
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t used;
+    _Atomic uint32_t ready;
+    WindowSlot slots[MAX_DISPATCH_WINDOW];
+} DispatchWindow;
+
+// casilla de una cola entre etapas: a diferencia de OrderSlot lleva la
+// orden completa, porque ya tiene las marcas de tiempo de la cola y del
+// despacho
+typedef struct {
+    _Atomic uint64_t seq;
+    BurgerOrder order;
+} StageSlot;
+
+// cola acotada entre dos etapas del pipeline (varios productores y
+// consumidores, el mismo anillo con casillas numeradas que OrderQueue). su
+// tamano maximo es fijo, asi vive dentro de SharedSystemState
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t dequeue_pos;
+    _Alignas(CACHE_LINE_SIZE) EventCount not_empty;
+    EventCount not_full;
+    uint32_t capacity;
+    StageSlot slots[STAGE_QUEUE_LIMIT];
+} StageQueue;
+
+// una etapa del pipeline en la memoria compartida. los contadores los
+// escriben todos los trabajadores de la etapa, una vez por orden. input es
+// la cola que la alimenta (la primera etapa toma del despachador)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t processed;
+    _Atomic uint64_t busy_ns;     // tiempo de preparacion sumado de sus trabajadores
+    _Atomic uint32_t depth_max;   // mayor profundidad vista de input
+    StageQueue input;
+} PipelineStage;
+
+// etapa del pipeline elegida por linea de comandos
+typedef struct {
+    char name[16];
+    int workers;
+    int service_time_us;          // -1: la parte que le toca de --service-us
+} StageConfig;
+
+// reposicion automatica (--auto-restock)
+typedef struct {
+    bool enabled;
+    int lead_time_ms;             // lo que tarda en llegar un pedido al proveedor
+    int batch;                    // unidades por pedido (se piden lotes enteros)
+} RestockConfig;
+
+// lo que publica el proceso de reposicion (un solo escritor) para el
+// reporte, la interfaz y burger_stat
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t orders;     // pedidos hechos
+    _Atomic uint64_t units;                                // unidades repuestas
+    _Atomic uint64_t stall_ns;                             // banda-ns con bandas paradas por ingredientes
+    _Atomic uint64_t stall_ns_avoided;                     // banda-ns que sin reponer estarian parados (proyeccion)
+    _Atomic uint32_t rate_milli[MAX_INGREDIENTS];          // demanda estimada en milesimas de unidad/s
+    _Atomic int64_t depletion_ms[MAX_INGREDIENTS];         // se agota en (-1: sin demanda)
+    _Atomic uint32_t in_transit[MAX_INGREDIENTS];          // unidades pedidas que no llegaron
+} RestockStats;
+
+// parametros de ejecucion elegidos por linea de comandos
+typedef struct {
+    bool headless;                // sin interfaz ncurses (modo benchmark)
+    LogLevel log_level;           // nivel inicial del registro de eventos
+    char log_path[256];           // archivo del registro ("-": salida estandar)
+    char journal_path[256];       // diario de escritura anticipada ("" sin diario)
+    unsigned int journal_records; // capacidad del anillo del diario
+    unsigned int journal_sync_ms; // intervalo del commit en grupo (msync)
+    int service_time_us;          // tiempo de preparacion de cada orden
+    int arrival_time_us;          // tiempo entre ordenes (-1: aleatorio de 1 a 3 s)
+    unsigned int run_seconds;     // duracion de la corrida (0: sin limite)
+    unsigned int max_orders;      // ordenes a completar (0: sin limite)
+    int dispatch_window;          // ordenes de la cabeza de la cola que se examinan (1: FIFO estricto)
+    int aging_limit;              // veces que una orden puede ser adelantada antes de bloquear a las demas
+    int batch_size;               // maximo de ordenes por lote del despachador (1: de a una)
+    bool threaded_belts;          // bandas como hilos de un solo proceso (con robo de trabajo)
+    ArrivalConfig arrival;        // proceso de llegadas del generador
+    uint64_t seed;                // semilla del generador (0: hora y pid)
+    char record_path[256];        // graba las ordenes generadas en esta traza ("" no graba)
+    char replay_path[256];        // reproduce las ordenes de esta traza ("" genera)
+    bool replay_fast;             // reproduce sin respetar los tiempos de llegada grabados
+    AffinityConfig affinity;      // cpus de las bandas, el generador y la interfaz
+    int num_stages;               // etapas del pipeline (0: cada banda prepara la orden entera)
+    StageConfig stages[MAX_STAGES];
+    int stage_queue_capacity;     // casillas de cada cola entre etapas
+    int class_mix[ORDER_CLASSES];           // porcentaje de las ordenes de cada clase
+    uint64_t class_deadline_us[ORDER_CLASSES];  // plazo prometido de cada clase desde la llegada
+    bool edf;                     // despacha primero el plazo mas cercano (si no, la llegada)
+    RestockConfig restock;        // reposicion automatica
+} SystemConfig;
+
+// contadores de la corrida que escribe el generador (un solo escritor,
+// que los publica bajo seq)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) SeqLock seq;
+    _Atomic uint64_t orders_generated;
+    _Atomic uint64_t depth_samples;
+    _Atomic uint64_t depth_sum;
+    _Atomic uint32_t depth_max;
+    _Atomic uint64_t orders_dropped;     // llegaron con la cola llena y se descartaron
+    _Atomic uint64_t orders_backlogged;  // llegaron con la cola llena y esperaron en el generador
+    _Atomic uint32_t backlog_max;        // mayor espera local del generador
+    _Atomic uint32_t backlog_depth;      // ordenes en la espera local ahora
+} RunStats;
+
+// cabecera del segmento: describe donde empieza cada arreglo cuyo tamano
+// se decide al arrancar. los desplazamientos son desde el inicio del
+// segmento, asi que valen aunque cada proceso lo mapee en otra direccion
+#define SHM_MAGIC 0x42555247u   // "BURG"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t belt_capacity;       // casillas de banda reservadas en el segmento
+    uint32_t queue_capacity;      // casillas de la cola de ordenes
+    size_t total_size;            // tamano del segmento completo (para mmap)
+    size_t belt_info_offset;      // BeltInfo[belt_capacity]
+    size_t belts_offset;          // PreparationBelt[belt_capacity]
+    size_t belt_metrics_offset;   // BeltMetrics[belt_capacity]
+    size_t queue_slots_offset;    // OrderSlot[queue_capacity]
+    uint32_t log_rings;           // anillos de registro (0: modo silencioso)
+    size_t log_rings_offset;      // LogRing[log_rings]
+} SegmentLayout;
 
 // estructura principal que se aloja en la memoria compartida
 // contiene todo el estado del sistema
+//
+// se ordena de lo frio a lo caliente: primero lo que casi solo se lee
+// (bandera de ejecucion, configuracion, nombres y pids) y despues, cada uno
+// alineado a su propia linea de cache, lo que se escribe en cada orden
+// (contadores del generador, inventario, estado de cada banda, cola)
+//
+// los arreglos por banda y las casillas de la cola van despues de esta
+// estructura, en el mismo segmento, y se llega a ellos con layout
 typedef struct {
-    bool system_running;
-    Ingredient ingredients[MAX_INGREDIENTS];
-    PreparationBelt belts[MAX_BELTS];
+    // --- datos frios / de solo lectura durante la corrida ---
+    SegmentLayout layout;
+    atomic_bool system_running;
     int num_belts;
+    SystemConfig config;
+    IngredientInfo ingredient_info[MAX_INGREDIENTS];
+    LogControl log;
+    unsigned int order_id_base;   // ids ya usados por la corrida recuperada del diario
+
+    // --- datos calientes ---
+    RunStats stats;
+    Inventory inventory;
     OrderQueue waiting_orders;
+    DispatchWindow dispatch_window;
+    PipelineStage pipeline[MAX_STAGES];
+    RestockStats restock;
 
-    // semaforo para ordenes disponibles
-    sem_t sem_orders_available;
+} SharedSystemState;
 
-    // semaforo para espacios disponibles en la cola
-    sem_t sem_space_available;
+// comprobaciones estaticas de la distribucion: cada elemento caliente debe
+// empezar en su propia linea de cache y ocupar lineas completas
+#define ASSERT_CACHE_ALIGNED(type, member) \
+    _Static_assert(offsetof(type, member) % CACHE_LINE_SIZE == 0, #type "." #member " no esta alineado a linea de cache")
+#define ASSERT_WHOLE_LINES(type) \
+    _Static_assert(sizeof(type) % CACHE_LINE_SIZE == 0, #type " no ocupa lineas de cache completas")
 
-} SharedSystemState;
+ASSERT_WHOLE_LINES(Ingredient);
+ASSERT_WHOLE_LINES(PreparationBelt);
+ASSERT_WHOLE_LINES(BeltMetrics);
+ASSERT_WHOLE_LINES(RunStats);
+ASSERT_WHOLE_LINES(PipelineStage);
+ASSERT_WHOLE_LINES(RestockStats);
+ASSERT_CACHE_ALIGNED(OrderLane, enqueue_pos);
+ASSERT_CACHE_ALIGNED(OrderLane, dequeue_pos);
+ASSERT_CACHE_ALIGNED(OrderQueue, lanes);
+ASSERT_CACHE_ALIGNED(SharedSystemState, stats);
+ASSERT_CACHE_ALIGNED(Inventory, shelf);
+ASSERT_CACHE_ALIGNED(Inventory, reserve);
+ASSERT_CACHE_ALIGNED(Inventory, locked);
+ASSERT_CACHE_ALIGNED(SharedSystemState, inventory);
+ASSERT_CACHE_ALIGNED(SharedSystemState, waiting_orders);
+ASSERT_CACHE_ALIGNED(SharedSystemState, dispatch_window);
+ASSERT_CACHE_ALIGNED(SharedSystemState, pipeline);
+ASSERT_CACHE_ALIGNED(SharedSystemState, restock);
+ASSERT_CACHE_ALIGNED(StageQueue, dequeue_pos);
+ASSERT_CACHE_ALIGNED(StageQueue, not_empty);
 
 
 // nombre para el segmento de memoria compartida
 #define SHM_NAME "/burger_machine_shm"
 
+// arreglos de tamano variable del segmento
+static inline BeltInfo *state_belt_info(SharedSystemState *state, int i)
+{
+    return (BeltInfo *)((char *)state + state->layout.belt_info_offset) + i;
+}
+
+static inline PreparationBelt *state_belt(SharedSystemState *state, int i)
+{
+    return (PreparationBelt *)((char *)state + state->layout.belts_offset) + i;
+}
+
+static inline BeltMetrics *state_belt_metrics(SharedSystemState *state, int i)
+{
+    return (BeltMetrics *)((char *)state + state->layout.belt_metrics_offset) + i;
+}
+
+static inline LogRing *state_log_ring(SharedSystemState *state, int i)
+{
+    return (LogRing *)((char *)state + state->layout.log_rings_offset) + i;
+}
+
+// fuente de los eventos del generador (las bandas usan su numero)
+#define LOG_GENERATOR (-1)
+
+// registra un evento en el anillo de source si el nivel actual lo pide. con
+// el nivel por debajo cuesta una lectura relajada de una linea que casi
+// nunca se escribe. cada anillo tiene un unico productor: la banda source
+// (su proceso o su hilo) o el generador
+static inline void log_event(SharedSystemState *state, int source, LogLevel level, LogEvent event,
+                             uint32_t a, uint32_t b)
+{
+    if ((int)level > atomic_load_explicit(&state->log.level, memory_order_relaxed))
+        return;
+    int ring = source < 0 ? state->num_belts : source;
+    log_ring_push(state_log_ring(state, ring), level, event, a, b, now_ns());
+}
+
+// funciones auxiliares sobre el estado compartido (shared_state.c)
+
+// crea el segmento (borrando uno anterior con el mismo nombre) con lugar para
+// belt_capacity bandas, una cola de queue_capacity ordenes y log_rings
+// anillos de registro. lo deja en cero salvo la cabecera. devuelve NULL si falla
+SharedSystemState *shm_create(const char *name, int belt_capacity, uint32_t queue_capacity, uint32_t log_rings);
+
+#define DEFAULT_HUGETLB_DIR "/dev/hugepages"
+
+// como se respalda el segmento. el padre lo fija antes de shm_create y los
+// hijos lo heredan con fork, asi shm_attach abre el mismo archivo
+typedef struct {
+    char hugetlb_dir[256];        // montaje de hugetlbfs ("": /dev/shm con paginas normales)
+    bool prefault;                // MAP_POPULATE al mapear y mlock en el padre
+} SegmentOptions;
+
+void shm_set_options(const SegmentOptions *options);
+
+// tamano de pagina con que quedo mapeado el segmento (0 antes de crearlo)
+size_t shm_page_size(void);
+
+// borra el segmento (en /dev/shm o en hugetlbfs)
+void shm_remove(const char *name);
+
+// igual que shm_create pero en memoria privada de este proceso (para la
+// simulacion, que no comparte el estado con nadie ni registra eventos). se
+// libera con shm_detach
+SharedSystemState *state_create_private(int belt_capacity, uint32_t queue_capacity);
+
+// se conecta a un segmento existente leyendo primero su cabecera para saber
+// cuanto mapear. devuelve NULL si falla o si no es un segmento valido
+SharedSystemState *shm_attach(const char *name);
+void shm_detach(SharedSystemState *state);
+
+// fusiona los histogramas de todas las bandas en out
+void belt_metrics_merge_all(SharedSystemState *state, BeltMetrics *out);
+
+// arma una orden con los ingredientes de siempre (pan y carne mas opcionales
+// al azar) usando el generador pseudoaleatorio rng
+void order_build_random(BurgerOrder *order, unsigned int order_id, uint64_t *rng);
+
+// unidades de cada ingrediente que pide en promedio una orden de
+// order_build_random
+void order_expected_needs(double out[MAX_INGREDIENTS]);
+
+// elige la clase de la orden segun config->class_mix (sin mezcla, la
+// estandar y sin gastar numeros de rng: las corridas con semilla no cambian)
+void order_assign_class(BurgerOrder *order, const SystemConfig *config, uint64_t *rng);
+
+// carriles de la cola de ordenes que usa la configuracion (1 sin mezcla)
+int order_queue_lanes_for(const SystemConfig *config);
+
+// nombre de una clase de prioridad
+const char *order_class_name(int order_class);
+
+// resume un histograma como "p50 .. p99 .. p999 .."
+void latency_summary(const LatencyHistogram *h, char *buf, size_t len);
+
 #endif 
\ No newline at end of file
@@ -0,0 +1,297 @@
+// File: shared_state.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <fcntl.h>
+
+#include "shared_data.h"
+#include "packed_order.h"
+
+static SegmentOptions segment_options;
+static size_t segment_page_size = 0;
+
+void shm_set_options(const SegmentOptions *options)
+{
+    segment_options = *options;
+}
+
+size_t shm_page_size(void)
+{
+    return segment_page_size;
+}
+
+// con hugetlbfs el segmento es un archivo en ese montaje; si no, un objeto
+// de /dev/shm. name empieza con '/'
+static int segment_open(const char *name, int flags, mode_t mode)
+{
+    if (segment_options.hugetlb_dir[0] == '\0')
+        return shm_open(name, flags, mode);
+    char path[sizeof(segment_options.hugetlb_dir) + 64];
+    snprintf(path, sizeof(path), "%s%s", segment_options.hugetlb_dir, name);
+    return open(path, flags, mode);
+}
+
+void shm_remove(const char *name)
+{
+    if (segment_options.hugetlb_dir[0] == '\0')
+    {
+        shm_unlink(name);
+        return;
+    }
+    char path[sizeof(segment_options.hugetlb_dir) + 64];
+    snprintf(path, sizeof(path), "%s%s", segment_options.hugetlb_dir, name);
+    unlink(path);
+}
+
+static int map_flags(void)
+{
+    return MAP_SHARED | (segment_options.prefault ? MAP_POPULATE : 0);
+}
+
+static size_t round_up_line(size_t n)
+{
+    return (n + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+// reparte el segmento: la estructura fija y detras cada arreglo variable,
+// todos empezando en su propia linea de cache
+static void compute_layout(SegmentLayout *layout, int belt_capacity, uint32_t queue_capacity, uint32_t log_rings)
+{
+    size_t offset = round_up_line(sizeof(SharedSystemState));
+    layout->magic = SHM_MAGIC;
+    layout->belt_capacity = belt_capacity;
+    layout->queue_capacity = queue_capacity;
+    layout->belt_info_offset = offset;
+    offset = round_up_line(offset + sizeof(BeltInfo) * belt_capacity);
+    layout->belts_offset = offset;
+    offset = round_up_line(offset + sizeof(PreparationBelt) * belt_capacity);
+    layout->belt_metrics_offset = offset;
+    offset = round_up_line(offset + sizeof(BeltMetrics) * belt_capacity);
+    layout->queue_slots_offset = offset;
+    offset = round_up_line(offset + sizeof(OrderSlot) * queue_capacity);
+    layout->log_rings = log_rings;
+    layout->log_rings_offset = offset;
+    offset = round_up_line(offset + sizeof(LogRing) * log_rings);
+    layout->total_size = offset;
+}
+
+static SharedSystemState *segment_create(const char *name, SegmentLayout layout)
+{
+    shm_remove(name);
+    int fd = segment_open(name, O_CREAT | O_RDWR, 0666);
+    if (fd == -1)
+    {
+        perror(segment_options.hugetlb_dir[0] != '\0' ? segment_options.hugetlb_dir : "shm_open");
+        return NULL;
+    }
+    // en hugetlbfs el tamano del mapeo va en paginas enormes (el tamano de
+    // bloque del montaje)
+    segment_page_size = sysconf(_SC_PAGESIZE);
+    struct statfs fs;
+    if (segment_options.hugetlb_dir[0] != '\0' && fstatfs(fd, &fs) == 0)
+    {
+        segment_page_size = fs.f_bsize;
+        layout.total_size = (layout.total_size + segment_page_size - 1) & ~(segment_page_size - 1);
+    }
+    if (ftruncate(fd, layout.total_size) == -1)
+    {
+        perror("ftruncate");
+        close(fd);
+        shm_remove(name);
+        return NULL;
+    }
+    // sin paginas enormes reservadas el mapeo falla aqui y no en el primer acceso
+    SharedSystemState *state = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, map_flags(), fd, 0);
+    close(fd);
+    if (state == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_remove(name);
+        return NULL;
+    }
+    if (segment_options.hugetlb_dir[0] == '\0')
+    {
+        // paginas enormes transparentes, si el kernel las da para shmem
+        madvise(state, layout.total_size, MADV_HUGEPAGE);
+    }
+    // el padre lo toca primero: con --numa-node las paginas quedan en ese nodo
+    memset(state, 0, layout.total_size);
+    if (segment_options.prefault && mlock(state, layout.total_size) == -1)
+    {
+        perror("mlock (el segmento queda sin fijar en memoria)");
+    }
+    state->layout = layout;
+    return state;
+}
+
+SharedSystemState *shm_create(const char *name, int belt_capacity, uint32_t queue_capacity, uint32_t log_rings)
+{
+    SegmentLayout layout;
+    compute_layout(&layout, belt_capacity, queue_capacity, log_rings);
+
+    SharedSystemState *state = segment_create(name, layout);
+    if (state == NULL && segment_options.hugetlb_dir[0] != '\0')
+    {
+        // sin montaje o sin paginas enormes reservadas seguimos con /dev/shm;
+        // los hijos heredan las opciones ya corregidas
+        fprintf(stderr, "shm_create: sin paginas enormes en %s, se usa /dev/shm\n", segment_options.hugetlb_dir);
+        segment_options.hugetlb_dir[0] = '\0';
+        state = segment_create(name, layout);
+    }
+    return state;
+}
+
+SharedSystemState *state_create_private(int belt_capacity, uint32_t queue_capacity)
+{
+    SegmentLayout layout;
+    compute_layout(&layout, belt_capacity, queue_capacity, 0);
+    // memoria anonima: el kernel ya la entrega en cero
+    SharedSystemState *state = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (state == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    state->layout = layout;
+    return state;
+}
+
+SharedSystemState *shm_attach(const char *name)
+{
+    int fd = segment_open(name, O_RDWR, 0666);
+    if (fd == -1)
+    {
+        perror("shm_open");
+        return NULL;
+    }
+    // primero solo la cabecera, para saber el tamano real del segmento
+    SegmentLayout layout;
+    if (pread(fd, &layout, sizeof(layout), offsetof(SharedSystemState, layout)) != (ssize_t)sizeof(layout) ||
+        layout.magic != SHM_MAGIC)
+    {
+        fprintf(stderr, "shm_attach: %s no es un segmento valido\n", name);
+        close(fd);
+        return NULL;
+    }
+    // con prefault cada proceso arma sus tablas de paginas ahora y no con
+    // fallos de pagina en el camino de las ordenes
+    SharedSystemState *state = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, map_flags(), fd, 0);
+    close(fd);
+    if (state == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+    return state;
+}
+
+void shm_detach(SharedSystemState *state)
+{
+    munmap(state, state->layout.total_size);
+}
+
+void belt_metrics_merge_all(SharedSystemState *state, BeltMetrics *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < state->num_belts; i++)
+    {
+        BeltMetrics *metrics = state_belt_metrics(state, i);
+        hist_merge(&out->queue_wait, &metrics->queue_wait);
+        hist_merge(&out->service, &metrics->service);
+        hist_merge(&out->total, &metrics->total);
+        for (int c = 0; c < ORDER_CLASSES; c++)
+        {
+            hist_merge(&out->lateness[c], &metrics->lateness[c]);
+            atomic_fetch_add_explicit(&out->missed[c], atomic_load_explicit(&metrics->missed[c], memory_order_relaxed),
+                                      memory_order_relaxed);
+        }
+        for (int k = 0; k < MAX_INGREDIENTS; k++)
+            atomic_fetch_add_explicit(&out->consumed[k], atomic_load_explicit(&metrics->consumed[k], memory_order_relaxed),
+                                      memory_order_relaxed);
+    }
+}
+
+void latency_summary(const LatencyHistogram *h, char *buf, size_t len)
+{
+    char p50[16], p99[16], p999[16];
+    hist_format_ns(p50, sizeof(p50), hist_percentile(h, 50.0));
+    hist_format_ns(p99, sizeof(p99), hist_percentile(h, 99.0));
+    hist_format_ns(p999, sizeof(p999), hist_percentile(h, 99.9));
+    snprintf(buf, len, "p50 %-8s p99 %-8s p999 %-8s", p50, p99, p999);
+}
+
+// receta de order_build_random: los ingredientes base que toda hamburguesa
+// lleva y la probabilidad (en %) de cada opcional
+static const uint8_t recipe_base[CHEESE + 1] = {[BUN] = 2, [PATTY] = 1};
+static const int recipe_optional_pct[CHEESE + 1] = {[LETTUCE] = 80, [TOMATO] = 70, [ONION] = 60, [CHEESE] = 90};
+
+void order_build_random(BurgerOrder *order, unsigned int order_id, uint64_t *rng)
+{
+    order->order_id = order_id;
+    for (int i = BUN; i <= CHEESE; i++)
+    {
+        // los opcionales se anaden con cierta probabilidad
+        if (recipe_optional_pct[i] > 0)
+            order->ingredients_needed[i] = (rng_next(rng) % 100 < (uint64_t)recipe_optional_pct[i]) ? 1 : 0;
+        else
+            order->ingredients_needed[i] = recipe_base[i];
+    }
+
+    // nos aseguramos de que los demas ingredientes esten en cero
+    for (int i = CHEESE + 1; i < MAX_INGREDIENTS; i++)
+    {
+        order->ingredients_needed[i] = 0;
+    }
+    packed_update_mask(&order->packed);
+
+    order->enqueued_ns = 0;
+    order->dequeued_ns = 0;
+    order->completed_ns = 0;
+    order->deadline_ns = 0;
+    order->priority = ORDER_STANDARD;
+}
+
+void order_expected_needs(double out[MAX_INGREDIENTS])
+{
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+        out[i] = 0.0;
+    for (int i = BUN; i <= CHEESE; i++)
+        out[i] = recipe_optional_pct[i] > 0 ? recipe_optional_pct[i] / 100.0 : recipe_base[i];
+}
+
+int order_queue_lanes_for(const SystemConfig *config)
+{
+    for (int c = 1; c < ORDER_CLASSES; c++)
+    {
+        if (config->class_mix[c] > 0)
+            return ORDER_CLASSES;
+    }
+    return 1;
+}
+
+void order_assign_class(BurgerOrder *order, const SystemConfig *config, uint64_t *rng)
+{
+    order->priority = ORDER_STANDARD;
+    if (order_queue_lanes_for(config) == 1)
+        return;
+    int roll = (int)(rng_next(rng) % 100);
+    for (int c = 0; c < ORDER_CLASSES; c++)
+    {
+        roll -= config->class_mix[c];
+        if (roll < 0)
+        {
+            order->priority = c;
+            return;
+        }
+    }
+}
+
+const char *order_class_name(int order_class)
+{
+    static const char *names[ORDER_CLASSES] = {"standard", "premium", "walkin"};
+    return order_class >= 0 && order_class < ORDER_CLASSES ? names[order_class] : "?";
+}
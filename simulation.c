@@ -0,0 +1,412 @@
+// File: simulation.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "simulation.h"
+#include "order_queue.h"
+#include "dispatcher.h"
+#include "arrival.h"
+#include "trace.h"
+#include "belt.h"
+#include "restocker.h"
+#include "clock_utils.h"
+
+typedef enum {
+    EV_ARRIVAL,        // llega una orden del generador
+    EV_SERVICE_DONE,   // una banda termina su orden
+    EV_RESTOCK         // vuelta de la reposicion automatica
+} SimEventType;
+
+typedef struct {
+    uint64_t time;     // instante virtual en ns
+    uint64_t seq;      // desempate: a igual instante, en orden de creacion
+    SimEventType type;
+    int belt;
+} SimEvent;
+
+// cola de prioridad de eventos (monticulo binario por tiempo)
+typedef struct {
+    SimEvent *items;
+    size_t count;
+    size_t capacity;
+    uint64_t next_seq;
+} EventHeap;
+
+typedef struct {
+    SharedSystemState *state;
+    const SystemConfig *config;
+    EventHeap events;
+    uint64_t now;
+    uint64_t rng;
+
+    // generador: lazo abierto (reloj del perfil o traza con sus tiempos) o
+    // lazo cerrado (espera fija o aleatoria y se bloquea con la cola llena)
+    bool open_loop;
+    ArrivalClock clock;
+    TraceReader trace;
+    bool replaying;
+    uint64_t trace_next;
+    unsigned int order_counter;
+    bool generator_blocked;         // lazo cerrado: orden esperando lugar
+    BurgerOrder blocked_order;
+
+    // espera local del lazo abierto (crece segun haga falta)
+    BurgerOrder *backlog;
+    size_t backlog_head;
+    size_t backlog_count;
+    size_t backlog_capacity;
+
+    BurgerOrder *in_service;        // orden en cada banda
+    int *idle_belts;                // pila de bandas libres
+    int idle_count;
+    uint64_t service_ns;
+    uint64_t events_processed;
+    RestockEngine restock;          // con --auto-restock
+} Simulation;
+
+static bool event_before(const SimEvent *a, const SimEvent *b)
+{
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void heap_push(EventHeap *h, uint64_t time, SimEventType type, int belt)
+{
+    if (h->count == h->capacity)
+    {
+        h->capacity = h->capacity ? h->capacity * 2 : 64;
+        h->items = realloc(h->items, h->capacity * sizeof(SimEvent));
+        if (h->items == NULL)
+        {
+            perror("realloc (eventos)");
+            exit(1);
+        }
+    }
+    SimEvent ev = {time, h->next_seq++, type, belt};
+    size_t i = h->count++;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!event_before(&ev, &h->items[parent]))
+            break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = ev;
+}
+
+static SimEvent heap_pop(EventHeap *h)
+{
+    SimEvent top = h->items[0];
+    SimEvent last = h->items[--h->count];
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= h->count)
+            break;
+        if (child + 1 < h->count && event_before(&h->items[child + 1], &h->items[child]))
+            child++;
+        if (!event_before(&h->items[child], &last))
+            break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->count > 0)
+        h->items[i] = last;
+    return top;
+}
+
+// --- generador ---
+
+static bool arrivals_done(const Simulation *sim)
+{
+    if (sim->config->max_orders > 0 && sim->order_counter >= sim->config->max_orders)
+        return true;
+    return sim->replaying && sim->trace_next >= sim->trace.count;
+}
+
+// espera del generador de lazo cerrado entre una orden y la siguiente
+static uint64_t closed_loop_gap(Simulation *sim)
+{
+    if (sim->replaying)
+        return 0;
+    if (sim->config->arrival_time_us < 0)
+        return ((rng_next(&sim->rng) % 3) + 1) * 1000000000ull;
+    return (uint64_t)sim->config->arrival_time_us * 1000;
+}
+
+static void schedule_next_arrival(Simulation *sim)
+{
+    if (arrivals_done(sim))
+        return;
+    uint64_t t;
+    if (!sim->open_loop)
+        t = sim->now + closed_loop_gap(sim);
+    else if (sim->replaying)
+        t = sim->trace.records[sim->trace_next].arrival_offset_ns;
+    else
+        t = arrival_clock_advance(&sim->clock);
+    heap_push(&sim->events, t, EV_ARRIVAL, -1);
+}
+
+static void next_order(Simulation *sim, BurgerOrder *order)
+{
+    ++sim->order_counter;
+    if (sim->replaying)
+        trace_record_to_order(&sim->trace.records[sim->trace_next++], order);
+    else
+    {
+        order_build_random(order, sim->order_counter, &sim->rng);
+        order_assign_class(order, sim->config, &sim->rng);
+    }
+    order->enqueued_ns = sim->now;
+}
+
+static void backlog_push(Simulation *sim, const BurgerOrder *order)
+{
+    if (sim->backlog_count == sim->backlog_capacity)
+    {
+        // duplicamos el anillo y lo dejamos empezando en cero
+        size_t capacity = sim->backlog_capacity ? sim->backlog_capacity * 2 : 1024;
+        BurgerOrder *grown = malloc(capacity * sizeof(BurgerOrder));
+        if (grown == NULL)
+        {
+            perror("malloc (backlog)");
+            exit(1);
+        }
+        for (size_t i = 0; i < sim->backlog_count; i++)
+            grown[i] = sim->backlog[(sim->backlog_head + i) % sim->backlog_capacity];
+        free(sim->backlog);
+        sim->backlog = grown;
+        sim->backlog_head = 0;
+        sim->backlog_capacity = capacity;
+    }
+    sim->backlog[(sim->backlog_head + sim->backlog_count) % sim->backlog_capacity] = *order;
+    sim->backlog_count++;
+}
+
+// mismas cuentas que el generador real en cada llegada
+static void record_arrival(Simulation *sim)
+{
+    RunStats *stats = &sim->state->stats;
+    int depth = dispatcher_pending(sim->state);
+    stats->orders_generated = sim->order_counter;
+    stats->depth_samples++;
+    stats->depth_sum += depth;
+    if ((uint32_t)depth > stats->depth_max)
+        stats->depth_max = depth;
+}
+
+static void handle_arrival(Simulation *sim)
+{
+    RunStats *stats = &sim->state->stats;
+    OrderQueue *q = &sim->state->waiting_orders;
+    BurgerOrder order;
+    next_order(sim, &order);
+
+    if (!sim->open_loop)
+    {
+        // lazo cerrado: si no hay lugar el generador queda bloqueado con la orden
+        if (order_queue_try_push(q, &order))
+            schedule_next_arrival(sim);
+        else
+        {
+            sim->blocked_order = order;
+            sim->generator_blocked = true;
+        }
+    }
+    else
+    {
+        if (sim->backlog_count > 0 || !order_queue_try_push(q, &order))
+        {
+            if (sim->config->arrival.overflow == OVERFLOW_DROP)
+                stats->orders_dropped++;
+            else
+            {
+                backlog_push(sim, &order);
+                stats->orders_backlogged++;
+                stats->backlog_depth = sim->backlog_count;
+                if (sim->backlog_count > stats->backlog_max)
+                    stats->backlog_max = sim->backlog_count;
+            }
+        }
+        schedule_next_arrival(sim);
+    }
+    record_arrival(sim);
+}
+
+// pasa a la cola lo que espera en el generador. devuelve true si paso algo
+static bool refill_queue(Simulation *sim)
+{
+    OrderQueue *q = &sim->state->waiting_orders;
+    bool progress = false;
+    if (sim->generator_blocked && order_queue_try_push(q, &sim->blocked_order))
+    {
+        sim->generator_blocked = false;
+        schedule_next_arrival(sim);
+        progress = true;
+    }
+    while (sim->backlog_count > 0 && order_queue_try_push(q, &sim->backlog[sim->backlog_head]))
+    {
+        sim->backlog_head = (sim->backlog_head + 1) % sim->backlog_capacity;
+        sim->backlog_count--;
+        progress = true;
+    }
+    sim->state->stats.backlog_depth = sim->backlog_count;
+    return progress;
+}
+
+// --- bandas ---
+
+// las bandas libres toman ordenes con el mismo despachador que el modo real.
+// devuelve true si alguna empezo una orden
+static bool dispatch_idle_belts(Simulation *sim)
+{
+    SharedSystemState *state = sim->state;
+    bool progress = false;
+    while (sim->idle_count > 0)
+    {
+        int id = sim->idle_belts[sim->idle_count - 1];
+        BurgerOrder *order = &sim->in_service[id];
+        if (!dispatcher_try_next(state, order))
+            break;
+        sim->idle_count--;
+        PreparationBelt *belt = state_belt(state, id);
+        order->dequeued_ns = sim->now;
+        belt_set_state(belt, PREPARING, order->order_id);
+        heap_push(&sim->events, sim->now + sim->service_ns, EV_SERVICE_DONE, id);
+        progress = true;
+    }
+    return progress;
+}
+
+static void handle_service_done(Simulation *sim, int id)
+{
+    PreparationBelt *belt = state_belt(sim->state, id);
+    BurgerOrder *order = &sim->in_service[id];
+    order->completed_ns = sim->now;
+    belt_record_latency(sim->state, id, order);
+    belt_count_processed(belt);
+    belt_set_state(belt, IDLE, 0);
+    sim->idle_belts[sim->idle_count++] = id;
+}
+
+// --- reposicion ---
+
+// el mismo motor que el proceso de reposicion, con el reloj virtual. las
+// bandas libres con ordenes esperando ingredientes estan paradas y las
+// demas preparan
+static void handle_restock(Simulation *sim)
+{
+    SharedSystemState *state = sim->state;
+    int stalled = dispatcher_blocked_order(state) != 0 ? sim->idle_count : 0;
+    restock_step(&sim->restock, state, sim->now, stalled, state->num_belts - sim->idle_count);
+    // mientras quede algo por hacer; si no, la simulacion terminaria nunca
+    if (sim->events.count > 0 || dispatcher_pending(state) > 0 || restock_in_transit(&sim->restock))
+        heap_push(&sim->events, sim->now + RESTOCK_INTERVAL_MS * 1000000ull, EV_RESTOCK, -1);
+}
+
+static unsigned long completed_orders(SharedSystemState *state)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < state->num_belts; i++)
+        total += state_belt(state, i)->burgers_processed;
+    return total;
+}
+
+double simulation_run(SharedSystemState *state)
+{
+    const SystemConfig *config = &state->config;
+    Simulation sim;
+    memset(&sim, 0, sizeof(sim));
+    sim.state = state;
+    sim.config = config;
+    sim.service_ns = (uint64_t)config->service_time_us * 1000;
+    sim.rng = config->seed != 0 ? config->seed : ((uint64_t)time(NULL) << 20) ^ (uint64_t)getpid() ^ 0x9E3779B97F4A7C15ull;
+    sim.in_service = calloc(state->num_belts, sizeof(BurgerOrder));
+    sim.idle_belts = malloc(state->num_belts * sizeof(int));
+    if (sim.in_service == NULL || sim.idle_belts == NULL)
+    {
+        perror("calloc (simulacion)");
+        exit(1);
+    }
+    // todas libres; la banda 0 queda arriba de la pila
+    for (int i = 0; i < state->num_belts; i++)
+        sim.idle_belts[i] = state->num_belts - 1 - i;
+    sim.idle_count = state->num_belts;
+
+    if (config->replay_path[0] != '\0')
+    {
+        if (!trace_reader_open(&sim.trace, config->replay_path))
+            exit(1);
+        sim.replaying = true;
+        sim.open_loop = !config->replay_fast;
+    }
+    else
+    {
+        sim.open_loop = config->arrival.profile != ARRIVAL_CLASSIC;
+        if (sim.open_loop)
+            arrival_clock_init(&sim.clock, &config->arrival, 0, rng_next(&sim.rng));
+    }
+
+    uint64_t end_ns = config->run_seconds > 0 ? (uint64_t)config->run_seconds * 1000000000ull : UINT64_MAX;
+    uint64_t wall_start = now_ns();
+
+    // la primera llegada: el generador real tambien espera antes de la primera orden
+    schedule_next_arrival(&sim);
+    if (config->restock.enabled)
+    {
+        // la primera vuelta en t=0: pide lo que no cubren las existencias iniciales
+        restock_init(&sim.restock, state);
+        heap_push(&sim.events, 0, EV_RESTOCK, -1);
+    }
+    while (sim.events.count > 0)
+    {
+        if (sim.events.items[0].time > end_ns)
+        {
+            sim.now = end_ns;
+            break;
+        }
+        SimEvent ev = heap_pop(&sim.events);
+        sim.now = ev.time;
+        sim.events_processed++;
+        if (ev.type == EV_ARRIVAL)
+            handle_arrival(&sim);
+        else if (ev.type == EV_RESTOCK)
+            handle_restock(&sim);
+        else
+            handle_service_done(&sim, ev.belt);
+
+        // cada evento puede liberar bandas y lugar en la cola; repetimos
+        // hasta que ni las bandas ni el generador puedan avanzar
+        bool progress;
+        do
+        {
+            progress = dispatch_idle_belts(&sim);
+            progress |= refill_queue(&sim);
+        } while (progress);
+
+        if (config->max_orders > 0 && completed_orders(state) + state->stats.orders_dropped >= config->max_orders)
+            break;
+    }
+
+    double wall = (now_ns() - wall_start) / 1e9;
+    printf("[Simulacion] %lu eventos en %.3f s reales (%.0f eventos/s). Tiempo simulado: %.3f s.\n",
+           (unsigned long)sim.events_processed, wall, wall > 0 ? sim.events_processed / wall : 0.0, sim.now / 1e9);
+    if (sim.events.count == 0 && dispatcher_pending(state) > 0)
+    {
+        printf("[Simulacion] Sin mas eventos: %d ordenes esperan ingredientes.\n", dispatcher_pending(state));
+    }
+
+    if (sim.replaying)
+        trace_reader_close(&sim.trace);
+    free(sim.backlog);
+    free(sim.in_service);
+    free(sim.idle_belts);
+    free(sim.events.items);
+    return sim.now / 1e9;
+}
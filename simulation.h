@@ -0,0 +1,16 @@
+// File: simulation.h
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "shared_data.h"
+
+// simulacion de eventos discretos: recorre la misma corrida que los
+// procesos reales (llegadas, despacho con la ventana, inventario,
+// histogramas) pero en un solo proceso y con un reloj virtual que salta de
+// evento en evento, sin dormir. state debe estar inicializado como en el
+// modo real (se puede crear con state_create_private). devuelve la duracion
+// simulada en segundos y deja los resultados en state para el reporte
+double simulation_run(SharedSystemState *state);
+
+#endif
@@ -0,0 +1,96 @@
+// File: stats_segment.c
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "stats_segment.h"
+
+StatsSegment *stats_segment_create(int num_belts, int num_ingredients)
+{
+    size_t size = stats_segment_size(num_belts);
+    shm_unlink(STATS_SHM_NAME);
+    // solo el dueno escribe; cualquiera puede leer
+    int fd = shm_open(STATS_SHM_NAME, O_CREAT | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        perror("shm_open (estadisticas)");
+        return NULL;
+    }
+    if (ftruncate(fd, size) == -1)
+    {
+        perror("ftruncate (estadisticas)");
+        close(fd);
+        shm_unlink(STATS_SHM_NAME);
+        return NULL;
+    }
+    StatsSegment *seg = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+    {
+        perror("mmap (estadisticas)");
+        shm_unlink(STATS_SHM_NAME);
+        return NULL;
+    }
+    memset(seg, 0, size);
+    seg->version = STATS_VERSION;
+    seg->total_size = size;
+    seg->num_belts = num_belts;
+    seg->num_ingredients = num_ingredients;
+    seg->publisher_pid = getpid();
+    // la marca va al final: un lector que la ve ya tiene la cabecera completa
+    atomic_thread_fence(memory_order_release);
+    seg->magic = STATS_MAGIC;
+    return seg;
+}
+
+void stats_segment_destroy(StatsSegment *seg)
+{
+    munmap(seg, seg->total_size);
+    shm_unlink(STATS_SHM_NAME);
+}
+
+const StatsSegment *stats_segment_attach(void)
+{
+    int fd = shm_open(STATS_SHM_NAME, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        perror("shm_open " STATS_SHM_NAME);
+        return NULL;
+    }
+    // primero la cabecera, para saber el tamano real del segmento
+    StatsSegment header;
+    if (pread(fd, &header, offsetof(StatsSegment, seq), 0) != (ssize_t)offsetof(StatsSegment, seq) ||
+        header.magic != STATS_MAGIC || header.version != STATS_VERSION)
+    {
+        fprintf(stderr, "%s no es un segmento de estadisticas valido\n", STATS_SHM_NAME);
+        close(fd);
+        return NULL;
+    }
+    const StatsSegment *seg = mmap(NULL, header.total_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED)
+    {
+        perror("mmap (estadisticas)");
+        return NULL;
+    }
+    return seg;
+}
+
+void stats_segment_detach(const StatsSegment *seg)
+{
+    munmap((void *)seg, seg->total_size);
+}
+
+void stats_segment_snapshot(const StatsSegment *seg, StatsSegment *out)
+{
+    uint32_t v;
+    do
+    {
+        v = seqlock_read_begin(&seg->seq);
+        memcpy(out, seg, seg->total_size);
+    } while (seqlock_read_retry(&seg->seq, v));
+}
@@ -0,0 +1,119 @@
+// File: stats_segment.h
+
+#ifndef STATS_SEGMENT_H
+#define STATS_SEGMENT_H
+
+#include <sys/types.h>
+
+#include "shared_data.h"
+
+// segmento de estadisticas de solo lectura para herramientas externas
+// (burger_stat). lo crea y lo escribe unicamente el proceso principal, que
+// copia ahi una foto del estado cada STATS_PUBLISH_US; los lectores lo mapean
+// con PROT_READ y nunca tocan SharedSystemState, asi que muestrear una
+// corrida no agrega ni una linea de cache compartida con las bandas
+#define STATS_SHM_NAME "/burger_machine_stats"
+#define STATS_MAGIC 0x54415453u   // "STAT"
+#define STATS_VERSION 6
+#define STATS_PUBLISH_US 100000
+// los histogramas se fusionan cada tantas publicaciones (recorrerlos lee
+// lineas que las bandas estan escribiendo)
+#define STATS_HIST_EVERY 10
+
+typedef struct {
+    pid_t pid;
+    uint32_t status;              // BeltStatus
+    uint64_t processed;
+    uint64_t stolen;
+} BeltStat;
+
+// una etapa del pipeline (--pipeline)
+typedef struct {
+    char name[16];
+    uint32_t workers;
+    uint32_t queue_depth;         // ordenes que esperan a la etapa
+    uint32_t queue_capacity;
+    uint32_t depth_max;
+    uint64_t processed;
+    uint64_t busy_ns;             // utilizacion = busy_ns / (tiempo * workers)
+} StageStat;
+
+// una clase de prioridad (--classes); las terminadas son lateness.total
+typedef struct {
+    uint32_t queue_depth;         // ordenes de la clase en la cola
+    uint64_t deadline_us;         // plazo prometido
+    uint64_t missed;              // terminadas fuera de plazo
+    LatencyHistogram lateness;    // retraso sobre el plazo (0: a tiempo)
+} ClassStat;
+
+typedef struct {
+    // cabecera: se escribe una sola vez al crear el segmento
+    uint32_t magic;
+    uint32_t version;
+    size_t total_size;
+    uint32_t num_belts;
+    uint32_t num_ingredients;
+    uint32_t num_stages;          // 0: sin pipeline
+    uint32_t num_classes;         // 1: sin clases de prioridad
+    bool edf;
+    bool auto_restock;
+    pid_t publisher_pid;
+    char ingredient_names[MAX_INGREDIENTS][20];
+    char class_names[ORDER_CLASSES][12];
+
+    // todo lo que sigue se publica bajo seq
+    _Alignas(CACHE_LINE_SIZE) SeqLock seq;
+    uint64_t start_ns;            // CLOCK_MONOTONIC al arrancar la corrida
+    uint64_t sample_ns;           // momento de esta foto
+    uint64_t samples;             // fotos publicadas
+    bool running;                 // false: la corrida termino (ultima foto)
+
+    // contadores (solo crecen)
+    uint64_t orders_generated;
+    uint64_t orders_completed;
+    uint64_t orders_dropped;
+    uint64_t orders_backlogged;
+
+    // medidores
+    uint32_t queue_depth;
+    uint32_t queue_capacity;
+    uint32_t depth_max;
+    uint32_t backlog_max;
+    int64_t stock[MAX_INGREDIENTS];
+
+    // reposicion automatica (--auto-restock)
+    uint64_t restock_orders;
+    uint64_t restock_units;
+    uint64_t stall_ns;            // banda-ns con bandas paradas por ingredientes
+    uint64_t stall_ns_avoided;    // banda-ns que se habrian parado sin reponer
+    uint32_t demand_milli[MAX_INGREDIENTS];        // demanda estimada, unidades/s por mil
+    int64_t depletion_ms[MAX_INGREDIENTS];         // -1: sin demanda
+
+    // histogramas de todas las bandas fusionadas
+    LatencyHistogram queue_wait;
+    LatencyHistogram service;
+    LatencyHistogram total;
+
+    StageStat stages[MAX_STAGES];
+    ClassStat classes[ORDER_CLASSES];
+    BeltStat belts[];             // num_belts
+} StatsSegment;
+
+static inline size_t stats_segment_size(int num_belts)
+{
+    return sizeof(StatsSegment) + sizeof(BeltStat) * num_belts;
+}
+
+// escritor (proceso principal): crea el segmento con permisos de lectura
+// para todos. devuelve NULL si no se pudo (la corrida sigue sin el)
+StatsSegment *stats_segment_create(int num_belts, int num_ingredients);
+void stats_segment_destroy(StatsSegment *seg);
+
+// lector: mapea el segmento existente en solo lectura
+const StatsSegment *stats_segment_attach(void);
+void stats_segment_detach(const StatsSegment *seg);
+
+// copia una foto consistente del segmento en out (de seg->total_size bytes)
+void stats_segment_snapshot(const StatsSegment *seg, StatsSegment *out);
+
+#endif
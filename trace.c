@@ -0,0 +1,150 @@
+// File: trace.c
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "trace.h"
+#include "packed_order.h"
+
+uint32_t trace_pack_needs(const uint8_t needs[MAX_INGREDIENTS])
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+    {
+        uint32_t n = needs[i];
+        if (n > TRACE_NEED_MAX)
+            n = TRACE_NEED_MAX;
+        packed |= n << (i * TRACE_NEED_BITS);
+    }
+    return packed;
+}
+
+void trace_unpack_needs(uint32_t packed, uint8_t needs[MAX_INGREDIENTS])
+{
+    for (int i = 0; i < MAX_INGREDIENTS; i++)
+    {
+        needs[i] = (packed >> (i * TRACE_NEED_BITS)) & TRACE_NEED_MAX;
+    }
+}
+
+uint32_t trace_pack_order(const BurgerOrder *order)
+{
+    uint32_t order_class = order->priority < ORDER_CLASSES ? order->priority : ORDER_STANDARD;
+    return trace_pack_needs(order->ingredients_needed) | order_class << TRACE_CLASS_SHIFT;
+}
+
+uint32_t trace_unpack_class(uint32_t packed)
+{
+    uint32_t order_class = packed >> TRACE_CLASS_SHIFT;
+    return order_class < ORDER_CLASSES ? order_class : ORDER_STANDARD;
+}
+
+bool trace_writer_open(TraceWriter *w, const char *path)
+{
+    w->count = 0;
+    w->file = fopen(path, "wb");
+    if (w->file == NULL)
+    {
+        perror("fopen (traza)");
+        return false;
+    }
+    // la cabecera se reescribe al cerrar con el numero de registros
+    TraceHeader header = {.num_ingredients = MAX_INGREDIENTS, .record_size = sizeof(TraceRecord)};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, w->file) != 1)
+    {
+        perror("fwrite (traza)");
+        fclose(w->file);
+        w->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool trace_writer_append(TraceWriter *w, const BurgerOrder *order, uint64_t arrival_offset_ns)
+{
+    TraceRecord rec = {
+        .arrival_offset_ns = arrival_offset_ns,
+        .order_id = order->order_id,
+        .needs = trace_pack_order(order),
+    };
+    if (fwrite(&rec, sizeof(rec), 1, w->file) != 1)
+        return false;
+    w->count++;
+    return true;
+}
+
+void trace_writer_close(TraceWriter *w)
+{
+    if (w->file == NULL)
+        return;
+    fseek(w->file, offsetof(TraceHeader, count), SEEK_SET);
+    fwrite(&w->count, sizeof(w->count), 1, w->file);
+    fclose(w->file);
+    w->file = NULL;
+}
+
+bool trace_reader_open(TraceReader *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open (traza)");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(TraceHeader))
+    {
+        fprintf(stderr, "Error: %s no es una traza valida.\n", path);
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap (traza)");
+        return false;
+    }
+    const TraceHeader *header = map;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->record_size != sizeof(TraceRecord) || header->num_ingredients != MAX_INGREDIENTS)
+    {
+        fprintf(stderr, "Error: %s no es una traza valida.\n", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+    // la lectura es secuencial: pedimos al kernel que lea por adelantado
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    r->header = header;
+    r->records = (const TraceRecord *)(header + 1);
+    r->map_size = st.st_size;
+    // si la grabacion no se cerro bien, la cuenta sale del tamano del archivo
+    uint64_t in_file = (st.st_size - sizeof(TraceHeader)) / sizeof(TraceRecord);
+    r->count = header->count != 0 && header->count <= in_file ? header->count : in_file;
+    return true;
+}
+
+void trace_reader_close(TraceReader *r)
+{
+    if (r->header != NULL)
+        munmap((void *)r->header, r->map_size);
+    memset(r, 0, sizeof(*r));
+}
+
+void trace_record_to_order(const TraceRecord *rec, BurgerOrder *order)
+{
+    order->order_id = rec->order_id;
+    trace_unpack_needs(rec->needs, order->ingredients_needed);
+    packed_update_mask(&order->packed);
+    order->enqueued_ns = 0;
+    order->dequeued_ns = 0;
+    order->completed_ns = 0;
+    order->deadline_ns = 0;
+    order->priority = trace_unpack_class(rec->needs);
+}
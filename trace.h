@@ -0,0 +1,75 @@
+// File: trace.h
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+#include "shared_data.h"
+
+// formato binario de trazas de ordenes: una cabecera fija seguida de
+// registros de 16 bytes, todo en el orden de bytes de la maquina. las
+// necesidades de cada orden van empaquetadas en 3 bits por ingrediente
+// (hasta 7 unidades), asi que una traza de un dia cabe en pocas decenas de MB.
+// los 2 bits altos que sobran llevan la clase de prioridad (0 en las trazas
+// viejas: estandar)
+#define TRACE_MAGIC "BURGTRC1"
+#define TRACE_NEED_BITS 3
+#define TRACE_NEED_MAX ((1u << TRACE_NEED_BITS) - 1)
+#define TRACE_CLASS_SHIFT 30
+
+typedef struct {
+    char magic[8];
+    uint32_t num_ingredients;
+    uint32_t record_size;
+    uint64_t count;               // registros escritos (0 si la grabacion no se cerro)
+    uint64_t reserved;
+} TraceHeader;
+
+typedef struct {
+    uint64_t arrival_offset_ns;   // llegada desde el inicio de la grabacion
+    uint32_t order_id;
+    uint32_t needs;               // TRACE_NEED_BITS por ingrediente
+} TraceRecord;
+
+_Static_assert(sizeof(TraceHeader) == 32, "TraceHeader debe medir 32 bytes");
+_Static_assert(sizeof(TraceRecord) == 16, "TraceRecord debe medir 16 bytes");
+_Static_assert(MAX_INGREDIENTS * TRACE_NEED_BITS <= TRACE_CLASS_SHIFT, "las necesidades no caben en TraceRecord.needs");
+_Static_assert(ORDER_CLASSES <= (1 << (32 - TRACE_CLASS_SHIFT)), "las clases no caben en TraceRecord.needs");
+
+// grabacion: escritura secuencial con el buffer de stdio
+typedef struct {
+    FILE *file;
+    uint64_t count;
+} TraceWriter;
+
+bool trace_writer_open(TraceWriter *w, const char *path);
+bool trace_writer_append(TraceWriter *w, const BurgerOrder *order, uint64_t arrival_offset_ns);
+// completa la cabecera con el numero de registros y cierra el archivo
+void trace_writer_close(TraceWriter *w);
+
+// reproduccion: la traza se mapea completa en memoria y los registros se
+// leen en su lugar, sin copiarlos
+typedef struct {
+    const TraceHeader *header;
+    const TraceRecord *records;
+    uint64_t count;
+    size_t map_size;
+} TraceReader;
+
+bool trace_reader_open(TraceReader *r, const char *path);
+void trace_reader_close(TraceReader *r);
+
+// necesidades de una orden en TRACE_NEED_BITS por ingrediente (las que
+// pasan de TRACE_NEED_MAX se recortan); tambien las usa el diario
+uint32_t trace_pack_needs(const uint8_t needs[MAX_INGREDIENTS]);
+void trace_unpack_needs(uint32_t packed, uint8_t needs[MAX_INGREDIENTS]);
+
+// necesidades y clase de una orden en una palabra, y la clase de vuelta
+uint32_t trace_pack_order(const BurgerOrder *order);
+uint32_t trace_unpack_class(uint32_t packed);
+
+// convierte un registro en una orden (sin marcas de tiempo)
+void trace_record_to_order(const TraceRecord *rec, BurgerOrder *order);
+
+#endif
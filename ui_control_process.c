@@ -7,8 +7,16 @@
 #include <signal.h> 
 #include <string.h>   
 #include <stdlib.h>   
+#include <stdarg.h>
 
 #include "shared_data.h"
+#include "order_queue.h"
+#include "logger.h"
+#include "inventory.h"
+#include "dispatcher.h"
+#include "belt.h"
+#include "pipeline.h"
+#include "clock_utils.h"
 
 static SharedSystemState *shared_state = NULL;
 volatile sig_atomic_t ui_should_exit = 0;
@@ -19,67 +27,245 @@ void ui_signal_handler(int sig) {
     }
 }
 
+// --- Renderizado por diferencias ---
+// Guardamos el texto de cada fila ya dibujada y solo reescribimos las filas
+// que cambiaron; nunca se borra la ventana entera (wclear fuerza a repintar
+// toda la terminal cada 100 ms).
+#define UI_MAX_ROWS 256
+#define UI_ROW_LEN 160
+
+static char drawn_rows[UI_MAX_ROWS][UI_ROW_LEN];
+static bool row_used[UI_MAX_ROWS];       // la fila tiene texto en pantalla
+static bool row_touched[UI_MAX_ROWS];    // la fila se escribió en este cuadro
+static int row_attr[UI_MAX_ROWS];
+
+// Cada cuántos cuadros se fusionan los histogramas (leerlos recorre miles
+// de contadores que las bandas están escribiendo).
+#define LATENCY_REFRESH_FRAMES 10
+
+static void put_row(WINDOW *win, int row, int col, int attr, const char *fmt, ...) {
+    int height, width;
+    getmaxyx(win, height, width);
+    if (row <= 0 || row >= height - 1 || row >= UI_MAX_ROWS) return;
+
+    char text[UI_ROW_LEN];
+    int n = snprintf(text, sizeof(text), "%*s", col, "");
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text + n, sizeof(text) - n, fmt, args);
+    va_end(args);
+
+    row_touched[row] = true;
+    if (row_used[row] && row_attr[row] == attr && strcmp(drawn_rows[row], text) == 0) return;
+
+    strcpy(drawn_rows[row], text);
+    row_used[row] = true;
+    row_attr[row] = attr;
+    wmove(win, row, 1); wclrtoeol(win);
+    if (attr) wattron(win, attr);
+    mvwaddnstr(win, row, col, text + col, width - col - 1);
+    if (attr) wattroff(win, attr);
+    mvwaddch(win, row, width - 1, ACS_VLINE);   // wclrtoeol borró el borde
+}
+
+// Limpia las filas que tenían texto y en este cuadro quedaron vacías.
+static void finish_rows(WINDOW *win) {
+    int width = getmaxx(win);
+    for (int row = 0; row < UI_MAX_ROWS; row++) {
+        if (row_used[row] && !row_touched[row]) {
+            wmove(win, row, 1); wclrtoeol(win);
+            mvwaddch(win, row, width - 1, ACS_VLINE);
+            row_used[row] = false;
+        }
+        row_touched[row] = false;
+    }
+}
+
+// Foto consistente de los contadores del generador.
+static void stats_snapshot(RunStats *stats, uint64_t *generated, uint64_t *dropped) {
+    uint32_t v;
+    do {
+        v = seqlock_read_begin(&stats->seq);
+        *generated = atomic_load_explicit(&stats->orders_generated, memory_order_relaxed);
+        *dropped = atomic_load_explicit(&stats->orders_dropped, memory_order_relaxed);
+    } while (seqlock_read_retry(&stats->seq, v));
+}
+
+// Utilización de cada etapa del pipeline en el último intervalo: el tiempo
+// que sus trabajadores prepararon sobre el tiempo que pasó.
+static void stage_utilization(double utilization[MAX_STAGES]) {
+    static uint64_t prev_busy[MAX_STAGES];
+    static uint64_t prev_ns = 0;
+    uint64_t now = now_ns();
+    for (int s = 0; s < shared_state->config.num_stages; s++) {
+        uint64_t busy = atomic_load_explicit(&shared_state->pipeline[s].busy_ns, memory_order_relaxed);
+        double span = prev_ns ? (double)(now - prev_ns) * shared_state->config.stages[s].workers : 0.0;
+        utilization[s] = span > 0 ? (busy - prev_busy[s]) / span : 0.0;
+        prev_busy[s] = busy;
+    }
+    prev_ns = now;
+}
+
 void draw_status_window(WINDOW *win) {
-    wclear(win);
-    box(win, 0, 0); 
-    mvwprintw(win, 1, 2, "ESTADO DEL SISTEMA DE HAMBURGUESAS");
-    
-    mvwprintw(win, 3, 2, "Banda | PID     | Estado          | Hamburguesas Procesadas");
-    mvwprintw(win, 4, 2, "------+---------+-----------------+--------------------------");
-    for (int i = 0; i < shared_state->num_belts; i++) {
+    static unsigned long frame = 0;
+    static BeltMetrics merged;
+    static char latency_lines[3][96];
+    static double utilization[MAX_STAGES];
+    const SystemConfig *config = &shared_state->config;
+
+    // Fotos de cada banda y del generador: ninguna lectura toma candados
+    // ni escribe en la memoria compartida.
+    int num_belts = shared_state->num_belts;
+    put_row(win, 1, 2, 0, "ESTADO DEL SISTEMA DE HAMBURGUESAS");
+    if (config->num_stages > 0) {
+        put_row(win, 3, 2, 0, "Banda | PID     | Estado          | Terminadas | Etapa");
+        put_row(win, 4, 2, 0, "------+---------+-----------------+------------+-----------");
+    } else {
+        put_row(win, 3, 2, 0, "Banda | PID     | Estado          | Hamburguesas Procesadas");
+        put_row(win, 4, 2, 0, "------+---------+-----------------+--------------------------");
+    }
+    int alerts[UI_MAX_ROWS];
+    unsigned int alert_orders[UI_MAX_ROWS];
+    int alert_count = 0;
+    for (int i = 0; i < num_belts; i++) {
+        BeltSnapshot belt;
+        belt_snapshot(state_belt(shared_state, i), &belt);
         char status_str[25];
-        switch (shared_state->belts[i].status) {
+        // El estado lo publica la banda; un comando pendiente se ve hasta
+        // que la banda llega a su punto seguro.
+        BeltStatus status = belt.status;
+        switch (status) {
             case IDLE: strcpy(status_str, "Esperando"); break;
-            case PREPARING: snprintf(status_str, 25, "Preparando #%u", shared_state->belts[i].current_order_id); break;
+            case PREPARING:
+                snprintf(status_str, 25, "%s #%u", belt.command == BELT_RUN ? "Preparando" : "Termina",
+                         belt.current_order_id);
+                break;
             case PAUSED: strcpy(status_str, "Pausada"); break;
             case NO_INGREDIENTS: strcpy(status_str, "**FALTAN ING.**"); break;
+            case DRAINED: strcpy(status_str, "Retirada"); break;
             default: strcpy(status_str, "Desconocido"); break;
         }
-        mvwprintw(win, 5 + i, 2, " %-4d | %-7d | %-15s | %u", i, shared_state->belts[i].pid, status_str, shared_state->belts[i].burgers_processed);
+        if (config->num_stages > 0) {
+            put_row(win, 5 + i, 2, 0, " %-4d | %-7d | %-15s | %-10u | %s", i, state_belt_info(shared_state, i)->pid,
+                    status_str, belt.burgers_processed, config->stages[pipeline_stage_of(config, i)].name);
+        } else {
+            put_row(win, 5 + i, 2, 0, " %-4d | %-7d | %-15s | %u", i, state_belt_info(shared_state, i)->pid, status_str, belt.burgers_processed);
+        }
+        if (status == NO_INGREDIENTS && alert_count < UI_MAX_ROWS) {
+            alerts[alert_count] = i;
+            alert_orders[alert_count++] = belt.current_order_id;
+        }
+    }
+
+    uint64_t generated, dropped;
+    stats_snapshot(&shared_state->stats, &generated, &dropped);
+    int queue_y_pos = 5 + num_belts + 2;
+    put_row(win, queue_y_pos, 2, 0, "COLA DE ORDENES EN ESPERA: %d/%d | Generadas: %lu | Descartadas: %lu", dispatcher_pending(shared_state),
+            order_queue_capacity(&shared_state->waiting_orders) + shared_state->config.dispatch_window,
+            (unsigned long)generated, (unsigned long)dropped);
+
+    // latencias de todas las bandas fusionadas (p50/p99/p999)
+    if (frame++ % LATENCY_REFRESH_FRAMES == 0) {
+        stage_utilization(utilization);
+        belt_metrics_merge_all(shared_state, &merged);
+        latency_summary(&merged.queue_wait, latency_lines[0], sizeof(latency_lines[0]));
+        latency_summary(&merged.service, latency_lines[1], sizeof(latency_lines[1]));
+        latency_summary(&merged.total, latency_lines[2], sizeof(latency_lines[2]));
     }
+    put_row(win, queue_y_pos + 1, 2, 0, "LATENCIAS (%lu ordenes):", (unsigned long)merged.total.total);
+    put_row(win, queue_y_pos + 2, 4, 0, "- Espera en cola: %s", latency_lines[0]);
+    put_row(win, queue_y_pos + 3, 4, 0, "- En la banda   : %s", latency_lines[1]);
+    put_row(win, queue_y_pos + 4, 4, 0, "- Total         : %s", latency_lines[2]);
 
-    int queue_y_pos = 5 + shared_state->num_belts + 2;
-    mvwprintw(win, queue_y_pos, 2, "COLA DE ORDENES EN ESPERA: %d/%d", shared_state->waiting_orders.count, MAX_ORDERS_IN_QUEUE);
+    // Etapas del pipeline: la más ocupada es el cuello de botella.
+    int stage_y_pos = queue_y_pos + 6;
+    if (config->num_stages > 0) {
+        put_row(win, stage_y_pos, 2, 0, "ETAPAS DEL PIPELINE:");
+        for (int s = 0; s < config->num_stages; s++) {
+            put_row(win, stage_y_pos + 1 + s, 4, utilization[s] >= 0.95 ? A_BOLD : 0,
+                    "- %-10s: %d trabajadores | cola %d/%d | utilizacion %3.0f%% | %lu ordenes", config->stages[s].name,
+                    config->stages[s].workers, pipeline_queue_depth(shared_state, s),
+                    pipeline_queue_capacity(shared_state, s), utilization[s] * 100.0,
+                    (unsigned long)atomic_load_explicit(&shared_state->pipeline[s].processed, memory_order_relaxed));
+        }
+        stage_y_pos += config->num_stages + 2;
+    }
 
-    int inv_y_pos = queue_y_pos + 2;
-    mvwprintw(win, inv_y_pos, 2, "INVENTARIO DE INGREDIENTES:");
+    // Plazos por clase (--classes): en negrita la clase cuyo p99 ya se pasa del plazo.
+    OrderQueue *q = &shared_state->waiting_orders;
+    if (q->num_lanes > 1) {
+        put_row(win, stage_y_pos, 2, 0, "PLAZOS POR CLASE (%s):", config->edf ? "edf" : "por llegada");
+        for (uint32_t c = 0; c < q->num_lanes; c++) {
+            const LatencyHistogram *late = &merged.lateness[c];
+            uint64_t p99_ns = hist_percentile(late, 99.0);
+            char deadline[16], p99[16];
+            hist_format_ns(deadline, sizeof(deadline), config->class_deadline_us[c] * 1000);
+            hist_format_ns(p99, sizeof(p99), p99_ns);
+            put_row(win, stage_y_pos + 1 + c, 4, p99_ns > 0 ? A_BOLD : 0,
+                    "- %-8s: plazo %-8s | en cola %-4d | %lu terminadas | fuera de plazo %lu | retraso p99 %s",
+                    order_class_name(c), deadline, order_queue_class_size(q, c), (unsigned long)late->total,
+                    (unsigned long)merged.missed[c], p99);
+        }
+        stage_y_pos += q->num_lanes + 2;
+    }
+
+    int inv_y_pos = stage_y_pos;
+    RestockStats *restock = &shared_state->restock;
+    if (config->restock.enabled) {
+        put_row(win, inv_y_pos, 2, 0, "INVENTARIO DE INGREDIENTES (reposicion automatica: %lu pedidos, bandas paradas %.1f s, evitado %.1f s):",
+                (unsigned long)atomic_load_explicit(&restock->orders, memory_order_relaxed),
+                atomic_load_explicit(&restock->stall_ns, memory_order_relaxed) / 1e9,
+                atomic_load_explicit(&restock->stall_ns_avoided, memory_order_relaxed) / 1e9);
+    } else {
+        put_row(win, inv_y_pos, 2, 0, "INVENTARIO DE INGREDIENTES:");
+    }
     for (int i = 0; i < 6; i++) { // Asumimos 6 ingredientes
-        if (strlen(shared_state->ingredients[i].name) > 0) {
-             mvwprintw(win, inv_y_pos + 1 + i, 4, "- %-10s: %d", shared_state->ingredients[i].name, shared_state->ingredients[i].count);
+        if (strlen(shared_state->ingredient_info[i].name) == 0) continue;
+        long count = inventory_count(&shared_state->inventory, i);
+        if (!config->restock.enabled) {
+            put_row(win, inv_y_pos + 1 + i, 4, 0, "- %-10s: %ld", shared_state->ingredient_info[i].name, count);
+            continue;
         }
+        // Con reposición automática: demanda estimada, cuándo se agota y lo que viene en camino.
+        int64_t depletion = atomic_load_explicit(&restock->depletion_ms[i], memory_order_relaxed);
+        char eta[24] = "-";
+        if (depletion >= 0) snprintf(eta, sizeof(eta), "%.1f s", depletion / 1000.0);
+        put_row(win, inv_y_pos + 1 + i, 4, depletion >= 0 && depletion < config->restock.lead_time_ms ? A_BOLD : 0,
+                "- %-10s: %-6ld | demanda %6.1f/s | se agota en %-8s | en camino %u", shared_state->ingredient_info[i].name,
+                count, atomic_load_explicit(&restock->rate_milli[i], memory_order_relaxed) / 1000.0, eta,
+                atomic_load_explicit(&restock->in_transit[i], memory_order_relaxed));
     }
 
     int alert_y_pos = inv_y_pos + 8;
-    mvwprintw(win, alert_y_pos, 2, "ALERTAS DEL SISTEMA:");
-    int alert_count = 0;
-    for (int i = 0; i < shared_state->num_belts; i++) {
-        if (shared_state->belts[i].status == NO_INGREDIENTS) {
-            wattron(win, A_BOLD);
-            mvwprintw(win, alert_y_pos + 1 + alert_count, 4, "-> Banda %d parada por falta de ingredientes para orden #%u", i, shared_state->belts[i].current_order_id);
-            wattroff(win, A_BOLD);
-            alert_count++;
-        }
+    put_row(win, alert_y_pos, 2, 0, "ALERTAS DEL SISTEMA:");
+    for (int k = 0; k < alert_count; k++) {
+        put_row(win, alert_y_pos + 1 + k, 4, A_BOLD, "-> Banda %d parada por falta de ingredientes para orden #%u", alerts[k], alert_orders[k]);
     }
     if (alert_count == 0) {
-        mvwprintw(win, alert_y_pos + 1, 4, "- Todo en orden.");
+        put_row(win, alert_y_pos + 1, 4, 0, "- Todo en orden.");
     }
-    
-    wrefresh(win);
+
+    finish_rows(win);
+    wnoutrefresh(win);
 }
 
 void draw_control_window(WINDOW *win) {
-    wclear(win);
+    werase(win);
     box(win, 0, 0);
-    mvwprintw(win, 1, 2, "Controles: (P)ausar | (R)eanudar | (A)ñadir Ingredientes | (Ctrl+C Salir)");
-    wrefresh(win);
+    mvwprintw(win, 1, 2, "Controles: (P)ausar | (R)eanudar | (D)Retirar | (A)ñadir Ingredientes | (V)erbosidad | (Ctrl+C Salir)");
+    if (shared_state->log.num_rings > 0) {
+        mvwprintw(win, 2, 2, "Registro: %s en %s", log_level_name(atomic_load(&shared_state->log.level)),
+                  shared_state->config.log_path);
+    }
+    wnoutrefresh(win);
 }
 
 void start_ui_control_process(const char* shm_name) {
-    int shm_fd = shm_open(shm_name, O_RDWR, 0666);
-    if (shm_fd == -1) { exit(1); }
-    shared_state = mmap(NULL, sizeof(SharedSystemState), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_state == MAP_FAILED) { exit(1); }
-    close(shm_fd);
+    shared_state = shm_attach(shm_name);
+    if (shared_state == NULL) { exit(1); }
+    if (shared_state->config.affinity.ui_cpu >= 0) {
+        affinity_pin_cpu(shared_state->config.affinity.ui_cpu);
+    }
 
     signal(SIGINT, ui_signal_handler);
 
@@ -90,27 +276,54 @@ void start_ui_control_process(const char* shm_name) {
     WINDOW *status_win = newwin(height - 4, width, 0, 0);
     WINDOW *control_win = newwin(4, width, height - 4, 0);
 
+    // El marco y los controles se dibujan una vez; después solo cambian
+    // las filas con datos nuevos.
+    box(status_win, 0, 0);
+    draw_control_window(control_win);
     while (shared_state->system_running && !ui_should_exit) {
         draw_status_window(status_win);
-        draw_control_window(control_win);
+        doupdate();
         int ch = getch(); 
 
-        if (ch == 'p' || ch == 'P' || ch == 'r' || ch == 'R') {
+        // Nivel del registro: las bandas lo leen en cada evento, el cambio
+        // rige desde el siguiente.
+        if ((ch == 'v' || ch == 'V') && shared_state->log.num_rings > 0) {
+            int level = atomic_load(&shared_state->log.level);
+            atomic_store(&shared_state->log.level, level == LOG_OFF ? LOG_DEBUG : level - 1);
+            draw_control_window(control_win);
+        }
+
+        if (ch == 'p' || ch == 'P' || ch == 'r' || ch == 'R' || ch == 'd' || ch == 'D') {
             echo(); 
             wmove(control_win, 2, 2); wclrtoeol(control_win);
             mvwprintw(control_win, 2, 2, "ID de la banda?: ");
             wrefresh(control_win);
             char str[4]; wgetnstr(control_win, str, 3); int belt_id_input = atoi(str);
             noecho(); 
+            int refused = -1;
 
             if (belt_id_input >= 0 && belt_id_input < shared_state->num_belts) {
-                pid_t target_pid = shared_state->belts[belt_id_input].pid;
-                if (ch == 'p' || ch == 'P') {
-                    if (kill(target_pid, SIGSTOP) == 0) { shared_state->belts[belt_id_input].status = PAUSED; }
-                } else if (ch == 'r' || ch == 'R') {
-                    if (kill(target_pid, SIGCONT) == 0) { shared_state->belts[belt_id_input].status = IDLE; }
+                // Sin señales: la banda atiende el comando entre dos órdenes,
+                // nunca en medio de la cola o del inventario. Una retirada ya
+                // no vuelve.
+                PreparationBelt *belt = state_belt(shared_state, belt_id_input);
+                BeltCommand command = (ch == 'p' || ch == 'P') ? BELT_PAUSE
+                                    : (ch == 'd' || ch == 'D') ? BELT_DRAIN : BELT_RUN;
+                if (atomic_load(&belt->command) != BELT_DRAIN) {
+                    // En el pipeline, una etapa sin trabajadores trabaría a la anterior.
+                    if (command != BELT_RUN && !pipeline_can_stop(shared_state, belt_id_input)) {
+                        refused = belt_id_input;
+                    } else {
+                        belt_send_command(shared_state, belt_id_input, command);
+                    }
                 }
             }
+            draw_control_window(control_win);
+            if (refused >= 0) {
+                mvwprintw(control_win, 2, 2, "La banda %d es la ultima que corre en la etapa %s: no se detiene.",
+                          refused, shared_state->config.stages[pipeline_stage_of(&shared_state->config, refused)].name);
+                wnoutrefresh(control_win);
+            }
         }
 
         // --- LÓGICA PARA REPONER INGREDIENTES ---
@@ -124,27 +337,22 @@ void start_ui_control_process(const char* shm_name) {
 
             if (ing_id >= 0 && ing_id < 6) {
                 wmove(control_win, 2, 2); wclrtoeol(control_win);
-                mvwprintw(control_win, 2, 2, "Cantidad a añadir para %s: ", shared_state->ingredients[ing_id].name);
+                mvwprintw(control_win, 2, 2, "Cantidad a añadir para %s: ", shared_state->ingredient_info[ing_id].name);
                 wrefresh(control_win);
                 wgetnstr(control_win, str, 3); int quantity = atoi(str);
 
                 if (quantity > 0) {
-                    pthread_mutex_lock(&shared_state->ingredients[ing_id].mutex);
-                    shared_state->ingredients[ing_id].count += quantity;
-                    pthread_mutex_unlock(&shared_state->ingredients[ing_id].mutex);
-
                     // --- DESPACHO AUTOMÁTICO ---
-                    // Despertamos a las bandas. Al haber nuevos ingredientes, la que estaba
-                    // atascada ahora podrá continuar su trabajo.
-                    for(int i=0; i < shared_state->num_belts; i++) {
-                       sem_post(&shared_state->sem_orders_available);
-                    }
+                    // La reposición despierta a las bandas atascadas para que revisen
+                    // al instante las órdenes que esperan en la ventana de despacho.
+                    dispatcher_restock(shared_state, ing_id, quantity);
                 }
             }
             noecho();
+            draw_control_window(control_win);
         }
     }
 
     delwin(status_win); delwin(control_win); endwin(); 
-    munmap(shared_state, sizeof(SharedSystemState));
+    shm_detach(shared_state);
 }
\ No newline at end of file
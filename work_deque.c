@@ -0,0 +1,73 @@
+// File: work_deque.c
+
+#include <stdlib.h>
+
+#include "work_deque.h"
+
+bool work_deque_init(WorkDeque *d, int64_t capacity)
+{
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    d->capacity = capacity;
+    d->buffer = calloc(capacity, sizeof(BurgerOrder));
+    return d->buffer != NULL;
+}
+
+void work_deque_destroy(WorkDeque *d)
+{
+    free(d->buffer);
+    d->buffer = NULL;
+}
+
+bool work_deque_push(WorkDeque *d, const BurgerOrder *order)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    // nunca escribimos una casilla que un ladron pueda estar leyendo
+    if (b - t >= d->capacity)
+        return false;
+    d->buffer[b & (d->capacity - 1)] = *order;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+bool work_deque_pop(WorkDeque *d, BurgerOrder *out)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b)
+    {
+        // vacio
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+    *out = d->buffer[b & (d->capacity - 1)];
+    if (t == b)
+    {
+        // ultimo elemento: competimos con los ladrones por el
+        bool won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                           memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool work_deque_steal(WorkDeque *d, BurgerOrder *out)
+{
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return false;
+    // copiamos antes del CAS; si otro gana, la copia se descarta
+    BurgerOrder copy = d->buffer[t & (d->capacity - 1)];
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed))
+        return false;
+    *out = copy;
+    return true;
+}
@@ -0,0 +1,28 @@
+// File: work_deque.h
+
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include "shared_data.h"
+
+// deque de trabajo de Chase-Lev (acotado) para el modo de bandas hilo.
+// solo el hilo dueno empuja y saca por abajo; los demas hilos roban por
+// arriba. vive en la memoria privada del proceso de bandas hilo
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic int64_t top;
+    _Alignas(CACHE_LINE_SIZE) _Atomic int64_t bottom;
+    _Alignas(CACHE_LINE_SIZE) int64_t capacity;   // potencia de dos
+    BurgerOrder *buffer;
+} WorkDeque;
+
+bool work_deque_init(WorkDeque *d, int64_t capacity);
+void work_deque_destroy(WorkDeque *d);
+
+// operaciones del dueno
+bool work_deque_push(WorkDeque *d, const BurgerOrder *order);
+bool work_deque_pop(WorkDeque *d, BurgerOrder *out);
+
+// operacion de los ladrones (cualquier otro hilo)
+bool work_deque_steal(WorkDeque *d, BurgerOrder *out);
+
+#endif